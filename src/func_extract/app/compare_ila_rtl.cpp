@@ -1,7 +1,9 @@
 #include "../../live_analysis/src/global_data.h"
 #include "../src/helper.h"
 #include "../src/util.h"
+#include "../src/trace_reader.h"
 #include "compare_ila_rtl.h"
+#include <sys/stat.h>
 #define toStr(a) std::to_string(a)
 // This files is used to parse the results from ila simulation
 // and rtl simulations, and compare if they are consistent
@@ -25,7 +27,12 @@ int main(int argc, char *argv[]) {
   }
   read_asv_info(g_path+"/asv_info.txt", true);
   read_rtl_values(g_path+"/rtl_results.txt");
-  read_ila_values(g_path+"/ila_results.txt");
+  // Prefer the binary trace of a simulator generated with sim_gen -trace
+  struct stat statbuf;
+  if (stat((g_path+"/ila_trace.bin").c_str(), &statbuf) == 0)
+    read_ila_trace(g_path+"/ila_trace.bin");
+  else
+    read_ila_values(g_path+"/ila_results.txt");
 
   compare_results();
 }
@@ -87,6 +94,30 @@ void read_ila_values(std::string fileName) {
 }
 
 
+// Every record of the trace gives one value of every entry, like the
+// text printed after an instruction.
+void read_ila_trace(std::string fileName) {
+  TraceReader trace;
+  if (!trace.open(fileName)) {
+    toCout("Error: cannot read ASV trace: "+fileName);
+    abort();
+  }
+
+  std::vector<std::vector<uint32_t>*> entryValues;
+  for (uint32_t entry = 0; entry < trace.entry_num(); ++entry)
+    entryValues.push_back(&ilaValues[trace.entry_name(entry)]);
+
+  std::vector<uint32_t> current(trace.entry_num(), 0);
+  while (trace.next()) {
+    for (uint32_t entry : trace.changed())
+      current[entry] = trace.value(entry).getLoBits(32).getZExtValue();
+    for (uint32_t entry = 0; entry < trace.entry_num(); ++entry)
+      entryValues[entry]->push_back(current[entry]);
+    ilaValueLen++;
+  }
+}
+
+
 void align_map_size(std::map<std::string, std::vector<uint32_t>> &ilaValues) {
   uint32_t maxSize = 0;
   for(auto it = ilaValues.begin(); it != ilaValues.end(); it++) {
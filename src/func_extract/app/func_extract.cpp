@@ -11,10 +11,12 @@
 //#include "../src/make_define_fun.h"
 #include "../src/get_all_update.h"
 #include "../src/helper.h"
+#include "../src/incremental_clean.h"
 
 #include <string>
 #include <fstream>
 #include <time.h>
+#include <unistd.h>
 #include <sys/stat.h>
 #include <glog/logging.h>
 
@@ -150,37 +152,28 @@ int main(int argc, char *argv[]) {
   read_allowed_targets(g_path+"/allowed_target.txt");
 
 
-  // A clear flag of "-" specifies "smart cleaning": it will be done only if
-  // design.v.clean does not exist or design.v is newer than design.v.clean.
+  // A clear flag of "-" specifies "smart cleaning": design.v is split into
+  // modules, and only the modules whose text changed since the last run are
+  // cleaned again.  The rest are taken from design.v.cache/.
+  bool nocommentReady = false;
   if (doClean.compare("-") == 0) {
     struct stat statbuf;
-    if (stat((g_path+"/design.v.clean").c_str(), &statbuf) != 0) {
-      doClean = "1";  // .v.clean file does not exist
+    if (stat((g_path+"/design.v").c_str(), &statbuf) != 0) {
+      doClean = "0";   // .v file does not exist
     } else {
-      struct timespec clean_mtim = statbuf.st_mtim;
-      if (stat((g_path+"/design.v").c_str(), &statbuf) != 0) {
-        doClean = "0";   // .v file does not exist
-      } else {
-        struct timespec v_mtim = statbuf.st_mtim;
-        if (v_mtim.tv_sec > clean_mtim.tv_sec) {
-          doClean = "1"; // .v file s newer
-        } else if (v_mtim.tv_sec < clean_mtim.tv_sec) {
-          doClean = "0"; // .v file is older
-        } else if (v_mtim.tv_nsec > clean_mtim.tv_nsec) {
-          doClean = "1"; // .v file is slightly newer
-        } else {
-          doClean = "0";
-        }
-      }
+      doClean = incremental_clean_file(g_path+"/design.v") ? "1" : "0";
+      nocommentReady = true;
     }
   }
 
 
   if(doClean.compare("1") == 0) {
     // This reads design.v and creates design.v.nocomment
-    toCout("##### Begin clean_file");
-    clean_file(g_path+"/design.v", false);
-    toCout("##### End clean_file");
+    if (!nocommentReady) {
+      toCout("##### Begin clean_file");
+      clean_file(g_path+"/design.v", false);
+      toCout("##### End clean_file");
+    }
 
     // This reads the given file, and writes nothing.
     toCout("##### Begin getting IO");
@@ -0,0 +1,640 @@
+#include "ila_jit.h"
+#include "../src/helper.h"
+#include "../src/util.h"
+#include "../src/read_instr.h"
+#include "../src/vcd_parser.h"
+#include "../src/decode_tree.h"
+
+#include "llvm/ExecutionEngine/Orc/LLJIT.h"
+#include "llvm/ExecutionEngine/Orc/ExecutionUtils.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IRReader/IRReader.h"
+#include "llvm/Support/SourceMgr.h"
+#include "llvm/Support/TargetSelect.h"
+
+#include <dirent.h>
+#include <cstring>
+
+#define toCout(a) std::cout << a << std::endl
+
+#define toStr(a) std::to_string(a)
+
+using namespace funcExtract;
+using namespace taintGen;
+
+// ila_jit runs an architectural-level simulation without generating and
+// compiling a testbench.  The update functions written by func_extract are
+// loaded into an LLVM ORC JIT and called directly, on ASVs held in this
+// process.  A .ll/.bc file is only parsed when an instruction that uses
+// one of its functions is first executed, and the lazy JIT only compiles
+// a function when it is first called, so a short test of a big design
+// compiles just the update functions it needs.
+//
+// The instructions come from tb.txt, or for a processor-style design
+// (-proc) they are fetched from the memory image mem.txt.  The ASV
+// values are printed the same way as the program of sim_gen prints them.
+
+std::string g_instrValueVar = "zy_instr_value";
+std::string g_instrAddrVar = "zy_instr_addr";
+const std::string CALL_STUB_SUFFIX = "_jit_call";
+
+bool g_printAll = false;
+bool g_hex = false;
+
+std::map<std::string, JitVar_t> g_vars;  // C name -> value
+std::set<std::string> g_skippedTgt;
+std::vector<JitInstr_t> g_jitInstrs;     // Indexed like g_instrInfo
+
+std::map<std::string, std::string> g_funcFiles;  // update function -> file
+std::set<std::string> g_loadedFiles;
+std::map<std::string, JitCallFunc_t> g_callFuncs;  // update function -> stub
+
+std::unique_ptr<llvm::orc::LLLazyJIT> g_jit;
+llvm::orc::ThreadSafeContext g_tsCtx(std::make_unique<llvm::LLVMContext>());
+llvm::ExitOnError g_exitOnErr("ila_jit: ");
+
+
+int main(int argc, char *argv[]) {
+
+  std::string usageStr = std::string("usage: ")+argv[0]+ " [<path>] [<instr_num>] [-accel|-proc] [-print] [-hex] [-verbose]";
+
+  g_path = ".";   // Default path is current dir
+  g_verb = false;
+
+  bool fetchFromMem = false;
+  int instrNum = -1;
+
+  for (int n = 1; n < argc; ++n) {
+    const char *arg = argv[n];
+
+    if (n == 1 && arg[0] != '-') {
+      g_path = arg;
+    } else if (isdigit(arg[0])) {
+      instrNum = std::stoi(arg);
+    } else if (!strcmp(arg, "-verbose")) {
+      g_verb = true;
+    } else if (!strcmp(arg, "-print")) {
+      g_printAll = true;
+    } else if (!strcmp(arg, "-hex")) {
+      g_hex = true;
+    } else if (!strcmp(arg, "-accel")) {
+      fetchFromMem = false;
+    } else if (!strcmp(arg, "-proc")) {
+      fetchFromMem = true;
+    } else {
+      toCout(usageStr);
+      exit(-1);
+    }
+  }
+
+  if (fetchFromMem && instrNum < 0) {
+    toCout("Error: did not specify the number of instructions to be executed!");
+    toCout(usageStr);
+    exit(-1);
+  }
+
+  read_in_instructions(g_path+"/instr.txt");
+  read_asv_info(g_path+"/asv_info.txt");
+  read_func_info(g_path+"/func_info.txt");
+  vcd_parser(g_path+"/rst.vcd");
+
+  std::ifstream skipped(g_path+"/skipped_target.txt");
+  std::string line;
+  while (std::getline(skipped, line)) {
+    remove_two_end_space(line);
+    g_skippedTgt.insert(line);
+  }
+
+  llvm::InitializeNativeTarget();
+  llvm::InitializeNativeTargetAsmPrinter();
+  g_jit = g_exitOnErr(llvm::orc::LLLazyJITBuilder().create());
+  // Let the update functions call libc (e.g. memcpy)
+  g_jit->getMainJITDylib().addGenerator(g_exitOnErr(
+    llvm::orc::DynamicLibrarySearchGenerator::GetForCurrentProcess(
+      g_jit->getDataLayout().getGlobalPrefix())));
+
+  index_function_files();
+  init_vars();
+  g_jitInstrs.resize(g_instrInfo.size());
+
+  print_asvs("Initialization:");
+
+  if (fetchFromMem) run_mem(g_path+"/mem.txt", instrNum);
+  else run_tb(g_path+"/tb.txt");
+
+  bool printAll = g_printAll;
+  g_printAll = true;
+  print_asvs("The final results:");
+  g_printAll = printAll;
+
+  toCout("### "+toStr(g_callFuncs.size())+" update functions from "
+         +toStr(g_loadedFiles.size())+" files were loaded");
+  return 0;
+}
+
+
+// The size of the C type sim_gen uses for the width (see c_type())
+uint32_t elem_bytes(uint32_t width) {
+  if (width <= 8) return 1;
+  if (width <= 16) return 2;
+  if (width <= 32) return 4;
+  return (width+63)/64*8;
+}
+
+
+llvm::APInt get_value(const JitVar_t& var, const std::vector<uint64_t>& buf, uint32_t idx) {
+  const uint8_t *p = (const uint8_t*)buf.data() + idx*var.elemBytes;
+  std::vector<uint64_t> words((var.width+63)/64, 0);
+  memcpy(words.data(), p, std::min<size_t>(var.elemBytes, words.size()*8));
+  return llvm::APInt(var.width, words);
+}
+
+
+void set_value(JitVar_t& var, std::vector<uint64_t>& buf, const llvm::APInt& val, uint32_t idx) {
+  uint8_t *p = (uint8_t*)buf.data() + idx*var.elemBytes;
+  llvm::APInt v = val.zextOrTrunc(var.width);
+  memset(p, 0, var.elemBytes);
+  memcpy(p, v.getRawData(), std::min<size_t>(var.elemBytes, v.getNumWords()*8));
+}
+
+
+JitVar_t& find_var(const std::string& name) {
+  auto it = g_vars.find(name);
+  if (it == g_vars.end()) {
+    toCout("Error: unknown variable: "+name);
+    exit(-1);
+  }
+  return it->second;
+}
+
+
+static std::string cycle_var_name(const std::string& varName, int cycle) {
+  std::string ret = var_name_convert(varName, true);
+  if (cycle > 0) ret += "_cycle"+toStr(cycle);
+  return ret;
+}
+
+
+// The register array that holds the var (by its Verilog or C name), or ""
+static std::string array_position(const std::string& varName, int *idxp) {
+  for (auto& pair : g_registerArrays) {
+    for (uint32_t idx = 0; idx < pair.second.getLength(); idx++) {
+      const std::string& element = pair.second.getElement(idx);
+      if (element == varName || var_name_convert(element, true) == varName) {
+        if (idxp) *idxp = idx;
+        return pair.first;
+      }
+    }
+  }
+  return "";
+}
+
+
+static llvm::APInt rst_value(const std::string& asv, uint32_t width) {
+  std::string noSlash = asv;
+  if (asv.substr(0, 1) == "\\") noSlash = asv.substr(1);
+  auto it = g_rstVal.find(noSlash);
+  if (it == g_rstVal.end()) {
+    toCout("Warning: cannot find rst value for "+noSlash+", using 0");
+    return llvm::APInt(width, 0);
+  }
+  return hdb2apint(it->second).zextOrTrunc(width);
+}
+
+
+static JitVar_t& add_var(const std::string& name, uint32_t width, uint32_t length) {
+  JitVar_t& var = g_vars[name];
+  var.width = width;
+  var.length = length;
+  var.elemBytes = elem_bytes(width);
+  uint32_t words = (std::max(length, 1u)*var.elemBytes+7)/8;
+  var.cur.assign(words, 0);
+  var.nxt.assign(words, 0);
+  return var;
+}
+
+
+// Declare and reset every ASV, like the variables of the sim_gen program
+void init_vars() {
+  for (auto& pair : g_asv) {
+    const std::string& asv = pair.first;
+    if (!array_position(asv, nullptr).empty()) continue;  // Set with its array
+    uint32_t width = pair.second.width;
+    llvm::APInt rst = rst_value(asv, width);
+
+    std::vector<std::string> names;
+    if (pair.second.cycles.empty()) names.push_back(var_name_convert(asv, true));
+    for (int cycle : pair.second.cycles) names.push_back(cycle_var_name(asv, cycle));
+    for (const std::string& name : names) {
+      JitVar_t& var = add_var(name, width, 0);
+      set_value(var, var.cur, rst);
+      set_value(var, var.nxt, rst);
+    }
+  }
+
+  for (auto& pair : g_registerArrays) {
+    uint32_t len = pair.second.getLength();
+    JitVar_t& var = add_var(pair.first, pair.second.getWidth(), len);
+    for (uint32_t idx = 0; idx < len; idx++) {
+      llvm::APInt rst = rst_value(pair.second.getElement(idx), var.width);
+      set_value(var, var.cur, rst, idx);
+      set_value(var, var.nxt, rst, idx);
+    }
+  }
+}
+
+
+// Find the file of every update function.  The files are the ones linked
+// by link.sh, or else all .ll and .bc files in g_path.  The function names
+// are read from the "define" lines of a .ll file and from a lazily loaded
+// .bc module, so no function body is parsed here.
+void index_function_files() {
+  std::vector<std::string> files;
+  std::ifstream script(g_path+"/link.sh");
+  std::string line;
+  while (std::getline(script, line)) {
+    remove_two_end_space(line);
+    if (!line.empty() && line.back() == '\\') line.pop_back();
+    remove_two_end_space(line);
+    if (line.find(' ') != std::string::npos || line == "main.ll") continue;
+    if (line.size() > 3 && line.substr(line.size()-3) == ".ll") files.push_back(line);
+  }
+
+  if (files.empty()) {
+    DIR *dir = opendir(g_path.c_str());
+    if (dir) {
+      while (struct dirent *entry = readdir(dir)) {
+        std::string name = entry->d_name;
+        if (name == "main.ll" || name == "linked.ll" || name.size() < 4) continue;
+        std::string ext = name.substr(name.size()-3);
+        if (ext == ".ll" || ext == ".bc") files.push_back(name);
+      }
+      closedir(dir);
+    }
+  }
+
+  for (const std::string& file : files) {
+    std::string fileName = (file[0] == '/') ? file : g_path+"/"+file;
+    if (fileName.substr(fileName.size()-3) == ".bc") {
+      llvm::SMDiagnostic err;
+      llvm::LLVMContext context;
+      auto M = llvm::getLazyIRFileModule(fileName, err, context);
+      if (!M) continue;
+      for (llvm::Function& func : *M) {
+        if (!func.isDeclaration() || func.isMaterializable())
+          g_funcFiles.emplace(func.getName().str(), fileName);
+      }
+      continue;
+    }
+
+    std::ifstream input(fileName);
+    while (std::getline(input, line)) {
+      if (line.compare(0, 7, "define ") != 0) continue;
+      size_t start = line.find('@');
+      if (start == std::string::npos) continue;
+      start++;
+      size_t end;
+      if (line[start] == '"') {
+        end = line.find('"', ++start);
+      } else {
+        end = line.find('(', start);
+      }
+      if (end == std::string::npos) continue;
+      g_funcFiles.emplace(line.substr(start, end-start), fileName);
+    }
+  }
+  toCoutVerb("Found "+toStr(g_funcFiles.size())+" functions in "+toStr(files.size())+" files");
+}
+
+
+void add_call_stub(llvm::Function *func) {
+  llvm::Module *M = func->getParent();
+  llvm::LLVMContext& context = M->getContext();
+  llvm::Type *bytePtrTy = llvm::Type::getInt8PtrTy(context);
+  llvm::FunctionType *stubTy =
+    llvm::FunctionType::get(llvm::Type::getVoidTy(context),
+                            {bytePtrTy->getPointerTo(), bytePtrTy}, false);
+  llvm::Function *stub =
+    llvm::Function::Create(stubTy, llvm::Function::ExternalLinkage,
+                           func->getName()+CALL_STUB_SUFFIX, M);
+
+  llvm::IRBuilder<> builder(llvm::BasicBlock::Create(context, "entry", stub));
+  std::vector<llvm::Value*> args;
+  for (llvm::Argument& arg : func->args()) {
+    llvm::Value *ptr = builder.CreateLoad(bytePtrTy,
+      builder.CreateConstGEP1_32(bytePtrTy, stub->getArg(0), arg.getArgNo()));
+    llvm::Type *argTy = arg.getType();
+    if (argTy->isPointerTy()) {
+      args.push_back(builder.CreateBitCast(ptr, argTy));
+    } else if (argTy->isIntegerTy() && argTy->getIntegerBitWidth() <= 128) {
+      // Args of up to 128 bits are kept in a C integer of the next standard size
+      llvm::Type *storeTy = builder.getIntNTy(elem_bytes(argTy->getIntegerBitWidth())*8);
+      llvm::Value *val = builder.CreateLoad(storeTy,
+                                            builder.CreateBitCast(ptr, storeTy->getPointerTo()));
+      args.push_back(builder.CreateZExtOrTrunc(val, argTy));
+    } else {
+      toCout("Error: unsupported type of arg "+arg.getName().str()+" of "+func->getName().str());
+      exit(-1);
+    }
+  }
+
+  llvm::CallInst *call = builder.CreateCall(func, args);
+  call->setCallingConv(func->getCallingConv());
+  llvm::Type *retTy = func->getReturnType();
+  if (retTy->isIntegerTy()) {
+    llvm::Type *storeTy = builder.getIntNTy(elem_bytes(retTy->getIntegerBitWidth())*8);
+    builder.CreateStore(builder.CreateZExtOrTrunc(call, storeTy),
+                        builder.CreateBitCast(stub->getArg(1), storeTy->getPointerTo()));
+  } else if (!retTy->isVoidTy()) {
+    toCout("Error: unsupported return type of "+func->getName().str());
+    exit(-1);
+  }
+  builder.CreateRetVoid();
+}
+
+
+// Parse the file of the update function (on first use of the file) and
+// add it to the JIT, which compiles the function when it is first called.
+JitCallFunc_t load_function(const std::string& funcName) {
+  auto callIt = g_callFuncs.find(funcName);
+  if (callIt != g_callFuncs.end()) return callIt->second;
+
+  auto fileIt = g_funcFiles.find(funcName);
+  if (fileIt == g_funcFiles.end()) {
+    toCout("Error: cannot find the LLVM file of update function "+funcName);
+    exit(-1);
+  }
+  const std::string& fileName = fileIt->second;
+
+  if (!g_loadedFiles.count(fileName)) {
+    g_loadedFiles.insert(fileName);
+    toCoutVerb("Loading "+fileName);
+    llvm::SMDiagnostic err;
+    std::unique_ptr<llvm::Module> M = llvm::parseIRFile(fileName, err, *g_tsCtx.getContext());
+    if (!M) {
+      err.print("ila_jit", llvm::errs());
+      exit(-1);
+    }
+    M->setDataLayout(g_jit->getDataLayout());
+    std::vector<llvm::Function*> funcs;
+    for (llvm::Function& func : *M) {
+      if (!func.isDeclaration() && g_funcFiles.count(func.getName().str()))
+        funcs.push_back(&func);
+    }
+    for (llvm::Function *func : funcs) add_call_stub(func);
+    g_exitOnErr(g_jit->addLazyIRModule(llvm::orc::ThreadSafeModule(std::move(M), g_tsCtx)));
+  }
+
+  auto sym = g_exitOnErr(g_jit->lookup(funcName+CALL_STUB_SUFFIX));
+  JitCallFunc_t func = (JitCallFunc_t)sym.getAddress();
+  g_callFuncs.emplace(funcName, func);
+  return func;
+}
+
+
+// Bind the update function calls of the instruction, as they are made by
+// the instruction function of sim_gen (see print_instr_calls()).
+void bind_instr(uint32_t instrIdx) {
+  InstrInfo_t& instrInfo = g_instrInfo[instrIdx];
+  JitInstr_t& jitInstr = g_jitInstrs[instrIdx];
+
+  if (instrInfo.funcTypes.empty()) {
+    toCout("Error: no func_info found for instruction: "+instrInfo.name);
+    exit(-1);
+  }
+  if (!instrInfo.memReadAddr2TgtMap.empty()) {
+    toCout("Error: instruction "+instrInfo.name+" reads data memory, which is not supported");
+    exit(-1);
+  }
+
+  // Reserve the constant args first, so the pointers to them stay valid
+  uint32_t argNum = 0;
+  for (auto& pair : instrInfo.funcTypes) argNum += pair.second.argTy.size();
+  jitInstr.constArgs.reserve(argNum);
+  jitInstr.fields.reserve(argNum);
+
+  std::string instrAddr;
+  if (!instrInfo.instrAddr.empty()) instrAddr = var_name_convert(instrInfo.instrAddr, true);
+
+  std::set<std::string> remappedVars;
+  for (auto& pair : instrInfo.funcTypes) {
+    const std::string& origWriteASV = pair.first;
+    const FuncTy_t& funcTy = pair.second;
+    if (g_skippedTgt.count(origWriteASV) || remappedVars.count(origWriteASV)) continue;
+
+    std::string writeASV = var_name_convert(origWriteASV, true);
+    JitCallFunc_t func = load_function(funcTy.alias.empty() ? instrInfo.name+"_"+writeASV+"_wrapper"
+                                                            : funcTy.alias);
+
+    std::vector<std::string> varNames;
+    if (instrInfo.funcTgtMap.count(origWriteASV)) {
+      for (const std::string& origMappedVar : instrInfo.funcTgtMap[origWriteASV]) {
+        remappedVars.insert(origMappedVar);
+        varNames.push_back(var_name_convert(origMappedVar, true));
+      }
+    } else {
+      varNames.push_back(writeASV);
+    }
+
+    for (const std::string& varName : varNames) {
+      JitCall_t call;
+      call.func = func;
+      call.target = &find_var(varName);
+      if (varName == instrAddr) jitInstr.instrAddr = call.target;
+
+      for (const Arg_t& arg : funcTy.argTy) {
+        if (is_special_arg_name(arg.name)) {
+          call.args.push_back(call.target->nxt.data());
+          continue;
+        }
+
+        if (const InstrField_t *field = find_field_arg(instrInfo, arg.name)) {
+          JitField_t jitField;
+          jitField.signal = &find_var(cycle_var_name(field->signal, field->cycle));
+          jitField.lo = field->lo;
+          jitField.value.width = field->hi - field->lo + 1;
+          jitField.value.elemBytes = elem_bytes(jitField.value.width);
+          jitField.value.cur.assign((jitField.value.elemBytes+7)/8, 0);
+          jitInstr.fields.push_back(jitField);
+          call.args.push_back(jitInstr.fields.back().value.cur.data());
+          continue;
+        }
+
+        // A value fully given by instr.txt is a constant
+        auto pos = instrInfo.instrEncoding.find(arg.name);
+        if (pos != instrInfo.instrEncoding.end()) {
+          const std::string& argValue = (arg.cycle > 0) ? pos->second[arg.cycle-1]
+                                                        : pos->second.front();
+          if (!contains_x(argValue)) {
+            JitVar_t tmp;
+            tmp.width = std::abs(arg.width);
+            tmp.elemBytes = elem_bytes(tmp.width);
+            jitInstr.constArgs.emplace_back((tmp.elemBytes+7)/8, 0);
+            set_value(tmp, jitInstr.constArgs.back(), convert_to_single_apint(argValue));
+            call.args.push_back(jitInstr.constArgs.back().data());
+            continue;
+          }
+        }
+
+        int idx = 0;
+        std::string arrayName = array_position(arg.name, &idx);
+        if (g_registerArrays.count(arg.name)) {
+          call.args.push_back(find_var(arg.name).cur.data());
+        } else if (!arrayName.empty()) {
+          JitVar_t& arr = find_var(arrayName);
+          call.args.push_back((uint8_t*)arr.cur.data() + idx*arr.elemBytes);
+        } else {
+          call.args.push_back(find_var(cycle_var_name(arg.name, arg.cycle)).cur.data());
+        }
+      }
+      jitInstr.calls.push_back(call);
+    }
+  }
+  jitInstr.bound = true;
+}
+
+
+// Set the variables given by a tb.txt command, as collect_var_assignments()
+// of sim_gen does
+void set_var_values(const InstEncoding_t& encoding, uint32_t instrIdx) {
+  for (auto& pair : g_instrInfo[instrIdx].funcTypes) {
+    for (const Arg_t& funcArg : pair.second.argTy) {
+      if (is_special_arg_name(funcArg.name)) continue;
+      Arg_t arg = arg_var(g_instrInfo[instrIdx], funcArg);
+      auto pos = encoding.find(arg.name);
+      if (pos == encoding.end()) continue;
+      if (pos->second.size() < (uint32_t)arg.cycle) {
+        toCout("Error: tb.txt not enough per-cycle data for arg "+arg.name);
+        exit(-1);
+      }
+      const std::string& argValue = (arg.cycle > 0) ? pos->second[arg.cycle-1]
+                                                    : pos->second.front();
+      JitVar_t& var = find_var(cycle_var_name(arg.name, arg.cycle));
+      set_value(var, var.cur, convert_to_single_apint(argValue));
+    }
+  }
+}
+
+
+void execute_instr(uint32_t instrIdx) {
+  JitInstr_t& jitInstr = g_jitInstrs[instrIdx];
+  if (!jitInstr.bound) bind_instr(instrIdx);
+
+  if (g_printAll) printf("// instr%d: %s\n\n", instrIdx, g_instrInfo[instrIdx].name.c_str());
+
+  for (JitField_t& field : jitInstr.fields) {
+    llvm::APInt val = get_value(*field.signal, field.signal->cur);
+    set_value(field.value, field.value.cur, val.lshr(field.lo));
+  }
+
+  // All update functions see the old values
+  for (JitCall_t& call : jitInstr.calls)
+    call.func(call.args.data(), call.target->nxt.data());
+  for (JitCall_t& call : jitInstr.calls)
+    call.target->cur = call.target->nxt;
+  if (jitInstr.instrAddr) {
+    JitVar_t& addr = find_var(g_instrAddrVar);
+    set_value(addr, addr.cur, get_value(*jitInstr.instrAddr, jitInstr.instrAddr->cur));
+  }
+
+  print_asvs("Updated ASV values:");
+}
+
+
+// Same format as the generated print_asvs() (see build_printf())
+static void print_value(const std::string& name, const llvm::APInt& val) {
+  const char *radix = g_hex ? "x" : "d";
+  uint32_t width = val.getBitWidth();
+  if (width <= 32) {
+    printf((std::string("%s: %")+radix+"\n").c_str(), name.c_str(), (uint32_t)val.getZExtValue());
+  } else if (width <= 64) {
+    printf((std::string("%s: %l")+radix+"\n").c_str(), name.c_str(), val.getZExtValue());
+  } else {
+    printf("%s: {", name.c_str());
+    for (int j = val.getNumWords()-1; j >= 0; j--) {
+      printf((std::string("%l")+radix+"%s").c_str(), val.getRawData()[j], j > 0 ? ", " : "");
+    }
+    printf("}\n");
+  }
+}
+
+
+void print_asvs(const std::string& bannerLine) {
+  if (!g_printAll) return;
+  if (!bannerLine.empty()) printf("%s\n", bannerLine.c_str());
+
+  for (auto& pair : g_asv) {
+    if (!array_position(pair.first, nullptr).empty()) continue;
+    std::vector<std::string> names;
+    if (pair.second.cycles.empty()) names.push_back(var_name_convert(pair.first, true));
+    for (int cycle : pair.second.cycles) names.push_back(cycle_var_name(pair.first, cycle));
+    for (const std::string& name : names) {
+      const JitVar_t& var = find_var(name);
+      print_value(name, get_value(var, var.cur));
+    }
+  }
+
+  for (auto& pair : g_registerArrays) {
+    const JitVar_t& var = find_var(pair.first);
+    for (uint32_t idx = 0; idx < var.length; idx++) {
+      char index[32];
+      snprintf(index, sizeof(index), g_hex ? "[%x]" : "[%d]", idx);
+      print_value(pair.first+index, get_value(var, var.cur, idx));
+    }
+  }
+  printf("\n");
+}
+
+
+void run_tb(const std::string& fileName) {
+  std::vector<InstEncoding_t> toDoList;
+  read_to_do_instr(fileName, toDoList);
+  for (const InstEncoding_t& encoding : toDoList) {
+    uint32_t instrIdx = get_instr_by_name(decode(encoding));
+    set_var_values(encoding, instrIdx);
+    execute_instr(instrIdx);
+  }
+}
+
+
+// Fetch and execute instrNum instructions from the memory image, like the
+// fetch loop of a sim_gen -proc program.  Each memory word is decoded once.
+void run_mem(const std::string& fileName, int instrNum) {
+  std::vector<llvm::APInt> mem;
+  std::ifstream input(fileName);
+  std::string line;
+  while (std::getline(input, line)) {
+    remove_two_end_space(line);
+    if (!line.empty()) mem.push_back(convert_to_single_apint(line));
+  }
+  if (mem.empty()) {
+    toCout("Error: no memory data could be read");
+    exit(-1);
+  }
+
+  std::vector<DecodePattern_t> patterns;
+  for (uint32_t i = 0; i < g_instrInfo.size(); i++) {
+    auto pos = g_instrInfo[i].instrEncoding.find(g_instrValueVar);
+    if (pos == g_instrInfo[i].instrEncoding.end()) continue;
+    const std::string& instrValueStr = pos->second.front();
+    patterns.push_back({convert_to_single_apint(instrValueStr),
+                        convert_to_single_apint(instrValueStr, true/*xmask*/), i});
+  }
+  DecodeTree tree;
+  tree.build(patterns);
+  std::vector<uint32_t> decoded(mem.size(), DecodeTree::NO_INSTR);
+
+  JitVar_t& addrVar = find_var(g_instrAddrVar);
+  JitVar_t& valueVar = find_var(g_instrValueVar);
+  for (int i = 0; i < instrNum; i++) {
+    uint32_t addr = (get_value(addrVar, addrVar.cur).getZExtValue() >> 2) % mem.size();
+    if (decoded[addr] == DecodeTree::NO_INSTR) decoded[addr] = tree.lookup(mem[addr]);
+    if (decoded[addr] == DecodeTree::NO_INSTR) {
+      toCout("Cannot decode instruction!");
+      exit(-1);
+    }
+    set_value(valueVar, valueVar.cur, mem[addr]);
+    execute_instr(decoded[addr]);
+  }
+}
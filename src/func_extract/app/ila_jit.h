@@ -0,0 +1,77 @@
+#include <set>
+#include <string>
+#include <map>
+#include <vector>
+#include "../src/global_data_struct.h"
+#include "llvm/ADT/APInt.h"
+#include "llvm/IR/Function.h"
+
+
+// One C variable of sim_gen: a scalar ASV or a register array.
+// The values are kept in the memory layout of the C type, so the
+// update functions can be given pointers to them.
+struct JitVar_t {
+  uint32_t width = 0;
+  uint32_t length = 0;     // Array length, 0 for a scalar
+  uint32_t elemBytes = 0;  // Size of the C type of one element
+  std::vector<uint64_t> cur;
+  std::vector<uint64_t> nxt;
+};
+
+// Calls an update function with pointers to its args (pointer args
+// are passed on as they are), and stores any return value through ret.
+typedef void (*JitCallFunc_t)(void **args, void *ret);
+
+struct JitCall_t {
+  JitCallFunc_t func;
+  std::vector<void*> args;
+  JitVar_t *target;
+};
+
+// A symbolic field arg of an instruction family, decoded from its
+// signal before the calls
+struct JitField_t {
+  const JitVar_t *signal;
+  uint32_t lo;
+  JitVar_t value;  // Only cur is used
+};
+
+// The update function calls of an instruction, bound to the variables
+// when the instruction is executed for the first time.
+struct JitInstr_t {
+  bool bound = false;
+  std::vector<JitCall_t> calls;
+  std::vector<std::vector<uint64_t>> constArgs;  // Args fixed by instr.txt
+  std::vector<JitField_t> fields;
+  JitVar_t *instrAddr = nullptr;  // Also copied to g_instrAddrVar
+};
+
+
+uint32_t elem_bytes(uint32_t width);
+
+llvm::APInt get_value(const JitVar_t& var, const std::vector<uint64_t>& buf, uint32_t idx = 0);
+
+void set_value(JitVar_t& var, std::vector<uint64_t>& buf, const llvm::APInt& val, uint32_t idx = 0);
+
+JitVar_t& find_var(const std::string& name);
+
+void init_vars();
+
+void index_function_files();
+
+// Add <func>_jit_call, which calls func as described for JitCallFunc_t
+void add_call_stub(llvm::Function *func);
+
+JitCallFunc_t load_function(const std::string& funcName);
+
+void bind_instr(uint32_t instrIdx);
+
+void set_var_values(const funcExtract::InstEncoding_t& encoding, uint32_t instrIdx);
+
+void execute_instr(uint32_t instrIdx);
+
+void print_asvs(const std::string& bannerLine);
+
+void run_tb(const std::string& fileName);
+
+void run_mem(const std::string& fileName, int instrNum);
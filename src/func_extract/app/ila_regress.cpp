@@ -0,0 +1,387 @@
+#include "ila_regress.h"
+#include "../src/helper.h"
+#include "../src/util.h"
+#include "../src/read_instr.h"
+
+#include <dlfcn.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <cstring>
+#include <algorithm>
+
+#define toCout(a) std::cout << a << std::endl
+
+#define toStr(a) std::to_string(a)
+
+using namespace funcExtract;
+using namespace taintGen;
+
+// ila_regress runs many test programs on the simulator library built from
+// sim_gen -lib (libila.so), in one process.  The tests are split among a
+// pool of threads, each with its own IlaState, so no test starts a process
+// or compiles anything.
+//
+// A test is a tb.txt-style file written by test_gen (*.txt), or a binary
+// command file of sim_gen -runtime (*.bin, with the var ids of
+// cmd_layout.txt).  For every test, the report gives PASS or FAIL, the
+// number of instructions, and a digest of the final values of all ASVs and
+// register arrays.  With -expect, the digests are compared with those of an
+// earlier report, and a test with a different digest fails.
+
+IlaApi_t g_api;
+std::vector<std::string> g_cmdVarNames;  // Var id of cmd_layout.txt -> C name
+std::map<std::string, uint64_t> g_expected;  // Test -> digest of a passed test
+
+
+int main(int argc, char *argv[]) {
+
+  std::string usageStr = std::string("usage: ")+argv[0]+ " [<path>] <test dir or manifest> [-lib <libila.so>] [-j <threads>] [-o <report>] [-expect <report>] [-verbose]";
+
+  g_path = ".";   // Default path is current dir
+  g_verb = false;
+
+  std::vector<std::string> positional;
+  std::string libName, reportName, expectName;
+  uint32_t threadNum = std::max(1u, std::thread::hardware_concurrency());
+
+  for (int n = 1; n < argc; ++n) {
+    const char *arg = argv[n];
+
+    if (arg[0] != '-') {
+      positional.push_back(arg);
+    } else if (!strcmp(arg, "-lib") && n+1 < argc) {
+      libName = argv[++n];
+    } else if (!strcmp(arg, "-j") && n+1 < argc) {
+      threadNum = std::max(1, std::stoi(argv[++n]));
+    } else if (!strcmp(arg, "-o") && n+1 < argc) {
+      reportName = argv[++n];
+    } else if (!strcmp(arg, "-expect") && n+1 < argc) {
+      expectName = argv[++n];
+    } else if (!strcmp(arg, "-verbose")) {
+      g_verb = true;
+    } else {
+      toCout(usageStr);
+      exit(-1);
+    }
+  }
+
+  if (positional.empty() || positional.size() > 2) {
+    toCout(usageStr);
+    exit(-1);
+  }
+  if (positional.size() == 2) g_path = positional[0];
+  std::string testsName = positional.back();
+  if (libName.empty()) libName = g_path+"/libila.so";
+  if (reportName.empty()) reportName = g_path+"/regress_report.txt";
+
+  read_in_instructions(g_path+"/instr.txt");
+  read_asv_info(g_path+"/asv_info.txt");
+  read_func_info(g_path+"/func_info.txt");
+  read_cmd_layout(g_path+"/cmd_layout.txt");
+  load_ila_lib(libName);
+  if (!expectName.empty()) read_expected(expectName);
+
+  std::vector<std::string> tests;
+  collect_tests(testsName, tests);
+  if (tests.empty()) {
+    toCout("Error: no tests found in "+testsName);
+    exit(-1);
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  std::vector<RegressResult_t> results;
+  run_tests(tests, threadNum, results);
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now()-start).count();
+
+  write_report(reportName, tests, results);
+
+  uint32_t passNum = std::count_if(results.begin(), results.end(),
+                                   [](const RegressResult_t& r) { return r.pass; });
+  toCout("### "+toStr(tests.size())+" tests on "+toStr(threadNum)+" threads in "
+         +toStr(seconds)+" s: "+toStr(passNum)+" passed, "
+         +toStr(tests.size()-passNum)+" failed.  Report: "+reportName);
+  return passNum == tests.size() ? 0 : 1;
+}
+
+
+template <class T>
+static void load_symbol(void *lib, const char *name, T& func) {
+  func = (T)dlsym(lib, name);
+  if (!func) {
+    toCout("Error: cannot find "+std::string(name)+", is this a library of sim_gen -lib?");
+    exit(-1);
+  }
+}
+
+
+void load_ila_lib(const std::string& libName) {
+  void *lib = dlopen(libName.c_str(), RTLD_NOW | RTLD_LOCAL);
+  if (!lib) {
+    toCout("Error: cannot load "+libName+": "+dlerror());
+    exit(-1);
+  }
+  load_symbol(lib, "ila_create", g_api.create);
+  load_symbol(lib, "ila_destroy", g_api.destroy);
+  load_symbol(lib, "ila_init", g_api.init);
+  load_symbol(lib, "ila_step", g_api.step);
+  load_symbol(lib, "ila_asv_width", g_api.asv_width);
+  load_symbol(lib, "ila_get_asv", g_api.get_asv);
+  load_symbol(lib, "ila_set_asv", g_api.set_asv);
+  load_symbol(lib, "ila_get_array", g_api.get_array);
+  load_symbol(lib, "ila_array_width", g_api.array_width);
+  load_symbol(lib, "ila_array_length", g_api.array_length);
+  load_symbol(lib, "ila_asv_name", g_api.asv_name);
+  load_symbol(lib, "ila_array_name", g_api.array_name);
+}
+
+
+// Only needed for *.bin tests.  Lines: "var <id> <width> <name>"
+void read_cmd_layout(const std::string& fileName) {
+  std::ifstream input(fileName);
+  std::string line;
+  while (std::getline(input, line)) {
+    std::istringstream ss(line);
+    std::string kind, name;
+    uint32_t varId, width;
+    if (!(ss >> kind) || kind != "var" || !(ss >> varId >> width >> name)) continue;
+    if (varId >= g_cmdVarNames.size()) g_cmdVarNames.resize(varId+1);
+    g_cmdVarNames[varId] = name;
+  }
+}
+
+
+static bool is_test_file(const std::string& name) {
+  return name.size() > 4 && (name.substr(name.size()-4) == ".txt"
+                             || name.substr(name.size()-4) == ".bin");
+}
+
+
+// All *.txt and *.bin files of a directory, or the files listed in a
+// manifest (one per line, "#" for comments)
+void collect_tests(const std::string& testsName, std::vector<std::string>& tests) {
+  struct stat statbuf;
+  if (stat(testsName.c_str(), &statbuf) != 0) {
+    toCout("Error: cannot find "+testsName);
+    exit(-1);
+  }
+
+  if (S_ISDIR(statbuf.st_mode)) {
+    DIR *dir = opendir(testsName.c_str());
+    while (struct dirent *entry = readdir(dir)) {
+      std::string name = entry->d_name;
+      if (is_test_file(name)) tests.push_back(testsName+"/"+name);
+    }
+    closedir(dir);
+    std::sort(tests.begin(), tests.end());
+    return;
+  }
+
+  std::ifstream input(testsName);
+  std::string line;
+  while (std::getline(input, line)) {
+    remove_two_end_space(line);
+    if (line.empty() || line[0] == '#') continue;
+    tests.push_back(line);
+  }
+}
+
+
+// Digests of the tests that passed in an earlier report
+void read_expected(const std::string& fileName) {
+  std::ifstream input(fileName);
+  if (!input.is_open()) {
+    toCout("Error: cannot read "+fileName);
+    exit(-1);
+  }
+  std::string line;
+  while (std::getline(input, line)) {
+    std::istringstream ss(line);
+    std::string status, digest, test;
+    uint64_t instrNum;
+    if (!(ss >> status >> digest >> instrNum >> test) || status != "PASS") continue;
+    g_expected[test] = std::stoull(digest, nullptr, 16);
+  }
+}
+
+
+// Convert the instructions of a tb.txt file, as collect_var_assignments()
+// of sim_gen does
+bool read_tb_test(const std::string& fileName, std::vector<RegressCmd_t>& cmds, std::string& message) {
+  if (!std::ifstream(fileName).is_open()) {
+    message = "cannot read the test";
+    return false;
+  }
+  std::vector<InstEncoding_t> toDoList;
+  read_to_do_instr(fileName, toDoList);
+
+  // decode() builds its decode tree on the first call
+  static std::once_flag decodeOnce;
+  if (!toDoList.empty()) std::call_once(decodeOnce, [&]() { decode(toDoList.front()); });
+
+  for (const InstEncoding_t& encoding : toDoList) {
+    RegressCmd_t cmd;
+    cmd.instrIdx = get_instr_by_name(decode(encoding));
+    std::set<std::string> processedVars;
+    for (auto& pair : g_instrInfo[cmd.instrIdx].funcTypes) {
+      for (const Arg_t& funcArg : pair.second.argTy) {
+        if (is_special_arg_name(funcArg.name)) continue;
+        Arg_t arg = arg_var(g_instrInfo[cmd.instrIdx], funcArg);
+        auto pos = encoding.find(arg.name);
+        if (pos == encoding.end()) continue;
+        if (pos->second.size() < (uint32_t)arg.cycle) {
+          message = "not enough per-cycle data for "+arg.name;
+          return false;
+        }
+        std::string varName = var_name_convert(arg.name, true);
+        if (arg.cycle > 0) varName += "_cycle"+toStr(arg.cycle);
+        if (!processedVars.insert(varName).second) continue;
+
+        int width = g_api.asv_width(varName.c_str());
+        if (width < 0) {
+          message = varName+" is not an ASV of the library";
+          return false;
+        }
+        const std::string& argValue = (arg.cycle > 0) ? pos->second[arg.cycle-1]
+                                                      : pos->second.front();
+        llvm::APInt val = convert_to_single_apint(argValue).zextOrTrunc(width);
+        cmd.assigns.emplace_back(varName, std::vector<uint64_t>(val.getRawData(),
+                                                                val.getRawData()+val.getNumWords()));
+      }
+    }
+    cmds.push_back(cmd);
+  }
+  return true;
+}
+
+
+// Read a command file of sim_gen -runtime (see write_command_file())
+bool read_bin_test(const std::string& fileName, std::vector<RegressCmd_t>& cmds, std::string& message) {
+  FILE *file = fopen(fileName.c_str(), "rb");
+  if (!file) {
+    message = "cannot read the test";
+    return false;
+  }
+  char magic[4];
+  uint32_t version, cmd[2], assign[2];
+  bool ok = fread(magic, 1, 4, file) == 4 && memcmp(magic, "ILAC", 4) == 0
+            && fread(&version, sizeof(version), 1, file) == 1 && version == 1;
+  while (ok && fread(cmd, sizeof(uint32_t), 2, file) == 2) {
+    RegressCmd_t regressCmd;
+    regressCmd.instrIdx = cmd[0];
+    for (uint32_t i = 0; ok && i < cmd[1]; ++i) {
+      ok = fread(assign, sizeof(uint32_t), 2, file) == 2 && assign[0] < g_cmdVarNames.size();
+      if (!ok) break;
+      std::vector<uint64_t> words(assign[1]);
+      ok = fread(words.data(), sizeof(uint64_t), assign[1], file) == assign[1];
+      regressCmd.assigns.emplace_back(g_cmdVarNames[assign[0]], words);
+    }
+    cmds.push_back(regressCmd);
+  }
+  fclose(file);
+  if (!ok) message = "broken command file, or var ids that are not in cmd_layout.txt";
+  return ok;
+}
+
+
+// FNV-1a over the words of all ASVs and register array elements
+uint64_t asv_digest(IlaState *ila) {
+  uint64_t hash = 0xcbf29ce484222325ull;
+  auto add = [&hash](const std::vector<uint64_t>& words) {
+    for (uint64_t word : words) {
+      for (int i = 0; i < 8; ++i) {
+        hash ^= (word >> (8*i)) & 0xff;
+        hash *= 0x100000001b3ull;
+      }
+    }
+  };
+
+  std::vector<uint64_t> words;
+  for (uint32_t i = 0; const char *name = g_api.asv_name(i); ++i) {
+    words.assign((g_api.asv_width(name)+63)/64, 0);
+    g_api.get_asv(ila, name, words.data(), words.size());
+    add(words);
+  }
+  for (uint32_t i = 0; const char *name = g_api.array_name(i); ++i) {
+    int length = g_api.array_length(name);
+    words.assign((g_api.array_width(name)+63)/64, 0);
+    for (int idx = 0; idx < length; ++idx) {
+      g_api.get_array(ila, name, idx, words.data(), words.size());
+      add(words);
+    }
+  }
+  return hash;
+}
+
+
+void run_test(IlaState *ila, const std::string& test, RegressResult_t& result) {
+  std::vector<RegressCmd_t> cmds;
+  bool isBin = test.size() > 4 && test.substr(test.size()-4) == ".bin";
+  if (!(isBin ? read_bin_test(test, cmds, result.message)
+              : read_tb_test(test, cmds, result.message)))
+    return;
+
+  g_api.init(ila);
+  for (const RegressCmd_t& cmd : cmds) {
+    for (auto& assign : cmd.assigns) {
+      if (g_api.set_asv(ila, assign.first.c_str(), assign.second.data(), assign.second.size()) != 0) {
+        result.message = "cannot set "+assign.first;
+        return;
+      }
+    }
+    if (g_api.step(ila, cmd.instrIdx) != 0) {
+      result.message = "unknown instruction "+toStr(cmd.instrIdx);
+      return;
+    }
+    result.instrNum++;
+  }
+
+  result.digest = asv_digest(ila);
+  auto pos = g_expected.find(test);
+  if (pos != g_expected.end() && pos->second != result.digest) {
+    std::ostringstream ss;
+    ss << "final ASVs differ, expected digest " << std::hex << pos->second;
+    result.message = ss.str();
+    return;
+  }
+  result.pass = true;
+}
+
+
+// Every thread takes the next test until none are left
+void run_tests(const std::vector<std::string>& tests, uint32_t threadNum,
+               std::vector<RegressResult_t>& results) {
+  results.assign(tests.size(), RegressResult_t());
+  std::atomic<size_t> nextTest(0);
+
+  auto worker = [&]() {
+    IlaState *ila = g_api.create();
+    for (size_t i = nextTest++; i < tests.size(); i = nextTest++) {
+      run_test(ila, tests[i], results[i]);
+      if (g_verb) toCout(tests[i]+(results[i].pass ? ": PASS" : ": FAIL"));
+    }
+    g_api.destroy(ila);
+  };
+
+  std::vector<std::thread> threads;
+  for (uint32_t i = 0; i < std::min<size_t>(threadNum, tests.size()); ++i)
+    threads.emplace_back(worker);
+  for (std::thread& thread : threads) thread.join();
+}
+
+
+// One line per test: PASS|FAIL <digest> <instruction count> <test>[  # <why it failed>]
+void write_report(const std::string& fileName, const std::vector<std::string>& tests,
+                  const std::vector<RegressResult_t>& results) {
+  std::ofstream output(fileName);
+  for (size_t i = 0; i < tests.size(); ++i) {
+    const RegressResult_t& result = results[i];
+    output << (result.pass ? "PASS " : "FAIL ") << std::hex << result.digest << std::dec
+           << " " << result.instrNum << " " << tests[i];
+    if (!result.pass) output << "  # " << result.message;
+    output << std::endl;
+  }
+}
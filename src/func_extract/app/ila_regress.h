@@ -0,0 +1,60 @@
+#include <string>
+#include <map>
+#include <vector>
+#include <cstdint>
+#include "../src/global_data_struct.h"
+
+
+// The C API of libila.so (see ila_api.h, written by sim_gen -lib)
+struct IlaState;
+
+struct IlaApi_t {
+  IlaState *(*create)();
+  void (*destroy)(IlaState *ila);
+  void (*init)(IlaState *ila);
+  int (*step)(IlaState *ila, uint32_t instrIdx);
+  int (*asv_width)(const char *name);
+  int (*get_asv)(IlaState *ila, const char *name, uint64_t *words, uint32_t wordNum);
+  int (*set_asv)(IlaState *ila, const char *name, const uint64_t *words, uint32_t wordNum);
+  int (*get_array)(IlaState *ila, const char *name, uint32_t idx, uint64_t *words, uint32_t wordNum);
+  int (*array_width)(const char *name);
+  int (*array_length)(const char *name);
+  const char *(*asv_name)(uint32_t asvIdx);
+  const char *(*array_name)(uint32_t arrayIdx);
+};
+
+// One instruction of a test, and the ASVs it sets first
+struct RegressCmd_t {
+  uint32_t instrIdx;
+  std::vector<std::pair<std::string, std::vector<uint64_t>>> assigns;
+};
+
+struct RegressResult_t {
+  bool pass = false;
+  uint64_t instrNum = 0;
+  uint64_t digest = 0;  // Of the final ASV values
+  std::string message;  // Why the test failed
+};
+
+
+void load_ila_lib(const std::string& libName);
+
+void read_cmd_layout(const std::string& fileName);
+
+void collect_tests(const std::string& testsName, std::vector<std::string>& tests);
+
+void read_expected(const std::string& fileName);
+
+bool read_tb_test(const std::string& fileName, std::vector<RegressCmd_t>& cmds, std::string& message);
+
+bool read_bin_test(const std::string& fileName, std::vector<RegressCmd_t>& cmds, std::string& message);
+
+uint64_t asv_digest(IlaState *ila);
+
+void run_test(IlaState *ila, const std::string& test, RegressResult_t& result);
+
+void run_tests(const std::vector<std::string>& tests, uint32_t threadNum,
+               std::vector<RegressResult_t>& results);
+
+void write_report(const std::string& fileName, const std::vector<std::string>& tests,
+                  const std::vector<RegressResult_t>& results);
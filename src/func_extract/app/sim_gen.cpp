@@ -3,6 +3,8 @@
 #include "../src/helper.h"
 #include "../src/util.h"
 #include "../src/vcd_parser.h"
+#include "../src/decode_tree.h"
+#include "../src/trace_reader.h"
 #include <sys/stat.h>
 
 #define toCout(a) std::cout << a << std::endl
@@ -37,6 +39,12 @@ std::string g_dataIn = "zy_data_in";
 std::string nxt = "_nxt";
 
 bool g_separate_main = false;
+uint32_t g_icacheMaxSize = 4096;  // Entries of the decoded-instruction cache
+bool g_runtime_cmds = false;    // main() executes a command file instead of tb.txt
+bool g_cmds_only = false;       // only write tb.bin
+uint32_t g_lanes = 0;           // >0: every ASV is an array over this many simulations
+bool g_lib = false;             // ASVs are members of IlaState, behind a C API
+std::vector<std::string> g_stateMacros;  // -lib: #defines of the IlaState members
 std::string g_radixChar = "d";  // Optionally "h" for hex
 bool g_hex = false;             // Optionally true for hex
 
@@ -50,6 +58,17 @@ std::set<std::string> g_skippedTgt;
 // enable: pico
 // disable: aes
 bool g_update_all_regs = false;
+// Update register arrays in place where that is safe, instead of copying
+// the whole arr_nxt after every instruction that writes them
+bool g_arrays_in_place = true;
+bool g_checkpoint = false;      // main() can save and restore checkpoint files
+bool g_trace = false;           // PRINT_ALL writes a binary trace instead of text
+bool g_paged_mem = false;       // mem is a sparse page table, loaded at runtime
+bool g_profile = false;         // the simulator counts the instruction sequences it runs
+uint32_t g_fuse = 0;            // fused functions for this many sequences of instr_profile.txt
+bool g_mux_profile = false;     // update functions are instrumented with mux counters
+const uint32_t g_fusedMaxLen = 3;
+std::vector<std::vector<uint32_t>> g_fusedSeqs;  // Instr indices of each fused function
 
 enum DESIGN{AES, PICO, URV, VTA, BI, ACCEL, PROC};
 enum DESIGN g_design;
@@ -57,7 +76,7 @@ enum DESIGN g_design;
 // the second argument is the number of instructions, but only for fetch_instr_from_mem mode
 int main(int argc, char *argv[]) {
 
-  std::string usageStr = std::string("usage: ")+argv[0]+ " [<path>] [<instr_num>] [<design_opt>] [-verbose] [-separate_main] [-hex]";
+  std::string usageStr = std::string("usage: ")+argv[0]+ " [<path>] [<instr_num>] [<design_opt>] [-verbose] [-separate_main] [-hex] [-runtime] [-cmds_only] [-lanes <n>] [-lib] [-copy_arrays] [-checkpoint] [-trace] [-paged_mem] [-profile] [-fuse <n>] [-mux_profile]";
 
   g_path = ".";   // Default path is current dir
   g_verb = false;
@@ -92,6 +111,34 @@ int main(int argc, char *argv[]) {
       userQuiet = true;
     } else if (!strcmp(arg, "-separate_main")) {
       g_separate_main = true;
+    } else if (!strcmp(arg, "-runtime")) {
+      g_runtime_cmds = true;
+    } else if (!strcmp(arg, "-lanes") && n+1 < argc) {
+      g_lanes = std::stoi(argv[++n]);
+      g_runtime_cmds = true;
+      if (g_lanes == 0) {
+        toCout(usageStr);
+        exit(-1);
+      }
+    } else if (!strcmp(arg, "-lib")) {
+      g_lib = true;
+    } else if (!strcmp(arg, "-cmds_only")) {
+      g_runtime_cmds = true;
+      g_cmds_only = true;
+    } else if (!strcmp(arg, "-copy_arrays")) {
+      g_arrays_in_place = false;
+    } else if (!strcmp(arg, "-checkpoint")) {
+      g_checkpoint = true;
+    } else if (!strcmp(arg, "-trace")) {
+      g_trace = true;
+    } else if (!strcmp(arg, "-paged_mem")) {
+      g_paged_mem = true;
+    } else if (!strcmp(arg, "-profile")) {
+      g_profile = true;
+    } else if (!strcmp(arg, "-fuse") && n+1 < argc) {
+      g_fuse = std::stoi(argv[++n]);
+    } else if (!strcmp(arg, "-mux_profile")) {
+      g_mux_profile = true;
     } else if (!strcmp(arg, "-hex")) {
       g_radixChar = "x";
       g_hex = true;
@@ -189,6 +236,40 @@ int main(int argc, char *argv[]) {
     }
   }
 
+  if (g_lib && g_runtime_cmds) {
+    toCout("Error: -lib cannot be combined with -runtime or -lanes!");
+    exit(-1);
+  }
+  if ((g_runtime_cmds || g_lib) && (g_fetch_instr_from_mem || g_design == VTA)) {
+    toCout("Error: -runtime, -lanes and -lib are only supported for accelerator designs!");
+    exit(-1);
+  }
+  if (g_checkpoint && (g_lanes > 0 || g_lib || (!g_runtime_cmds && !g_fetch_instr_from_mem))) {
+    toCout("Error: -checkpoint is only supported with -runtime, or for processor designs!");
+    exit(-1);
+  }
+  if (g_paged_mem && g_design != PROC && g_design != PICO) {
+    toCout("Error: -paged_mem is only supported for -proc and -pico designs!");
+    exit(-1);
+  }
+  if (g_trace && (g_lanes > 0 || g_lib || g_design == VTA)) {
+    toCout("Error: -trace cannot be combined with -lanes or -lib!");
+    exit(-1);
+  }
+  if ((g_profile || g_fuse) && !g_fetch_instr_from_mem) {
+    toCout("Error: -profile and -fuse are only supported for processor designs!");
+    exit(-1);
+  }
+  if (g_profile && g_fuse) {
+    toCout("Error: -profile and -fuse cannot be combined!");
+    exit(-1);
+  }
+  if (g_fuse) read_instr_profile(g_path+"/instr_profile.txt");
+  if (g_runtime_cmds) {
+    write_command_file(toDoList, g_path+"/tb.bin", g_path+"/cmd_layout.txt");
+    if (g_cmds_only) return 0;
+  }
+
   std::ofstream header(g_path+"/ila.h");
   std::ofstream cpp(g_path+"/ila.cpp");
 
@@ -196,7 +277,27 @@ int main(int argc, char *argv[]) {
   cpp << "#include <stdio.h>" << std::endl;
   cpp << "#include <cstdint>" << std::endl;
   cpp << "#include <array>" << std::endl;
+  if (g_runtime_cmds || g_lib || g_checkpoint || g_trace || g_paged_mem) {
+    cpp << "#include <string.h>" << std::endl;
+    cpp << "#include <algorithm>" << std::endl;
+  }
+  if (g_checkpoint || g_trace || g_paged_mem) cpp << "#include <stdlib.h>" << std::endl;
+  if (g_profile) {
+    cpp << "#include <unordered_map>" << std::endl;
+    cpp << "#include <vector>" << std::endl;
+    cpp << "#include <algorithm>" << std::endl;
+  }
+  if (g_mux_profile) {
+    cpp << "#include <vector>" << std::endl;
+    cpp << "#include <stdlib.h>" << std::endl;
+  }
+  if (g_paged_mem) cpp << "#include <elf.h>" << std::endl;
+  if (g_lib) {
+    cpp << "#include \"ila_api.h\"" << std::endl;
+    print_lib_header(g_path+"/ila_api.h");
+  }
   cpp << "#include \"ila.h\"\n" << std::endl;
+  if (g_mux_profile) print_mux_profile_funcs(cpp);
 
   if(g_design == VTA) {
     vta_ila_model(cpp);
@@ -209,7 +310,12 @@ int main(int argc, char *argv[]) {
     // First, see if there is a mem.txt file to use for the memory contents
     std::vector<llvm::APInt> memVals;
     read_mem_vals(g_path+"/mem.txt", memVals);
-    if (!memVals.empty()) {
+    if (g_paged_mem) {
+      // The memory is loaded at runtime, by default from mem.bin
+      if (memVals.empty()) tb_mem_vals(memVals);
+      g_memSize = memVals.size();
+      if (g_memSize > 0) write_mem_image(memVals, g_path+"/mem.bin");
+    } else if (!memVals.empty()) {
 
       g_memSize = memVals.size();
 
@@ -240,13 +346,8 @@ int main(int argc, char *argv[]) {
       cpp << "  // Memory initialized from tb.txt" << std::endl;
       cpp << "  uint32_t mem["+toStr(g_memSize)+"] = {" << std::endl;
       bool first = true;
-      for(auto encoding: toDoList) {
-        if(encoding.find(g_instrValueVar) == encoding.end()) {
-          toCout("Error: the instr value variable is not recognized: "+g_instrValueVar);
-          abort();
-        }
-        llvm::APInt val = convert_to_single_apint(encoding[g_instrValueVar].front());    
-        assert(val.getBitWidth() <= 32);  // We assume 32-bit memory words.
+      tb_mem_vals(memVals);
+      for(const llvm::APInt &val: memVals) {
 
         // Doug: this could be > 64 bits, in which case you will get an initialized std::array 
         std::string valStr = apint2literal(val);
@@ -261,6 +362,18 @@ int main(int argc, char *argv[]) {
       cpp << "};" << std::endl;
     }
 
+    print_icache(cpp);
+    if (g_paged_mem) print_paged_mem(cpp);
+
+    // The data memory is initialized in main()
+    if(g_set_dmem) {
+      if(g_dmem_width != 16 && g_dmem_width != 32) {
+        toCout("Error: unexpected dmem width: "+toStr(g_dmem_width));
+        abort();
+      }
+      cpp << "  "+c_type(g_dmem_width)+" dmem[64];" << std::endl;
+    }
+
     // Special case for AES with fifos.
     if(g_design == AES) print_update_mem(cpp);
     cpp << std::endl;
@@ -270,6 +383,13 @@ int main(int argc, char *argv[]) {
 
   // ==========  asv declarations and initializations
 
+  if (g_lanes > 0) {
+    cpp << "  const uint32_t LANES = "+toStr(g_lanes)+";" << std::endl << std::endl;
+  } else if (g_lib) {
+    cpp << "struct IlaState {" << std::endl;
+    declare_state_var(cpp, "int", "PRINT_ALL");
+  }
+
   if(g_design != VTA) {
     // Register arrays are initialized separately at runtime.
     for(auto pair: g_registerArrays) {
@@ -277,12 +397,30 @@ int main(int argc, char *argv[]) {
       std::string arrName = pair.first;
       uint32_t size = pair.second.getLength();
       std::string dataTy = c_type(pair.second.getWidth());
+      if (has_state_param()) {
+        declare_state_var(cpp, dataTy, arrName, "["+toStr(size)+"]");
+        declare_state_var(cpp, dataTy, arrName+nxt, "["+toStr(size)+"]");
+        continue;
+      }
       cpp << "  "+dataTy+" "+arrName+"["+toStr(size)+"];" << std::endl;
       cpp << "  "+dataTy+" "+arrName+nxt+"["+toStr(size)+"];" << std::endl;
     }
     cpp << std::endl;
   }
 
+  // Lane and library mode: the reset values are assigned by init_lane()
+  // or init_state()
+  std::vector<std::string> stateInits;
+  auto declare_asv = [&](const std::string& asvTy, const std::string& name,
+                         const std::string& init) {
+    if (has_state_param()) {
+      declare_state_var(cpp, asvTy, name);
+      stateInits.push_back("  "+name+" = "+init+";");
+    } else {
+      cpp <<  "  " << asvTy << " " << name << " = " << init << ";" << std::endl;
+    }
+  };
+
   for(auto pair : g_asv) {
     std::string asv = pair.first;
     toCoutVerb(asv);
@@ -303,22 +441,27 @@ int main(int argc, char *argv[]) {
       if (pair.second.cycles.empty()) {
         // One C variable, not cycle-specific
         std::string asvSimp = var_name_convert(asv, true);
-        cpp <<  "  " << asvTy << " " << asvSimp << " = " << cRstVal << ";" << std::endl;
-        cpp <<  "  " << asvTy << " " << asvSimp << nxt << " = " << cRstVal << ";" << std::endl;
+        declare_asv(asvTy, asvSimp, cRstVal);
+        declare_asv(asvTy, asvSimp+nxt, cRstVal);
       } else {
         // Need multiple cycle-specific C variables
         for(int cycle : pair.second.cycles) {
           std::string asvSimp = var_name_cycle_convert(asv, cycle);
-          cpp <<  "  " << asvTy << " " << asvSimp << " = " << cRstVal << ";" << std::endl;
-          cpp <<  "  " << asvTy << " " << asvSimp << nxt << " = " << cRstVal << ";" << std::endl;
+          declare_asv(asvTy, asvSimp, cRstVal);
+          declare_asv(asvTy, asvSimp+nxt, cRstVal);
         }
       }
     }
   }
 
-  cpp << "  unsigned int "+g_dataAddrVar+" = 0;" << std::endl;
-  cpp << "  unsigned int "+g_dataIn+" = 0;" << std::endl;
-  cpp << "  unsigned int data_byte_addr = 0; " << std::endl;  
+  declare_asv("unsigned int", g_dataAddrVar, "0");
+  declare_asv("unsigned int", g_dataIn, "0");
+  declare_asv("unsigned int", "data_byte_addr", "0");
+
+  if (g_lib) {
+    cpp << "};" << std::endl << std::endl;
+    for (const std::string& macro : g_stateMacros) cpp << macro << std::endl;
+  }
 
   if(g_design == URV) {
     // ======== add alias from memory array to registers
@@ -333,11 +476,18 @@ int main(int argc, char *argv[]) {
 
   cpp << std::endl;
 
+  if (g_trace) print_trace_writer(cpp);
   print_asvs_printer_func(cpp);
 
   // Generate the function that initializes register arrays
   // It will be empty if there are no register arrays.
-  cpp << "void init_register_arrays() {" << std::endl;
+  // In lane mode, init_lane() also sets all other ASVs of the lane.
+  if (has_state_param()) {
+    cpp << "void "+std::string(g_lib ? "init_state" : "init_lane")+"("+state_param()+") {" << std::endl;
+    for (const std::string& init : stateInits) cpp << init << std::endl;
+  } else {
+    cpp << "void init_register_arrays() {" << std::endl;
+  }
 
   // Initialize the ASVs in register arrays
   // ASVs in a register array are declared and initialized separately.
@@ -367,6 +517,8 @@ int main(int argc, char *argv[]) {
     cpp << std::endl;
   }
 
+  if (g_checkpoint) print_checkpoint_funcs(cpp);
+
   bool write_main = true;
 
   if (g_separate_main) {
@@ -393,9 +545,24 @@ int main(int argc, char *argv[]) {
     }
   }
 
-  if (write_main) {
+  if (g_lib) {
+    print_lib_api(cpp);
+  } else if (write_main && g_lanes > 0) {
+    print_lanes_main(cpp);
+  } else if (write_main && g_runtime_cmds) {
+    print_runtime_main(cpp);
+  } else if (write_main) {
+
+    if(g_fetch_instr_from_mem) {
+      print_instr_func_table(cpp);
+      print_instr_decoder(cpp);
+      if (g_profile) print_profile_funcs(cpp);
+      if (!g_fusedSeqs.empty()) print_fused_funcs(cpp);
+    }
 
     cpp << "int main(int argc, char *argv[]) {\n" << std::endl;
+    if (g_checkpoint) print_checkpoint_options(cpp);
+    if (g_paged_mem) print_mem_options(cpp);
 
     cpp << std::endl << "  PRINT_ALL = argc > 1 ? 1 : 0;" << std::endl;
 
@@ -409,12 +576,6 @@ int main(int argc, char *argv[]) {
 
     // ========== initialize dmem
     if(g_set_dmem) {
-      if(g_dmem_width != 16 && g_dmem_width != 32) {
-        toCout("Error: unexpected dmem width: "+toStr(g_dmem_width));
-        abort();
-      }
-      std::string type=c_type(g_dmem_width);
-      cpp << "  "+type +" dmem[64];" << std::endl;
       uint32_t i = 0;
       std::ifstream input(g_path+"/dmem.txt");
       std::string line;
@@ -427,7 +588,14 @@ int main(int argc, char *argv[]) {
     cpp << std::endl;
 
     if(g_fetch_instr_from_mem) {
-      if (g_memSize == 0) {
+      if (g_paged_mem) {
+        cpp << "  if (memImage) {" << std::endl;
+        cpp << "    uint32_t entry;" << std::endl;
+        cpp << "    int loaded = mem_load_image(memImage, &entry);" << std::endl;
+        cpp << "    if (loaded < 0) return -1;" << std::endl;
+        cpp << "    if (loaded == 1) "+g_instrAddrVar+" = entry;  // ELF entry point" << std::endl;
+        cpp << "  }" << std::endl << std::endl;
+      } else if (g_memSize == 0) {
         toCout("Error: no memory data could be read");
         abort();
       }
@@ -436,58 +604,74 @@ int main(int argc, char *argv[]) {
       // This number is arbitrary, and can be bigger or smaller than the memory size.
       cpp << "  uint32_t addr ;" << std::endl;
       cpp << std::endl;
-      cpp << "  for(int i = 0; i < "+toStr(instrNum)+"; i++) {" << std::endl;
+      if (g_checkpoint) {
+        cpp << "  uint64_t instrCount = 0;" << std::endl;
+        cpp << "  if (restoreFile && restore_checkpoint(restoreFile, &instrCount) != 0) return -1;" << std::endl;
+        cpp << "  for(uint64_t i = instrCount; i < "+toStr(instrNum)+"; i++) {" << std::endl;
+      } else {
+        cpp << "  for(int i = 0; i < "+toStr(instrNum)+"; i++) {" << std::endl;
+      }
 
       // We assume the memory is byte-addressable, but we store it as an array of 32-bit values.
       // But unaligned reads are not supported.
-      cpp << "    addr = ("+g_instrAddrVar+" >> 2) % "+toStr(g_memSize)+";" << std::endl;
-
-      cpp << "    "+g_instrValueVar+" = mem[addr];" << std::endl;
-
-      // Do a simplified runtime instruction encoding, based in g_instrValueVar and
-      // any per-instruction x-mask values.
-
-      bool first = true;
-      for (const auto instr: g_instrInfo) {
-        auto pos = instr.instrEncoding.find(g_instrValueVar);
-        if (pos == instr.instrEncoding.end()) {
-          // If input has a value that is not specified by the instruction, it is OK.
-          toCout("Warning: instruction "+instr.name+"Cannot be decoded by register "+g_instrValueVar);
-          continue;
-        }
-
-        // Consider only the register value for the first clock cycle.
-        const std::string& instrValueStr = pos->second.front();
-
-        llvm::APInt instrVal = convert_to_single_apint(instrValueStr);
-        llvm::APInt instrMask = convert_to_single_apint(instrValueStr, true/*xmask*/);
-        assert(instrVal.getBitWidth() == instrMask.getBitWidth());
-        assert((instrVal & instrMask) == instrVal);
-
-        // Example generated code:
-        // if ((data_in & 0xfff0f3) == 0x045ab49d) {
-        //    execute_some_instr();
-
-        if (!first) {
-          cpp << "    } else ";
-        } else {
-          cpp << "    ";
-          first = false;
-        }
-        cpp << "if (("+g_instrValueVar+" & "+apint2literal(instrMask)+") == "+
-                  apint2literal(instrVal)+") {" << std::endl;
-
-        // Skip variable assignments, to avoid overwriting the value from mem.
-        print_instr_wrapper_call(instr.instrEncoding, "      ", cpp);
+      if (g_paged_mem)
+        cpp << "    addr = "+g_instrAddrVar+" >> 2;" << std::endl;
+      else
+        cpp << "    addr = ("+g_instrAddrVar+" >> 2) % "+toStr(g_memSize)+";" << std::endl;
+
+      // Only a miss in the decoded-instruction cache reads mem[] and decodes.
+      cpp << "    ICacheEntry_t &entry = icache[addr % ICACHE_SIZE];" << std::endl;
+      cpp << "    if (entry.tag != addr+1) {" << std::endl;
+      cpp << "      entry.tag = addr+1;" << std::endl;
+      cpp << "      entry.value = "+std::string(g_paged_mem ? "mem_load32(addr << 2)" : "mem[addr]")+";" << std::endl;
+      cpp << "      int instrIdx = decode_instr(entry.value);" << std::endl;
+      cpp << "      entry.func = instrIdx < 0 ? nullptr : instrFuncs[instrIdx];" << std::endl;
+      if (g_profile) cpp << "      entry.instrIdx = instrIdx;" << std::endl;
+      if (!g_fusedSeqs.empty()) {
+        // A fused sequence starts here if the following words match it
+        cpp << "      int nextIdx["+toStr(g_fusedMaxLen-1)+"];" << std::endl;
+        cpp << "      for (uint32_t k = 0; k < "+toStr(g_fusedMaxLen-1)+"; k++) {" << std::endl;
+        if (g_paged_mem)
+          cpp << "        entry.next[k] = mem_load32((addr+k+1) << 2);" << std::endl;
+        else
+          cpp << "        entry.next[k] = mem[(addr+k+1) % "+toStr(g_memSize)+"];" << std::endl;
+        cpp << "        nextIdx[k] = decode_instr(entry.next[k]);" << std::endl;
+        cpp << "      }" << std::endl;
+        cpp << "      entry.fused = instrIdx < 0 ? nullptr : match_fused(instrIdx, nextIdx, &entry.fusedLen);" << std::endl;
       }
-      cpp << "    } else {" << std::endl;
-      cpp << "      printf(\"Cannot decode instruction!\\n\");" << std::endl;
-      cpp << "      return -1;" << std::endl;
       cpp << "    }" << std::endl;
 
+      // A fused function returns the number of instructions it executed.
+      // With -checkpoint, it must not run past the next numbered checkpoint.
+      std::string indent = "    ";
+      if (!g_fusedSeqs.empty()) {
+        cpp << "    if (entry.fused && i+entry.fusedLen <= "+toStr(instrNum);
+        if (g_checkpoint) cpp << std::endl << "        && (!saveEvery || saveEvery - i % saveEvery >= entry.fusedLen)";
+        cpp << ") {" << std::endl;
+        cpp << "      i += entry.fused(entry) - 1;" << std::endl;
+        cpp << "    } else {" << std::endl;
+        indent = "      ";
+      }
+      cpp << indent+g_instrValueVar+" = entry.value;" << std::endl;
+      cpp << indent+"if (!entry.func) {" << std::endl;
+      cpp << indent+"  printf(\"Cannot decode instruction!\\n\");" << std::endl;
+      cpp << indent+"  return -1;" << std::endl;
+      cpp << indent+"}" << std::endl;
+      cpp << indent+"entry.func();" << std::endl;
+      if (g_profile) cpp << indent+"profile_instr(entry.instrIdx, addr);" << std::endl;
+      if (!g_fusedSeqs.empty()) cpp << "    }" << std::endl;
+      if (g_checkpoint) {
+        cpp << "    if (saveEvery && (i+1) % saveEvery == 0"
+               " && save_numbered_checkpoint(saveFile, i+1) != 0) return -1;" << std::endl;
+      }
+
       // If the instruction does not update g_instrAddrVar, the same instruction will
       // get executed over and over.
       cpp << "  }" << std::endl;
+      if (g_checkpoint) {
+        cpp << "  if (saveFile && save_checkpoint(saveFile, "+toStr(instrNum)+") != 0) return -1;" << std::endl;
+      }
+      if (g_profile) cpp << "  write_instr_profile(\"instr_profile.txt\");" << std::endl;
 
     } else {
       // Execute instructions and update asvs according to instruction list (if any).
@@ -528,6 +712,8 @@ int main(int argc, char *argv[]) {
 
   for(auto instrInfo : g_instrInfo) {
     for(auto pair : instrInfo.funcTypes) {
+      // A merged update function is declared with the one it was merged into
+      if (!pair.second.alias.empty()) continue;
       std::string writeASV = pair.first;
       std::string funcName = update_function_name(instrInfo.name, writeASV);
 
@@ -536,6 +722,17 @@ int main(int argc, char *argv[]) {
     }
   }
 
+  if (g_paged_mem) {
+    // Byte-addressed little-endian memory access, for data-memory code
+    header << "uint8_t mem_load8(uint32_t addr);" << std::endl;
+    header << "uint16_t mem_load16(uint32_t addr);" << std::endl;
+    header << "uint32_t mem_load32(uint32_t addr);" << std::endl;
+    header << "void mem_store8(uint32_t addr, uint8_t val);" << std::endl;
+    header << "void mem_store16(uint32_t addr, uint16_t val);" << std::endl;
+    header << "void mem_store32(uint32_t addr, uint32_t val);" << std::endl;
+    header << "int mem_load_image(const char *fileName, uint32_t *entry);" << std::endl << std::endl;
+  }
+
   header << "#ifdef __cplusplus" << std::endl
          << "}" << std::endl
          << "#endif" << std::endl;
@@ -543,10 +740,22 @@ int main(int argc, char *argv[]) {
   header  << std::endl;
 
   // Global variable declaration.
-  header << "int PRINT_ALL;" << std::endl;
+  if (g_lib) header << "struct IlaState;" << std::endl;
+  else header << "int PRINT_ALL;" << std::endl;
 
-  header << "void init_register_arrays();" << std::endl;
-  header << "void print_asvs(const char *bannerLine, bool always);" << std::endl;
+  if (g_lanes > 0) header << "void init_lane(uint32_t lane);" << std::endl;
+  else if (g_lib) header << "void init_state(IlaState *ila);" << std::endl;
+  else header << "void init_register_arrays();" << std::endl;
+  if (g_fetch_instr_from_mem) {
+    // For a user main() that writes to the instruction memory
+    header << "void icache_invalidate(uint32_t addr);" << std::endl;
+    header << "void icache_invalidate_all();" << std::endl;
+  }
+  header << "void print_asvs(const char *bannerLine, bool always"+state_param(true)+");" << std::endl;
+  if (g_checkpoint) {
+    header << "int save_checkpoint(const char *fileName, uint64_t instrCount);" << std::endl;
+    header << "int restore_checkpoint(const char *fileName, uint64_t *instrCount);" << std::endl;
+  }
 
   for(auto instrInfo : g_instrInfo) {
     header << std::endl;
@@ -583,7 +792,7 @@ void print_instr_wrapper_func(const InstrInfo_t& instr,
   cpp << "// instr"+toStr(idx)+": "+instr.name << std::endl;
 
   std::string wrapperFuncName = instruction_function_name(instr.name);
-  cpp << "void "+wrapperFuncName+"() {" << std::endl;
+  cpp << "void "+wrapperFuncName+"("+state_param()+") {" << std::endl;
   print_instr_calls(instr.instrEncoding, "  ", cpp);
   cpp << "}" << std::endl;
 }
@@ -594,7 +803,7 @@ void print_instr_wrapper_decl(const std::string &instrName,
                               std::ofstream &stream) {
 
   std::string wrapperFuncName = instruction_function_name(instrName);
-  stream << "void "+wrapperFuncName+"();" << std::endl;
+  stream << "void "+wrapperFuncName+"("+state_param()+");" << std::endl;
 }
 
 // Call the single function that does all the work for a particular instruction.
@@ -620,8 +829,12 @@ void print_instr_calls(const InstEncoding_t& encoding,
   uint32_t idx = get_instr_by_name(instrName);
   struct InstrInfo_t& instrInfo = g_instrInfo[idx];    
 
-  cpp << indent+"if (PRINT_ALL) printf( \"// instr"+toStr(idx)+": "
-               +instrInfo.name+"\\n\");" << std::endl << std::endl;
+  if (g_trace) {
+    cpp << indent+"if (PRINT_ALL) traceInstr = "+toStr(idx)+";  // "+instrInfo.name << std::endl << std::endl;
+  } else {
+    cpp << indent+"if (PRINT_ALL) printf( \"// instr"+toStr(idx)+": "
+                 +instrInfo.name+"\\n\");" << std::endl << std::endl;
+  }
 
   if(instrInfo.funcTypes.empty()) {
     toCout("Error: no func_info found for instruction: "+instrInfo.name);
@@ -681,7 +894,8 @@ void print_instr_calls(const InstEncoding_t& encoding,
 
     FuncCall_t funcCall;
     std::string writeASV = var_name_convert(origWriteASV, true);
-    funcCall.funcName = update_function_name(instrInfo.name, writeASV);
+    funcCall.funcName = funcType.alias.empty() ? update_function_name(instrInfo.name, writeASV)
+                                               : funcType.alias;
     funcCall.funcTy = funcType;  // A lot of deep copying...
     funcCall.origASV = origWriteASV;
 
@@ -698,6 +912,51 @@ void print_instr_calls(const InstEncoding_t& encoding,
     funcCalls.push_back(funcCall);
   }
 
+  // An update function of a register array loads all the values it needs
+  // before it stores every element of the array it is given.  So it can
+  // write the array itself instead of arr_nxt, and the array does not have
+  // to be copied, as long as no update function called after it reads
+  // the array.  The array functions are called last, each after all its
+  // readers.  Arrays whose functions read each other are still copied.
+  std::set<std::string> inPlaceArrays;
+  // (The special calls of AES and URV always write arr_nxt.)
+  if (g_arrays_in_place && g_design != AES && g_design != URV) {
+    auto reads_array = [](const FuncCall_t& funcCall, const std::string& arrName) {
+      for (const Arg_t& arg : funcCall.funcTy.argTy) {
+        if (arg.name == arrName || get_array_position(arg.name, nullptr) == arrName)
+          return true;
+      }
+      return false;
+    };
+
+    std::vector<FuncCall_t> orderedCalls, arrayCalls;
+    for (FuncCall_t& funcCall : funcCalls) {
+      bool storesArray = false;
+      for (const Arg_t& arg : funcCall.funcTy.argTy)
+        storesArray |= (arg.name == RETURN_ARRAY_PTR_ID);
+      if (storesArray && funcCall.varNames.size() == 1 && is_array_var(funcCall.varNames[0]))
+        arrayCalls.push_back(funcCall);
+      else
+        orderedCalls.push_back(funcCall);
+    }
+    while (!arrayCalls.empty()) {
+      size_t pick = 0;
+      bool inPlace = false;
+      for (size_t i = 0; i < arrayCalls.size() && !inPlace; i++) {
+        inPlace = true;
+        for (size_t j = 0; j < arrayCalls.size(); j++) {
+          if (j != i && reads_array(arrayCalls[j], arrayCalls[i].varNames[0]))
+            inPlace = false;
+        }
+        if (inPlace) pick = i;
+      }
+      if (inPlace) inPlaceArrays.insert(arrayCalls[pick].varNames[0]);
+      orderedCalls.push_back(arrayCalls[pick]);
+      arrayCalls.erase(arrayCalls.begin()+pick);
+    }
+    funcCalls.swap(orderedCalls);
+  }
+
 
   // Generate all the calls to the update functions
   for (FuncCall_t& funcCall : funcCalls) {
@@ -705,19 +964,20 @@ void print_instr_calls(const InstEncoding_t& encoding,
       // TODO: If multiple vars need to be updated, use one function call and multiple assignments:
       // x = y = x = func(..);
 
-      std::string funcCallStr = func_call(indent, varName+nxt, funcCall.funcTy, funcCall.funcName, 
-                           encoding, instrInfo.loadDataInfo[funcCall.origASV]);
+      std::string writeVar = inPlaceArrays.count(varName) ? varName : varName+nxt;
+      std::string funcCallStr = func_call(indent, writeVar, funcCall.funcTy, funcCall.funcName, 
+                           instrInfo, instrInfo.loadDataInfo[funcCall.origASV]);
       cpp << funcCallStr << std::endl;
 
       // ==== update instrAddr or dataAddr
       if(!instrAddr.empty() && varName == instrAddr) {
         std::string funcCallStr = func_call(indent, g_instrAddrVar, funcCall.funcTy, funcCall.funcName, 
-                             encoding, std::pair<std::string, uint32_t>{});
+                             instrInfo, std::pair<std::string, uint32_t>{});
         cpp << funcCallStr << std::endl;
       }
       else if(instrInfo.funcTgtMap.count(varName)) {
         std::string funcCallStr = func_call(indent, g_dataAddrVar, funcCall.funcTy, funcCall.funcName, 
-                             encoding, instrInfo.loadDataInfo[funcCall.origASV]);
+                             instrInfo, instrInfo.loadDataInfo[funcCall.origASV]);
         cpp << funcCallStr << std::endl;
       }
     }
@@ -732,7 +992,7 @@ void print_instr_calls(const InstEncoding_t& encoding,
   for (FuncCall_t& funcCall : funcCalls) {
     for (std::string& varName : funcCall.varNames) {
       if (is_array_var(varName)) {
-        if(!g_update_all_regs) {  
+        if(!g_update_all_regs && !inPlaceArrays.count(varName)) {  
 
           auto itr = g_registerArrays.find(varName);
           assert(itr != g_registerArrays.end());
@@ -755,8 +1015,13 @@ void print_instr_calls(const InstEncoding_t& encoding,
         cpp << indent+g_instrAddrVar+" = "+varName+nxt+";" << std::endl;
         cpp << std::endl;
       } else if(instrInfo.funcTgtMap.count(varName)) {
-        cpp << indent+"data_byte_addr = ("+g_dataAddrVar+" >> 2) % "+toStr(g_memSize)+";" << std::endl;
-        cpp << indent+g_dataIn+" = mem[data_byte_addr] ;" << std::endl;
+        if (g_paged_mem) {
+          cpp << indent+"data_byte_addr = "+g_dataAddrVar+" >> 2;" << std::endl;
+          cpp << indent+g_dataIn+" = mem_load32(data_byte_addr << 2);" << std::endl;
+        } else {
+          cpp << indent+"data_byte_addr = ("+g_dataAddrVar+" >> 2) % "+toStr(g_memSize)+";" << std::endl;
+          cpp << indent+g_dataIn+" = mem[data_byte_addr] ;" << std::endl;
+        }
       }
     }
   }
@@ -799,7 +1064,10 @@ std::string c_type(uint32_t width) {
     case 33 ... 64:
       ret = "uint64_t";
       break;
-    case 65 ... 8388607:  // Maximum width supported by LLVM.
+    case 65 ... 128:
+      ret = "unsigned __int128";
+      break;
+    case 129 ... 8388607:  // Maximum width supported by LLVM.
       {
 	int words = (width+63)/64;
 	ret = "std::array<uint64_t,"+toStr(words)+">";
@@ -834,6 +1102,20 @@ std::string c_type(uint32_t width) {
 void print_var_assignments(std::ofstream &cpp, std::string indent, 
                       const InstEncoding_t &inputInstr) {
 
+  std::vector<std::pair<std::string, llvm::APInt>> assigns;
+  collect_var_assignments(inputInstr, assigns);
+  for(auto &assign : assigns) {
+    // Doug: this could be > 64 bits.  Such big parameters are passed by const reference.
+    cpp << indent << assign.first << " = " << apint2literal(assign.second) << ";" << std::endl;
+  }
+}
+
+
+// The C variable name and the value of every assignment that
+// print_var_assignments() would generate for the instruction.
+void collect_var_assignments(const InstEncoding_t &inputInstr,
+                             std::vector<std::pair<std::string, llvm::APInt>> &assigns) {
+
   std::string instrName = decode(inputInstr);
   uint32_t idx = get_instr_by_name(instrName);
   struct InstrInfo_t& instrInfo = g_instrInfo[idx];    
@@ -845,12 +1127,14 @@ void print_var_assignments(std::ofstream &cpp, std::string indent,
     for(auto arg: funcTy.argTy) {
       // Consider each arg of each update function.
       // Skip the special args, e.g. those for returning wide values.
-      std::string argname = arg.name;
-      if (is_special_arg_name(argname)) {
+      if (is_special_arg_name(arg.name)) {
         continue;
       }
 
-      int cycle = arg.cycle;  // A cycle of zero means non-cycle-specific.
+      // A symbolic field arg is taken from the var it is a part of
+      Arg_t var = arg_var(instrInfo, arg);
+      std::string argname = var.name;
+      int cycle = var.cycle;  // A cycle of zero means non-cycle-specific.
 
       auto pos = inputInstr.find(argname);
       if(pos != inputInstr.end()) {
@@ -881,10 +1165,7 @@ void print_var_assignments(std::ofstream &cpp, std::string indent,
           processedVars.insert(varname);
 
           // argValue could look like this: "7'h4+5'h7+5'h13+3'h2+5'h12+5'h8+2'b11"
-          llvm::APInt apValue = convert_to_single_apint(argValue);
-          // Doug: this could be > 64 bits.  Such big parameters are passed by const reference.
-          argValue = apint2literal(apValue);
-          cpp << indent << varname << " = " << argValue << ";" << std::endl;
+          assigns.push_back(std::make_pair(varname, convert_to_single_apint(argValue)));
         }
 
       }
@@ -896,9 +1177,11 @@ void print_var_assignments(std::ofstream &cpp, std::string indent,
 // currently only support one-cycle encoding
 std::string func_call(std::string indent, std::string writeVar,
                       const FuncTy_t& funcTy, std::string funcName, 
-                      const InstEncoding_t& encoding,
+                      const InstrInfo_t& instrInfo,
                       std::pair<std::string, uint32_t> dataIn) {
 
+  const InstEncoding_t& encoding = instrInfo.instrEncoding;
+
   const char *special_comment = " /*special call*/";
   // TODO: check if need to use special funcCall
   if(g_design == AES 
@@ -923,7 +1206,7 @@ std::string func_call(std::string indent, std::string writeVar,
   if (writeVar.empty() || funcTy.retTy == 0) {
     ret += funcName+"( ";  // No writeVar, or function returns void (probably for an array)
     argIndent = ret.length();  // For indenting subsequent args
-  } else if (funcTy.retTy <= 64) {
+  } else if (funcTy.retTy <= 128) {
     ret += writeVar+" =\n  "+indent+funcName+"( ";
     argIndent = indent.length() + funcName.length() + 4;
   } else {
@@ -962,6 +1245,13 @@ std::string func_call(std::string indent, std::string writeVar,
       // We need to provide the address of the result storage of the result's register array.
       argValue = writeVar;
     }
+    else if (const InstrField_t *field = find_field_arg(instrInfo, argname)) {
+      // A symbolic field of an instruction family is decoded from its input signal
+      uint32_t width = field->hi - field->lo + 1;
+      argValue = "("+c_type(width)+")(("+var_name_cycle_convert(field->signal, field->cycle)
+                 +" >> "+toStr(field->lo)+") & "
+                 +apint2literal(llvm::APInt::getLowBitsSet(64, width))+")";
+    }
     else {
       assert(cycle >= 0);
       argValue = get_arg_value(argname, cycle, encoding);
@@ -1133,6 +1423,8 @@ std::string toLiteral<bool>(bool a) {
 
 
 // For values <= 64 bits, this returns something like "1234".
+// For values <= 128 bits, it returns an unsigned __int128 expression, like
+// "(((unsigned __int128)12238671837 << 64) | 23428734823)"
 // For larger values, it returns an initializer string for a std::array<uint64_t>, like
 // "{12238671837, 23428734823, 23423490782390}"
 // I think it would better for all literals to be hex instead of decimal...
@@ -1144,6 +1436,10 @@ std::string apint2initializer(const llvm::APInt& val) {
   }
 
   const uint64_t *p = val.getRawData();
+  if (nw == 2) {
+    return "(((unsigned __int128)"+toLiteral(p[1])+" << 64) | "+toLiteral(p[0])+")";
+  }
+
   std::string ret = "{";
   for(unsigned j=0; j < nw; ++j) {
     ret += toLiteral(*p++);
@@ -1159,11 +1455,12 @@ std::string apint2initializer(const llvm::APInt& val) {
 
 // This returns a literal value that can be used as a function parameter.
 // For values <= 64 bits, this returns something like "1234".
+// For values <= 128 bits, the same as apint2initializer().
 // For larger values, it returns the address of a std::array temporary, like
 // "std::array<uint64_t>{12238671837, 23428734823, 23423490782390}"
 std::string apint2literal(const llvm::APInt& val) {
   std::string s = apint2initializer(val);
-  if (val.getBitWidth() > 64) {
+  if (val.getBitWidth() > 128) {
     s = "std::array<uint64_t,"+toLiteral(val.getNumWords())+">" + s;
   }
   return s;
@@ -1294,6 +1591,10 @@ std::string build_printf(const std::string& prefix, const std::string& varName,
     s = "printf(\""+prefix+"%"+g_radixChar+"\\n\", "+index+varName+");";
   } else if (width <= 64) {
     s = "printf(\""+prefix+"%l"+g_radixChar+"\\n\", "+index+varName+");";
+  } else if (width <= 128) {
+    // printf has no conversion for unsigned __int128, so print the two halves
+    s = "printf(\""+prefix+"{%l"+g_radixChar+", %l"+g_radixChar+"}\\n\", "+index
+        +"(uint64_t)("+varName+" >> 64), (uint64_t)"+varName+");";
   } else {
     s = "printf(\""+prefix+"{";
     int words = (width+63)/64;
@@ -1340,9 +1641,9 @@ void print_var_value(std::string indent, std::ofstream &cpp, const std::string&
 void print_asvs(std::ofstream &cpp, const std::string& bannerLine, bool always) {
 
   if (bannerLine.empty()) {
-    cpp << "  print_asvs(nullptr, "+toStr(always)+");";
+    cpp << "  print_asvs(nullptr, "+toStr(always)+state_arg(true)+");";
   } else {
-    cpp << "  print_asvs(\""+bannerLine+"\", "+toStr(always)+");";
+    cpp << "  print_asvs(\""+bannerLine+"\", "+toStr(always)+state_arg(true)+");";
   }
   cpp << std::endl;
 }
@@ -1351,8 +1652,15 @@ void print_asvs(std::ofstream &cpp, const std::string& bannerLine, bool always)
 // Generate the body of the function to print ASV values.
 void print_asvs_printer_func(std::ofstream &cpp) {
 
-  cpp << "void print_asvs(const char *bannerLine, bool always) {" << std::endl;
+  cpp << "void print_asvs(const char *bannerLine, bool always"+state_param(true)+") {" << std::endl;
 
+  // Only the final results are printed as text
+  if (g_trace) {
+    cpp << "  if (PRINT_ALL && !always) {" << std::endl;
+    cpp << "    trace_asvs();" << std::endl;
+    cpp << "    return;" << std::endl;
+    cpp << "  }" << std::endl;
+  }
 
   cpp << "  if (always || PRINT_ALL) {" << std::endl;
 
@@ -1465,6 +1773,7 @@ void print_update_mem(std::ofstream &cpp) {
   cpp << "void update_mem() {"                                               << std::endl;
   cpp << "  for(int i = 0; i < 16; i++) {"                                   << std::endl;
   cpp << "    mem[ _write_addr_fifo_out0_Arr[i] ] = data_fifo_out0_Arr[i];"  << std::endl;
+  cpp << "    icache_invalidate(_write_addr_fifo_out0_Arr[i]);"             << std::endl;
   cpp << "  }"                                                               << std::endl;
   cpp << "}\n"                                                               << std::endl;
 }
@@ -1615,6 +1924,1345 @@ void vta_ila_model(std::ofstream &cpp) {
 
 
 
+// Declare the decoded-instruction cache of the fetch loop: for the word
+// address of an instruction, the value read from mem[] and its
+// instruction function.  It is direct-mapped, with one entry per memory
+// word up to a limit, so a loop only reads and decodes its instructions
+// once.  Any code that writes to mem[] must invalidate the written word.
+void print_icache(std::ofstream &cpp) {
+  // A paged memory can be loaded with any program at runtime
+  uint32_t memSize = g_paged_mem ? g_icacheMaxSize : g_memSize;
+  uint32_t size = 1;
+  while (size < memSize && size < g_icacheMaxSize) size *= 2;
+
+  cpp << "  const uint32_t ICACHE_SIZE = "+toStr(size)+";" << std::endl;
+  cpp << "  struct ICacheEntry_t {" << std::endl;
+  cpp << "    uint32_t tag;  // Word address + 1, 0 if empty" << std::endl;
+  cpp << "    uint32_t value;" << std::endl;
+  cpp << "    void (*func)();" << std::endl;
+  if (g_profile) cpp << "    int instrIdx;" << std::endl;
+  if (!g_fusedSeqs.empty()) {
+    cpp << "    int (*fused)(const ICacheEntry_t &entry);  // Fused sequence starting here, or nullptr" << std::endl;
+    cpp << "    uint32_t fusedLen;" << std::endl;
+    cpp << "    uint32_t next["+toStr(g_fusedMaxLen-1)+"];  // The following words" << std::endl;
+  }
+  cpp << "  };" << std::endl;
+  cpp << "  ICacheEntry_t icache[ICACHE_SIZE];" << std::endl;
+  cpp << std::endl;
+  cpp << "void icache_invalidate(uint32_t addr) {" << std::endl;
+  if (!g_fusedSeqs.empty()) {
+    // The entries of a fused sequence also hold the words after them
+    cpp << "  for (uint32_t i = 0; i < "+toStr(g_fusedMaxLen)+"; i++) {" << std::endl;
+    cpp << "    ICacheEntry_t &entry = icache[(addr-i) % ICACHE_SIZE];" << std::endl;
+    cpp << "    if (entry.tag == addr-i+1) entry.tag = 0;" << std::endl;
+    cpp << "  }" << std::endl;
+  } else {
+    cpp << "  ICacheEntry_t &entry = icache[addr % ICACHE_SIZE];" << std::endl;
+    cpp << "  if (entry.tag == addr+1) entry.tag = 0;" << std::endl;
+  }
+  cpp << "}" << std::endl;
+  cpp << std::endl;
+  cpp << "void icache_invalidate_all() {" << std::endl;
+  cpp << "  for (uint32_t i = 0; i < ICACHE_SIZE; i++) icache[i].tag = 0;" << std::endl;
+  cpp << "}" << std::endl;
+}
+
+
+// The instruction functions, indexed by the position in instr.txt
+void print_instr_func_table(std::ofstream &cpp) {
+  cpp << "typedef void (*InstrFunc_t)("+state_param()+");" << std::endl;
+  cpp << "static const InstrFunc_t instrFuncs["+toStr(g_instrInfo.size())+"] = {" << std::endl;
+  for(auto &instrInfo : g_instrInfo)
+    cpp << "  "+instruction_function_name(instrInfo.name)+"," << std::endl;
+  cpp << "};" << std::endl << std::endl;
+}
+
+
+// Generate "int decode_instr(uint64_t instrValue)", which returns the
+// index of the instruction encoded by a value of g_instrValueVar, or -1.
+// The masks and values of all instructions are compiled into a tree of
+// switches on the bit fields that tell them apart, so only a few
+// instructions are compared at the leaves.
+void print_instr_decoder(std::ofstream &cpp) {
+  std::vector<DecodePattern_t> patterns;
+  for (uint32_t i = 0; i < g_instrInfo.size(); i++) {
+    const InstrInfo_t& instr = g_instrInfo[i];
+    auto pos = instr.instrEncoding.find(g_instrValueVar);
+    if (pos == instr.instrEncoding.end()) {
+      // If input has a value that is not specified by the instruction, it is OK.
+      toCout("Warning: instruction "+instr.name+"Cannot be decoded by register "+g_instrValueVar);
+      continue;
+    }
+
+    // Consider only the register value for the first clock cycle.
+    const std::string& instrValueStr = pos->second.front();
+
+    llvm::APInt instrVal = convert_to_single_apint(instrValueStr);
+    llvm::APInt instrMask = convert_to_single_apint(instrValueStr, true/*xmask*/);
+    assert(instrVal.getBitWidth() == instrMask.getBitWidth());
+    assert((instrVal & instrMask) == instrVal);
+    patterns.push_back({instrVal, instrMask, i});
+  }
+
+  DecodeTree tree;
+  tree.build(patterns);
+  if (tree.width() > 64) {
+    toCout("Error: "+g_instrValueVar+" is wider than 64 bits, cannot generate the decoder!");
+    abort();
+  }
+
+  cpp << "static int decode_instr(uint64_t instrValue) {" << std::endl;
+  tree.print_c(cpp, "instrValue", "  ");
+  cpp << "  return -1;" << std::endl;
+  cpp << "}" << std::endl << std::endl;
+}
+
+
+// ==========  Runtime command stream (-runtime)
+//
+// Instead of unrolling tb.txt into main(), the generated main() reads a
+// binary command file and dispatches each command to the instruction's
+// wrapper function, so one simulation executable can run any number of
+// test programs.  The format is (all numbers little-endian):
+//
+//   "ILAC" <u32 version>
+//   per command:    <u32 instr index> <u32 assignment count>
+//   per assignment: <u32 var id> <u32 word count> <u64 words, LSW first>
+//
+// The instr index is the position in instr.txt, the var ids are listed in
+// cmd_layout.txt.  sim_gen writes tb.bin from tb.txt in this format.
+
+const uint32_t g_cmdVersion = 1;
+
+// C name -> width of the C variable of every ASV not in a register array
+void collect_scalar_asvs(std::map<std::string, uint32_t> &varWidths) {
+  for(auto pair : g_asv) {
+    if (is_in_array(pair.first)) continue;
+    if (pair.second.cycles.empty()) {
+      varWidths.emplace(var_name_convert(pair.first, true), pair.second.width);
+    } else {
+      for(int cycle : pair.second.cycles)
+        varWidths.emplace(var_name_cycle_convert(pair.first, cycle), pair.second.width);
+    }
+  }
+}
+
+
+// C name -> width of every variable that a command may assign: the
+// non-array ASVs that are args of some update function.
+// The var id is the position in the map.
+void collect_runtime_vars(std::map<std::string, uint32_t> &varWidths) {
+  std::map<std::string, uint32_t> declared;
+  collect_scalar_asvs(declared);
+
+  for(auto &instrInfo : g_instrInfo) {
+    for(auto &pair : instrInfo.funcTypes) {
+      for(auto &funcArg : pair.second.argTy) {
+        if (is_special_arg_name(funcArg.name)) continue;
+        Arg_t arg = arg_var(instrInfo, funcArg);
+        std::string varname = arg.cycle <= 0 ? var_name_convert(arg.name, true)
+                                             : var_name_cycle_convert(arg.name, arg.cycle);
+        auto pos = declared.find(varname);
+        if (pos != declared.end()) varWidths.insert(*pos);
+      }
+    }
+  }
+}
+
+
+static uint32_t word_num(uint32_t width) {
+  return (width+63)/64;
+}
+
+
+// Generate set_var(), open_command_file() and read_command(), which
+// read the command files of -runtime and -lanes.
+void print_command_reader(std::ofstream &cpp) {
+  std::map<std::string, uint32_t> varWidths;
+  collect_runtime_vars(varWidths);
+
+  uint32_t maxWords = 1;
+  cpp << "static void set_var(uint32_t varId, const uint64_t *words"+state_param(true)+") {" << std::endl;
+  cpp << "  switch(varId) {" << std::endl;
+  uint32_t varId = 0;
+  for(auto &pair : varWidths) {
+    uint32_t words = word_num(pair.second);
+    maxWords = std::max(maxWords, words);
+    cpp << "    case "+toStr(varId++)+": ";
+    if (words == 1) cpp << pair.first+" = words[0]; break;" << std::endl;
+    else if (words == 2) cpp << pair.first+" = ((unsigned __int128)words[1] << 64) | words[0]; break;" << std::endl;
+    else cpp << "std::copy(words, words+"+toStr(words)+", "+pair.first+".begin()); break;" << std::endl;
+  }
+  cpp << "  }" << std::endl;
+  cpp << "}" << std::endl << std::endl;
+
+  cpp << "static FILE *open_command_file(const char *cmdFileName) {" << std::endl;
+  cpp << "  FILE *cmdFile = fopen(cmdFileName, \"rb\");" << std::endl;
+  cpp << "  if (!cmdFile) {" << std::endl;
+  cpp << "    printf(\"Cannot open command file %s\\n\", cmdFileName);" << std::endl;
+  cpp << "    return nullptr;" << std::endl;
+  cpp << "  }" << std::endl;
+  cpp << "  char magic[4];" << std::endl;
+  cpp << "  uint32_t version;" << std::endl;
+  cpp << "  if (fread(magic, 1, 4, cmdFile) != 4 || memcmp(magic, \"ILAC\", 4) != 0" << std::endl;
+  cpp << "      || fread(&version, sizeof(version), 1, cmdFile) != 1 || version != "+toStr(g_cmdVersion)+") {" << std::endl;
+  cpp << "    printf(\"%s is not a command file of this simulator\\n\", cmdFileName);" << std::endl;
+  cpp << "    fclose(cmdFile);" << std::endl;
+  cpp << "    return nullptr;" << std::endl;
+  cpp << "  }" << std::endl;
+  cpp << "  return cmdFile;" << std::endl;
+  cpp << "}" << std::endl << std::endl;
+
+  cpp << "// Read the next command and set its variables.  Returns the instr" << std::endl;
+  cpp << "// index, -1 at the end of the file, or -2 for a broken file." << std::endl;
+  cpp << "static int read_command(FILE *cmdFile"+state_param(true)+") {" << std::endl;
+  cpp << "  uint32_t cmd[2];  // instr index, assignment count" << std::endl;
+  cpp << "  uint32_t assign[2];  // var id, word count" << std::endl;
+  cpp << "  uint64_t words["+toStr(maxWords)+"];" << std::endl;
+  cpp << "  if (fread(cmd, sizeof(uint32_t), 2, cmdFile) != 2) return -1;" << std::endl;
+  cpp << "  for (uint32_t i = 0; i < cmd[1]; i++) {" << std::endl;
+  cpp << "    if (fread(assign, sizeof(uint32_t), 2, cmdFile) != 2 || assign[1] > "+toStr(maxWords) << std::endl;
+  cpp << "        || fread(words, sizeof(uint64_t), assign[1], cmdFile) != assign[1]) {" << std::endl;
+  cpp << "      printf(\"Broken command file!\\n\");" << std::endl;
+  cpp << "      return -2;" << std::endl;
+  cpp << "    }" << std::endl;
+  cpp << "    set_var(assign[0], words"+state_arg(true)+");" << std::endl;
+  cpp << "  }" << std::endl;
+  cpp << "  if (cmd[0] >= "+toStr(g_instrInfo.size())+") {" << std::endl;
+  cpp << "    printf(\"Cannot decode instruction!\\n\");" << std::endl;
+  cpp << "    return -2;" << std::endl;
+  cpp << "  }" << std::endl;
+  cpp << "  return cmd[0];" << std::endl;
+  cpp << "}" << std::endl << std::endl;
+
+  if (!g_checkpoint) return;
+  cpp << "// Read past the next command without setting its variables" << std::endl;
+  cpp << "static bool skip_command(FILE *cmdFile) {" << std::endl;
+  cpp << "  uint32_t cmd[2];  // instr index, assignment count" << std::endl;
+  cpp << "  uint32_t assign[2];  // var id, word count" << std::endl;
+  cpp << "  if (fread(cmd, sizeof(uint32_t), 2, cmdFile) != 2) return false;" << std::endl;
+  cpp << "  for (uint32_t i = 0; i < cmd[1]; i++) {" << std::endl;
+  cpp << "    if (fread(assign, sizeof(uint32_t), 2, cmdFile) != 2" << std::endl;
+  cpp << "        || fseek(cmdFile, assign[1]*sizeof(uint64_t), SEEK_CUR) != 0) return false;" << std::endl;
+  cpp << "  }" << std::endl;
+  cpp << "  return true;" << std::endl;
+  cpp << "}" << std::endl << std::endl;
+}
+
+
+// Generate a main() that executes a command file.
+void print_runtime_main(std::ofstream &cpp) {
+  print_command_reader(cpp);
+  print_instr_func_table(cpp);
+
+  cpp << "// usage: <exe> [<command file, default tb.bin>] [<print all>]" << std::endl;
+  if (g_checkpoint)
+    cpp << "//        [-save <file>] [-every <n>] [-restore <file>]" << std::endl;
+  cpp << "int main(int argc, char *argv[]) {\n" << std::endl;
+  if (g_checkpoint) print_checkpoint_options(cpp);
+  cpp << "  const char *cmdFileName = argc > 1 ? argv[1] : \"tb.bin\";" << std::endl;
+  cpp << "  PRINT_ALL = argc > 2 ? 1 : 0;" << std::endl;
+  cpp << "  init_register_arrays();" << std::endl;
+  print_asvs(cpp, "Initialization:");
+  cpp << std::endl;
+
+  cpp << "  FILE *cmdFile = open_command_file(cmdFileName);" << std::endl;
+  cpp << "  if (!cmdFile) return -1;" << std::endl;
+  if (g_checkpoint) {
+    // The commands before the checkpoint were already executed
+    cpp << "  uint64_t instrCount = 0;" << std::endl;
+    cpp << "  if (restoreFile) {" << std::endl;
+    cpp << "    if (restore_checkpoint(restoreFile, &instrCount) != 0) return -1;" << std::endl;
+    cpp << "    for (uint64_t i = 0; i < instrCount; i++) {" << std::endl;
+    cpp << "      if (!skip_command(cmdFile)) {" << std::endl;
+    cpp << "        printf(\"%s has fewer commands than the checkpoint\\n\", cmdFileName);" << std::endl;
+    cpp << "        return -1;" << std::endl;
+    cpp << "      }" << std::endl;
+    cpp << "    }" << std::endl;
+    cpp << "  }" << std::endl;
+  }
+  cpp << "  int instrIdx;" << std::endl;
+  cpp << "  while ((instrIdx = read_command(cmdFile)) >= 0) {" << std::endl;
+  cpp << "    instrFuncs[instrIdx]();" << std::endl;
+  if (g_checkpoint) {
+    cpp << "    instrCount++;" << std::endl;
+    cpp << "    if (saveEvery && instrCount % saveEvery == 0"
+           " && save_numbered_checkpoint(saveFile, instrCount) != 0) return -1;" << std::endl;
+  }
+  cpp << "  }" << std::endl;
+  cpp << "  fclose(cmdFile);" << std::endl;
+  cpp << "  if (instrIdx < -1) return -1;" << std::endl;
+  if (g_checkpoint)
+    cpp << "  if (saveFile && save_checkpoint(saveFile, instrCount) != 0) return -1;" << std::endl;
+  cpp << std::endl;
+
+  print_asvs(cpp, "The final results:", true /*always*/);
+  cpp << std::endl << "  return 0;" << std::endl;
+  cpp << "}" << std::endl;
+}
+
+
+// Generate a main() that runs many command files side by side, one per
+// lane.  Every ASV is an array over the lanes (see declare_state_var()).
+// In each step, every lane reads its next command, the lanes are grouped
+// by instruction, and each instruction is executed for its group of lanes
+// in one loop, which walks the ASV arrays in order.
+void print_lanes_main(std::ofstream &cpp) {
+  print_command_reader(cpp);
+
+  uint32_t instrNum = g_instrInfo.size();
+  for(auto &instrInfo : g_instrInfo) {
+    std::string funcName = instruction_function_name(instrInfo.name);
+    cpp << "static void "+funcName+"_lanes(const uint32_t *lanes, uint32_t laneNum) {" << std::endl;
+    cpp << "  for (uint32_t i = 0; i < laneNum; i++) "+funcName+"(lanes[i]);" << std::endl;
+    cpp << "}" << std::endl << std::endl;
+  }
+  cpp << "typedef void (*LanesFunc_t)(const uint32_t *lanes, uint32_t laneNum);" << std::endl;
+  cpp << "static const LanesFunc_t lanesFuncs["+toStr(instrNum)+"] = {" << std::endl;
+  for(auto &instrInfo : g_instrInfo)
+    cpp << "  "+instruction_function_name(instrInfo.name)+"_lanes," << std::endl;
+  cpp << "};" << std::endl << std::endl;
+
+  cpp << "// usage: <exe> [-print] [<command file>...], default tb.bin" << std::endl;
+  cpp << "// The files are run "+toStr(g_lanes)+" at a time." << std::endl;
+  cpp << "int main(int argc, char *argv[]) {\n" << std::endl;
+  cpp << "  int firstArg = 1;" << std::endl;
+  cpp << "  PRINT_ALL = 0;" << std::endl;
+  cpp << "  if (argc > 1 && strcmp(argv[1], \"-print\") == 0) {" << std::endl;
+  cpp << "    PRINT_ALL = 1;" << std::endl;
+  cpp << "    firstArg = 2;" << std::endl;
+  cpp << "  }" << std::endl;
+  cpp << "  const char *defaultFile = \"tb.bin\";" << std::endl;
+  cpp << "  const char **fileNames = argc > firstArg ? (const char **)argv+firstArg : &defaultFile;" << std::endl;
+  cpp << "  uint32_t fileNum = argc > firstArg ? argc-firstArg : 1;" << std::endl;
+  cpp << std::endl;
+  cpp << "  static FILE *cmdFiles[LANES];" << std::endl;
+  cpp << "  static uint32_t instrLanes["+toStr(instrNum)+"][LANES];" << std::endl;
+  cpp << "  uint32_t instrLaneNum["+toStr(instrNum)+"];" << std::endl;
+  cpp << "  for (uint32_t first = 0; first < fileNum; first += LANES) {" << std::endl;
+  cpp << "    uint32_t laneNum = fileNum-first < LANES ? fileNum-first : LANES;" << std::endl;
+  cpp << "    uint32_t activeNum = laneNum;" << std::endl;
+  cpp << "    for (uint32_t lane = 0; lane < laneNum; lane++) {" << std::endl;
+  cpp << "      init_lane(lane);" << std::endl;
+  cpp << "      cmdFiles[lane] = open_command_file(fileNames[first+lane]);" << std::endl;
+  cpp << "      if (!cmdFiles[lane]) return -1;" << std::endl;
+  cpp << "    }" << std::endl;
+  cpp << "    while (activeNum > 0) {" << std::endl;
+  cpp << "      memset(instrLaneNum, 0, sizeof(instrLaneNum));" << std::endl;
+  cpp << "      for (uint32_t lane = 0; lane < laneNum; lane++) {" << std::endl;
+  cpp << "        if (!cmdFiles[lane]) continue;" << std::endl;
+  cpp << "        int instrIdx = read_command(cmdFiles[lane], lane);" << std::endl;
+  cpp << "        if (instrIdx < -1) return -1;" << std::endl;
+  cpp << "        if (instrIdx == -1) {" << std::endl;
+  cpp << "          fclose(cmdFiles[lane]);" << std::endl;
+  cpp << "          cmdFiles[lane] = nullptr;" << std::endl;
+  cpp << "          activeNum--;" << std::endl;
+  cpp << "          continue;" << std::endl;
+  cpp << "        }" << std::endl;
+  cpp << "        instrLanes[instrIdx][instrLaneNum[instrIdx]++] = lane;" << std::endl;
+  cpp << "      }" << std::endl;
+  cpp << "      for (uint32_t i = 0; i < "+toStr(instrNum)+"; i++) {" << std::endl;
+  cpp << "        if (instrLaneNum[i] > 0) lanesFuncs[i](instrLanes[i], instrLaneNum[i]);" << std::endl;
+  cpp << "      }" << std::endl;
+  cpp << "    }" << std::endl;
+  cpp << "    for (uint32_t lane = 0; lane < laneNum; lane++) {" << std::endl;
+  cpp << "      printf(\"%s:\\n\", fileNames[first+lane]);" << std::endl;
+  cpp << "    ";
+  print_asvs(cpp, "The final results:", true /*always*/);
+  cpp << "    }" << std::endl;
+  cpp << "  }" << std::endl;
+  cpp << std::endl << "  return 0;" << std::endl;
+  cpp << "}" << std::endl;
+}
+
+
+// Generate the C API of -lib (declared in ila_api.h, see print_lib_header()).
+void print_lib_api(std::ofstream &cpp) {
+  std::map<std::string, uint32_t> asvWidths;
+  collect_scalar_asvs(asvWidths);
+
+  print_instr_func_table(cpp);
+
+  // Names are sorted, for a binary search
+  cpp << "struct IlaVarInfo_t {" << std::endl;
+  cpp << "  const char *name;" << std::endl;
+  cpp << "  uint32_t width;" << std::endl;
+  cpp << "  uint32_t length;  // Register arrays only" << std::endl;
+  cpp << "};" << std::endl << std::endl;
+  cpp << "static const IlaVarInfo_t asvInfos[] = {" << std::endl;
+  for(auto &pair : asvWidths)
+    cpp << "  {\""+pair.first+"\", "+toStr(pair.second)+", 0}," << std::endl;
+  cpp << "  {nullptr, 0, 0}" << std::endl;
+  cpp << "};" << std::endl << std::endl;
+  cpp << "static const IlaVarInfo_t arrayInfos[] = {" << std::endl;
+  for(auto &pair : g_registerArrays)
+    cpp << "  {\""+pair.first+"\", "+toStr(pair.second.getWidth())+", "+toStr(pair.second.getLength())+"}," << std::endl;
+  cpp << "  {nullptr, 0, 0}" << std::endl;
+  cpp << "};" << std::endl << std::endl;
+  cpp << "static const char *instrNames[] = {" << std::endl;
+  for(auto &instrInfo : g_instrInfo)
+    cpp << "  \""+instrInfo.name+"\"," << std::endl;
+  cpp << "};" << std::endl << std::endl;
+
+  cpp << "static int find_var(const IlaVarInfo_t *infos, uint32_t num, const char *name) {" << std::endl;
+  cpp << "  uint32_t lo = 0, hi = num;" << std::endl;
+  cpp << "  while (lo < hi) {" << std::endl;
+  cpp << "    uint32_t mid = (lo+hi) / 2;" << std::endl;
+  cpp << "    int c = strcmp(infos[mid].name, name);" << std::endl;
+  cpp << "    if (c == 0) return mid;" << std::endl;
+  cpp << "    if (c < 0) lo = mid+1;" << std::endl;
+  cpp << "    else hi = mid;" << std::endl;
+  cpp << "  }" << std::endl;
+  cpp << "  return -1;" << std::endl;
+  cpp << "}" << std::endl << std::endl;
+
+  // Copy between the C variables and arrays of 64-bit words
+  auto get_stmt = [](const std::string& var, uint32_t width) {
+    if (width <= 64) return "words[0] = "+var+";";
+    if (width <= 128) return "words[0] = (uint64_t)"+var+"; words[1] = (uint64_t)("+var+" >> 64);";
+    return "std::copy("+var+".begin(), "+var+".end(), words);";
+  };
+  auto set_stmt = [](const std::string& var, uint32_t width) {
+    if (width <= 64) return var+" = words[0];";
+    if (width <= 128) return var+" = ((unsigned __int128)words[1] << 64) | words[0];";
+    return "std::copy(words, words+"+toStr(word_num(width))+", "+var+".begin());";
+  };
+
+  cpp << "static void get_asv(IlaState *ila, int asvId, uint64_t *words) {" << std::endl;
+  cpp << "  switch(asvId) {" << std::endl;
+  uint32_t asvId = 0;
+  for(auto &pair : asvWidths)
+    cpp << "    case "+toStr(asvId++)+": "+get_stmt(pair.first, pair.second)+" break;" << std::endl;
+  cpp << "  }" << std::endl;
+  cpp << "}" << std::endl << std::endl;
+
+  cpp << "static void set_asv(IlaState *ila, int asvId, const uint64_t *words) {" << std::endl;
+  cpp << "  switch(asvId) {" << std::endl;
+  asvId = 0;
+  for(auto &pair : asvWidths)
+    cpp << "    case "+toStr(asvId++)+": "+set_stmt(pair.first, pair.second)+" break;" << std::endl;
+  cpp << "  }" << std::endl;
+  cpp << "}" << std::endl << std::endl;
+
+  cpp << "static void get_array(IlaState *ila, int arrayId, uint32_t idx, uint64_t *words) {" << std::endl;
+  cpp << "  switch(arrayId) {" << std::endl;
+  uint32_t arrayId = 0;
+  for(auto &pair : g_registerArrays)
+    cpp << "    case "+toStr(arrayId++)+": "+get_stmt(pair.first+"[idx]", pair.second.getWidth())+" break;" << std::endl;
+  cpp << "  }" << std::endl;
+  cpp << "}" << std::endl << std::endl;
+
+  uint32_t asvNum = asvWidths.size();
+  uint32_t arrayNum = g_registerArrays.size();
+  uint32_t instrNum = g_instrInfo.size();
+
+  cpp << "extern \"C\" {" << std::endl << std::endl;
+
+  cpp << "IlaState *ila_create() {" << std::endl;
+  cpp << "  IlaState *ila = new IlaState;" << std::endl;
+  cpp << "  PRINT_ALL = 0;" << std::endl;
+  cpp << "  init_state(ila);" << std::endl;
+  cpp << "  return ila;" << std::endl;
+  cpp << "}" << std::endl << std::endl;
+
+  cpp << "void ila_destroy(IlaState *ila) {" << std::endl;
+  cpp << "  delete ila;" << std::endl;
+  cpp << "}" << std::endl << std::endl;
+
+  cpp << "void ila_init(IlaState *ila) {" << std::endl;
+  cpp << "  init_state(ila);" << std::endl;
+  cpp << "}" << std::endl << std::endl;
+
+  cpp << "void ila_set_print(IlaState *ila, int printAll) {" << std::endl;
+  cpp << "  PRINT_ALL = printAll;" << std::endl;
+  cpp << "}" << std::endl << std::endl;
+
+  cpp << "int ila_instr_index(const char *instrName) {" << std::endl;
+  cpp << "  for (uint32_t i = 0; i < "+toStr(instrNum)+"; i++) {" << std::endl;
+  cpp << "    if (strcmp(instrNames[i], instrName) == 0) return i;" << std::endl;
+  cpp << "  }" << std::endl;
+  cpp << "  return -1;" << std::endl;
+  cpp << "}" << std::endl << std::endl;
+
+  cpp << "int ila_step(IlaState *ila, uint32_t instrIdx) {" << std::endl;
+  cpp << "  if (instrIdx >= "+toStr(instrNum)+") return -1;" << std::endl;
+  cpp << "  instrFuncs[instrIdx](ila);" << std::endl;
+  cpp << "  return 0;" << std::endl;
+  cpp << "}" << std::endl << std::endl;
+
+  cpp << "int ila_asv_width(const char *name) {" << std::endl;
+  cpp << "  int asvId = find_var(asvInfos, "+toStr(asvNum)+", name);" << std::endl;
+  cpp << "  return asvId < 0 ? -1 : (int)asvInfos[asvId].width;" << std::endl;
+  cpp << "}" << std::endl << std::endl;
+
+  cpp << "int ila_get_asv(IlaState *ila, const char *name, uint64_t *words, uint32_t wordNum) {" << std::endl;
+  cpp << "  int asvId = find_var(asvInfos, "+toStr(asvNum)+", name);" << std::endl;
+  cpp << "  if (asvId < 0 || wordNum < (asvInfos[asvId].width+63)/64) return -1;" << std::endl;
+  cpp << "  get_asv(ila, asvId, words);" << std::endl;
+  cpp << "  return 0;" << std::endl;
+  cpp << "}" << std::endl << std::endl;
+
+  cpp << "int ila_set_asv(IlaState *ila, const char *name, const uint64_t *words, uint32_t wordNum) {" << std::endl;
+  cpp << "  int asvId = find_var(asvInfos, "+toStr(asvNum)+", name);" << std::endl;
+  cpp << "  if (asvId < 0 || wordNum < (asvInfos[asvId].width+63)/64) return -1;" << std::endl;
+  cpp << "  set_asv(ila, asvId, words);" << std::endl;
+  cpp << "  return 0;" << std::endl;
+  cpp << "}" << std::endl << std::endl;
+
+  cpp << "const char *ila_asv_name(uint32_t asvIdx) {" << std::endl;
+  cpp << "  return asvIdx < "+toStr(asvNum)+" ? asvInfos[asvIdx].name : nullptr;" << std::endl;
+  cpp << "}" << std::endl << std::endl;
+
+  cpp << "const char *ila_array_name(uint32_t arrayIdx) {" << std::endl;
+  cpp << "  return arrayIdx < "+toStr(arrayNum)+" ? arrayInfos[arrayIdx].name : nullptr;" << std::endl;
+  cpp << "}" << std::endl << std::endl;
+
+  cpp << "int ila_array_width(const char *name) {" << std::endl;
+  cpp << "  int arrayId = find_var(arrayInfos, "+toStr(arrayNum)+", name);" << std::endl;
+  cpp << "  return arrayId < 0 ? -1 : (int)arrayInfos[arrayId].width;" << std::endl;
+  cpp << "}" << std::endl << std::endl;
+
+  cpp << "int ila_array_length(const char *name) {" << std::endl;
+  cpp << "  int arrayId = find_var(arrayInfos, "+toStr(arrayNum)+", name);" << std::endl;
+  cpp << "  return arrayId < 0 ? -1 : (int)arrayInfos[arrayId].length;" << std::endl;
+  cpp << "}" << std::endl << std::endl;
+
+  cpp << "int ila_get_array(IlaState *ila, const char *name, uint32_t idx, uint64_t *words, uint32_t wordNum) {" << std::endl;
+  cpp << "  int arrayId = find_var(arrayInfos, "+toStr(arrayNum)+", name);" << std::endl;
+  cpp << "  if (arrayId < 0 || idx >= arrayInfos[arrayId].length" << std::endl;
+  cpp << "      || wordNum < (arrayInfos[arrayId].width+63)/64) return -1;" << std::endl;
+  cpp << "  get_array(ila, arrayId, idx, words);" << std::endl;
+  cpp << "  return 0;" << std::endl;
+  cpp << "}" << std::endl << std::endl;
+
+  cpp << "} // extern \"C\"" << std::endl;
+}
+
+
+// The public header of the -lib C API
+void print_lib_header(std::string fileName) {
+  std::ofstream header(fileName);
+  header << "#ifndef _ILA_API_H_" << std::endl;
+  header << "#define _ILA_API_H_" << std::endl;
+  header << std::endl;
+  header << "// C API of the simulator generated by sim_gen -lib.  Every IlaState is an" << std::endl;
+  header << "// independent simulation, so different states can be used on different" << std::endl;
+  header << "// threads at the same time.  Values are arrays of 64-bit words, least" << std::endl;
+  header << "// significant word first.  ASVs are named as in the output of print_asvs." << std::endl;
+  header << std::endl;
+  header << "#include <stdint.h>" << std::endl;
+  header << std::endl;
+  header << "#ifdef __cplusplus" << std::endl
+         << "extern \"C\" {" << std::endl
+         << "#endif" << std::endl << std::endl;
+  header << "typedef struct IlaState IlaState;" << std::endl;
+  header << std::endl;
+  header << "// A new state, with all ASVs at their reset values" << std::endl;
+  header << "IlaState *ila_create(void);" << std::endl;
+  header << "void ila_destroy(IlaState *ila);" << std::endl;
+  header << "// Set all ASVs back to their reset values" << std::endl;
+  header << "void ila_init(IlaState *ila);" << std::endl;
+  header << "// Print the ASVs after every instruction if printAll is not 0" << std::endl;
+  header << "void ila_set_print(IlaState *ila, int printAll);" << std::endl;
+  header << std::endl;
+  header << "// Index of an instruction of instr.txt, -1 if there is none" << std::endl;
+  header << "int ila_instr_index(const char *instrName);" << std::endl;
+  header << "// Execute one instruction.  Its inputs must have been set with ila_set_asv()." << std::endl;
+  header << "// Returns -1 if instrIdx is out of range." << std::endl;
+  header << "int ila_step(IlaState *ila, uint32_t instrIdx);" << std::endl;
+  header << std::endl;
+  header << "// The functions below return -1 for an unknown name, or if wordNum is too small." << std::endl;
+  header << "int ila_asv_width(const char *name);" << std::endl;
+  header << "int ila_get_asv(IlaState *ila, const char *name, uint64_t *words, uint32_t wordNum);" << std::endl;
+  header << "int ila_set_asv(IlaState *ila, const char *name, const uint64_t *words, uint32_t wordNum);" << std::endl;
+  header << "int ila_get_array(IlaState *ila, const char *name, uint32_t idx," << std::endl;
+  header << "                  uint64_t *words, uint32_t wordNum);" << std::endl;
+  header << "int ila_array_width(const char *name);" << std::endl;
+  header << "int ila_array_length(const char *name);" << std::endl;
+  header << std::endl;
+  header << "// The names of all ASVs and register arrays: nullptr after the last one" << std::endl;
+  header << "const char *ila_asv_name(uint32_t asvIdx);" << std::endl;
+  header << "const char *ila_array_name(uint32_t arrayIdx);" << std::endl;
+  header << std::endl;
+  header << "#ifdef __cplusplus" << std::endl
+         << "}" << std::endl
+         << "#endif" << std::endl;
+  header << std::endl;
+  header << "#endif" << std::endl;
+  header.close();
+}
+
+
+// Lane mode: declare name as an array over the lanes, and make the plain
+// name refer to the element of the current lane.  Each scalar ASV is
+// one contiguous array over the lanes.
+// Library mode: declare name as a member of IlaState, and make the plain
+// name refer to the member of the current state (the #define is emitted
+// after the struct).
+// Either way, all other generated code is the same as for one simulation.
+void declare_state_var(std::ofstream &cpp, const std::string& type,
+                       const std::string& name, const std::string& dims) {
+  if (g_lib) {
+    cpp << "  "+type+" "+name+dims+";" << std::endl;
+    g_stateMacros.push_back("#define "+name+" (ila->"+name+")");
+    return;
+  }
+  cpp << "  "+type+" "+name+"_lanes[LANES]"+dims+";" << std::endl;
+  cpp << "#define "+name+" "+name+"_lanes[lane]" << std::endl;
+}
+
+
+bool has_state_param() {
+  return g_lanes > 0 || g_lib;
+}
+
+
+// The parameter that selects the simulation, for the parameter lists of
+// the generated functions that touch ASVs: "uint32_t lane" in lane mode,
+// "IlaState *ila" in library mode, otherwise nothing.
+std::string state_param(bool comma) {
+  if (!has_state_param()) return "";
+  std::string param = g_lib ? "IlaState *ila" : "uint32_t lane";
+  return comma ? ", "+param : param;
+}
+
+
+std::string state_arg(bool comma) {
+  if (!has_state_param()) return "";
+  std::string arg = g_lib ? "ila" : "lane";
+  return comma ? ", "+arg : arg;
+}
+
+
+static void write_u32(std::ofstream &out, uint32_t val) {
+  out.write(reinterpret_cast<const char*>(&val), sizeof(val));
+}
+
+
+// Encode the instruction list as a command file, and list the var ids
+// in layoutFileName so that other tools can write command files.
+void write_command_file(const std::vector<InstEncoding_t> &instrList,
+                        std::string fileName, std::string layoutFileName) {
+  std::map<std::string, uint32_t> varWidths;
+  collect_runtime_vars(varWidths);
+
+  std::map<std::string, uint32_t> varIds;
+  std::ofstream layout(layoutFileName);
+  layout << "# cmd version "+toStr(g_cmdVersion) << std::endl;
+  for(auto &instrInfo : g_instrInfo)
+    layout << "instr "+toStr(get_instr_by_name(instrInfo.name))+" "+instrInfo.name << std::endl;
+  for(auto &pair : varWidths) {
+    uint32_t varId = varIds.size();
+    varIds.emplace(pair.first, varId);
+    layout << "var "+toStr(varId)+" "+toStr(pair.second)+" "+pair.first << std::endl;
+  }
+  layout.close();
+
+  std::ofstream out(fileName, std::ios::binary);
+  out.write("ILAC", 4);
+  write_u32(out, g_cmdVersion);
+  for(auto &encoding : instrList) {
+    std::vector<std::pair<std::string, llvm::APInt>> assigns;
+    collect_var_assignments(encoding, assigns);
+    write_u32(out, get_instr_by_name(decode(encoding)));
+    write_u32(out, assigns.size());
+    for(auto &assign : assigns) {
+      auto pos = varIds.find(assign.first);
+      if (pos == varIds.end()) {
+        toCout("Error: "+assign.first+" is not an ASV, and cannot be set by a command!");
+        abort();
+      }
+      uint32_t width = varWidths[assign.first];
+      llvm::APInt val = assign.second.zextOrTrunc(width);
+      write_u32(out, pos->second);
+      write_u32(out, word_num(width));
+      out.write(reinterpret_cast<const char*>(val.getRawData()),
+                word_num(width)*sizeof(uint64_t));
+    }
+  }
+  out.close();
+  toCout("### "+toStr(instrList.size())+" commands written to "+fileName);
+}
+
+
+
+// ==========  Paged memory (-paged_mem)
+//
+// mem is a sparse table of 4 KB pages over the 32-bit byte address space.
+// A page is allocated by the first store to it, and loads from other
+// pages read 0, so addresses do not wrap around.  At runtime, the memory
+// is loaded from a raw binary or ELF image, instead of being compiled
+// into the simulator.
+
+// The tb.txt instruction values, for a memory initialized from tb.txt
+void tb_mem_vals(std::vector<llvm::APInt>& vals) {
+  vals.clear();
+  for(auto encoding: toDoList) {
+    if(encoding.find(g_instrValueVar) == encoding.end()) {
+      toCout("Error: the instr value variable is not recognized: "+g_instrValueVar);
+      abort();
+    }
+    llvm::APInt val = convert_to_single_apint(encoding[g_instrValueVar].front());    
+    assert(val.getBitWidth() <= 32);  // We assume 32-bit memory words.
+    vals.push_back(val);
+  }
+}
+
+
+// Write the memory words as a raw little-endian image
+void write_mem_image(const std::vector<llvm::APInt>& vals, std::string fileName) {
+  std::ofstream out(fileName, std::ios::binary);
+  for(const llvm::APInt &val: vals) {
+    assert(val.getBitWidth() <= 32);  // We assume 32-bit memory words.
+    uint32_t word = val.getZExtValue();
+    out.write(reinterpret_cast<const char*>(&word), sizeof(word));
+  }
+  out.close();
+  toCout("### "+toStr(vals.size())+" memory words written to "+fileName);
+}
+
+
+// Generate the page table, the load/store functions (declared in ila.h),
+// the image loaders, and mem_save()/mem_restore() for checkpoints.
+// Stores invalidate the decoded-instruction cache.
+void print_paged_mem(std::ofstream &cpp) {
+  cpp << "  const uint32_t MEM_PAGE_BITS = 12;" << std::endl;
+  cpp << "  const uint32_t MEM_PAGE_SIZE = 1u << MEM_PAGE_BITS;" << std::endl;
+  cpp << "  const uint32_t MEM_PAGE_NUM = 1u << (32-MEM_PAGE_BITS);" << std::endl;
+  cpp << "  static uint8_t *memPages[MEM_PAGE_NUM];  // nullptr: all zero" << std::endl << std::endl;
+
+  cpp << "static uint8_t *mem_page(uint32_t addr) {" << std::endl;
+  cpp << "  uint8_t *&page = memPages[addr >> MEM_PAGE_BITS];" << std::endl;
+  cpp << "  if (!page) page = (uint8_t*)calloc(MEM_PAGE_SIZE, 1);" << std::endl;
+  cpp << "  return page;" << std::endl;
+  cpp << "}" << std::endl << std::endl;
+
+  cpp << "static uint32_t mem_load(uint32_t addr, uint32_t bytes) {" << std::endl;
+  cpp << "  uint32_t offset = addr & (MEM_PAGE_SIZE-1);" << std::endl;
+  cpp << "  uint32_t val = 0;" << std::endl;
+  cpp << "  if (offset+bytes <= MEM_PAGE_SIZE) {" << std::endl;
+  cpp << "    const uint8_t *page = memPages[addr >> MEM_PAGE_BITS];" << std::endl;
+  cpp << "    if (page) memcpy(&val, page+offset, bytes);" << std::endl;
+  cpp << "    return val;" << std::endl;
+  cpp << "  }" << std::endl;
+  cpp << "  for (uint32_t i = 0; i < bytes; i++) val |= mem_load(addr+i, 1) << (8*i);" << std::endl;
+  cpp << "  return val;" << std::endl;
+  cpp << "}" << std::endl << std::endl;
+
+  cpp << "static void mem_store(uint32_t addr, uint32_t val, uint32_t bytes) {" << std::endl;
+  cpp << "  uint32_t offset = addr & (MEM_PAGE_SIZE-1);" << std::endl;
+  cpp << "  if (offset+bytes <= MEM_PAGE_SIZE) {" << std::endl;
+  cpp << "    memcpy(mem_page(addr)+offset, &val, bytes);" << std::endl;
+  cpp << "  } else {" << std::endl;
+  cpp << "    for (uint32_t i = 0; i < bytes; i++) mem_store(addr+i, val >> (8*i), 1);" << std::endl;
+  cpp << "  }" << std::endl;
+  cpp << "  icache_invalidate(addr >> 2);" << std::endl;
+  cpp << "  icache_invalidate((addr+bytes-1) >> 2);" << std::endl;
+  cpp << "}" << std::endl << std::endl;
+
+  for (uint32_t bits : {8, 16, 32}) {
+    std::string ty = "uint"+toStr(bits)+"_t";
+    cpp << ty+" mem_load"+toStr(bits)+"(uint32_t addr) { return mem_load(addr, "+toStr(bits/8)+"); }" << std::endl;
+    cpp << "void mem_store"+toStr(bits)+"(uint32_t addr, "+ty+" val) { mem_store(addr, val, "+toStr(bits/8)+"); }" << std::endl;
+  }
+  cpp << std::endl;
+
+  cpp << "static void mem_write_bytes(uint32_t addr, const uint8_t *data, size_t size) {" << std::endl;
+  cpp << "  for (size_t i = 0; i < size; i++) mem_page(addr+i)[(addr+i) & (MEM_PAGE_SIZE-1)] = data ? data[i] : 0;" << std::endl;
+  cpp << "}" << std::endl << std::endl;
+
+  cpp << "// Copy the PT_LOAD segments of an ELF image to their physical addresses" << std::endl;
+  cpp << "template <class Ehdr_t, class Phdr_t>" << std::endl;
+  cpp << "static bool mem_load_elf(const uint8_t *buf, size_t size, uint32_t *entry) {" << std::endl;
+  cpp << "  if (size < sizeof(Ehdr_t)) return false;" << std::endl;
+  cpp << "  const Ehdr_t *ehdr = (const Ehdr_t*)buf;" << std::endl;
+  cpp << "  if (ehdr->e_phentsize != sizeof(Phdr_t)" << std::endl;
+  cpp << "      || ehdr->e_phoff+(uint64_t)ehdr->e_phnum*sizeof(Phdr_t) > size) return false;" << std::endl;
+  cpp << "  for (uint32_t i = 0; i < ehdr->e_phnum; i++) {" << std::endl;
+  cpp << "    const Phdr_t *phdr = (const Phdr_t*)(buf+ehdr->e_phoff)+i;" << std::endl;
+  cpp << "    if (phdr->p_type != PT_LOAD) continue;" << std::endl;
+  cpp << "    if (phdr->p_offset+(uint64_t)phdr->p_filesz > size || phdr->p_filesz > phdr->p_memsz) return false;" << std::endl;
+  cpp << "    mem_write_bytes(phdr->p_paddr, buf+phdr->p_offset, phdr->p_filesz);" << std::endl;
+  cpp << "    mem_write_bytes(phdr->p_paddr+phdr->p_filesz, nullptr, phdr->p_memsz-phdr->p_filesz);" << std::endl;
+  cpp << "  }" << std::endl;
+  cpp << "  *entry = ehdr->e_entry;" << std::endl;
+  cpp << "  return true;" << std::endl;
+  cpp << "}" << std::endl << std::endl;
+
+  cpp << "// Load <file>[@<address>]: an ELF image, or else a raw image at the" << std::endl;
+  cpp << "// address (default 0).  Returns 1 for ELF, with its entry point, 0 for a" << std::endl;
+  cpp << "// raw image, and -1 if the file cannot be loaded." << std::endl;
+  cpp << "int mem_load_image(const char *fileName, uint32_t *entry) {" << std::endl;
+  cpp << "  char name[4096];" << std::endl;
+  cpp << "  snprintf(name, sizeof(name), \"%s\", fileName);" << std::endl;
+  cpp << "  uint32_t baseAddr = 0;" << std::endl;
+  cpp << "  char *at = strrchr(name, '@');" << std::endl;
+  cpp << "  if (at) {" << std::endl;
+  cpp << "    *at = 0;" << std::endl;
+  cpp << "    baseAddr = strtoul(at+1, nullptr, 0);" << std::endl;
+  cpp << "  }" << std::endl;
+  cpp << "  FILE *file = fopen(name, \"rb\");" << std::endl;
+  cpp << "  if (!file) {" << std::endl;
+  cpp << "    printf(\"Cannot open memory image %s\\n\", name);" << std::endl;
+  cpp << "    return -1;" << std::endl;
+  cpp << "  }" << std::endl;
+  cpp << "  fseek(file, 0, SEEK_END);" << std::endl;
+  cpp << "  size_t size = ftell(file);" << std::endl;
+  cpp << "  fseek(file, 0, SEEK_SET);" << std::endl;
+  cpp << "  uint8_t *buf = (uint8_t*)malloc(size+1);" << std::endl;
+  cpp << "  bool ok = fread(buf, 1, size, file) == size;" << std::endl;
+  cpp << "  fclose(file);" << std::endl;
+  cpp << "  int ret = 0;" << std::endl;
+  cpp << "  if (ok && !at && size >= EI_NIDENT && memcmp(buf, ELFMAG, SELFMAG) == 0) {" << std::endl;
+  cpp << "    ok = buf[EI_DATA] == ELFDATA2LSB" << std::endl;
+  cpp << "         && (buf[EI_CLASS] == ELFCLASS32 ? mem_load_elf<Elf32_Ehdr, Elf32_Phdr>(buf, size, entry)" << std::endl;
+  cpp << "             : mem_load_elf<Elf64_Ehdr, Elf64_Phdr>(buf, size, entry));" << std::endl;
+  cpp << "    ret = 1;" << std::endl;
+  cpp << "  } else if (ok) {" << std::endl;
+  cpp << "    mem_write_bytes(baseAddr, buf, size);" << std::endl;
+  cpp << "  }" << std::endl;
+  cpp << "  free(buf);" << std::endl;
+  cpp << "  icache_invalidate_all();" << std::endl;
+  cpp << "  if (!ok) {" << std::endl;
+  cpp << "    printf(\"Cannot load memory image %s\\n\", name);" << std::endl;
+  cpp << "    return -1;" << std::endl;
+  cpp << "  }" << std::endl;
+  cpp << "  return ret;" << std::endl;
+  cpp << "}" << std::endl << std::endl;
+
+  if (!g_checkpoint) return;
+  cpp << "// Checkpoint format: u32 page count, and u32 page index, page data for every page" << std::endl;
+  cpp << "static bool mem_save(FILE *file) {" << std::endl;
+  cpp << "  uint32_t pageNum = 0;" << std::endl;
+  cpp << "  for (uint32_t i = 0; i < MEM_PAGE_NUM; i++) pageNum += memPages[i] != nullptr;" << std::endl;
+  cpp << "  if (fwrite(&pageNum, sizeof(pageNum), 1, file) != 1) return false;" << std::endl;
+  cpp << "  for (uint32_t i = 0; i < MEM_PAGE_NUM; i++) {" << std::endl;
+  cpp << "    if (memPages[i] && (fwrite(&i, sizeof(i), 1, file) != 1" << std::endl;
+  cpp << "                        || fwrite(memPages[i], 1, MEM_PAGE_SIZE, file) != MEM_PAGE_SIZE)) return false;" << std::endl;
+  cpp << "  }" << std::endl;
+  cpp << "  return true;" << std::endl;
+  cpp << "}" << std::endl << std::endl;
+
+  cpp << "static bool mem_restore(FILE *file) {" << std::endl;
+  cpp << "  for (uint32_t i = 0; i < MEM_PAGE_NUM; i++) {" << std::endl;
+  cpp << "    free(memPages[i]);" << std::endl;
+  cpp << "    memPages[i] = nullptr;" << std::endl;
+  cpp << "  }" << std::endl;
+  cpp << "  uint32_t pageNum, pageIdx;" << std::endl;
+  cpp << "  if (fread(&pageNum, sizeof(pageNum), 1, file) != 1) return false;" << std::endl;
+  cpp << "  for (uint32_t i = 0; i < pageNum; i++) {" << std::endl;
+  cpp << "    if (fread(&pageIdx, sizeof(pageIdx), 1, file) != 1 || pageIdx >= MEM_PAGE_NUM" << std::endl;
+  cpp << "        || fread(mem_page(pageIdx << MEM_PAGE_BITS), 1, MEM_PAGE_SIZE, file) != MEM_PAGE_SIZE) return false;" << std::endl;
+  cpp << "  }" << std::endl;
+  cpp << "  return true;" << std::endl;
+  cpp << "}" << std::endl << std::endl;
+}
+
+
+// Generate the parsing of the -mem <image> option of main(), which is
+// removed from argv.  Without it, mem.bin written by sim_gen is loaded.
+void print_mem_options(std::ofstream &cpp) {
+  std::string defaultImage = g_memSize > 0 ? "\"mem.bin\"" : "nullptr";
+  cpp << "  const char *memImage = "+defaultImage+";  // -mem <file>[@<address>]" << std::endl;
+  cpp << "  int memArgNum = 1;" << std::endl;
+  cpp << "  for (int n = 1; n < argc; n++) {" << std::endl;
+  cpp << "    if (strcmp(argv[n], \"-mem\") == 0 && n+1 < argc) memImage = argv[++n];" << std::endl;
+  cpp << "    else argv[memArgNum++] = argv[n];" << std::endl;
+  cpp << "  }" << std::endl;
+  cpp << "  argc = memArgNum;" << std::endl;
+}
+
+
+// ==========  Binary ASV trace (-trace)
+//
+// With PRINT_ALL, the simulator writes a record of the ASVs that changed
+// after every instruction to a binary trace file (ila_trace.bin, or the
+// file named by $ILA_TRACE), through a large buffer.  The format is
+// described in trace_reader.h, and TraceReader reads it.
+
+struct TraceEntry_t {
+  std::string cName;  // C expression of the value
+  uint32_t width;
+};
+
+
+// Generate the trace writer: trace_asvs() writes one record, for the
+// instruction set in traceInstr.
+void print_trace_writer(std::ofstream &cpp) {
+  // Header vars, and the entries of every var
+  std::vector<std::pair<TraceVar_t, std::vector<TraceEntry_t>>> vars;
+
+  std::map<std::string, uint32_t> scalars;
+  collect_scalar_asvs(scalars);
+  for(auto &pair : scalars)
+    vars.push_back({{pair.first, pair.second, 0, 0}, {{pair.first, pair.second}}});
+
+  for(auto &pair : g_registerArrays) {
+    uint32_t len = pair.second.getLength();
+    uint32_t width = pair.second.getWidth();
+    std::vector<TraceEntry_t> entries;
+    for (uint32_t idx = 0; idx < len; ++idx)
+      entries.push_back({pair.first+"["+toStr(idx)+"]", width});
+    vars.push_back({{pair.first, width, len, 0}, entries});
+  }
+
+  // The rtl vars of the refinement map are printed as 64 bits
+  for(auto pair1 : g_refineMap) {
+    for(auto pair2 : pair1.second)
+      vars.push_back({{pair2.second, 64, 0, 0}, {{"(uint64_t)"+pair2.first, 64}}});
+  }
+
+  uint32_t shadowBytes = 0;
+  uint32_t maxRecordBytes = 8;
+  for(auto &var : vars) {
+    for(auto &entry : var.second) {
+      shadowBytes += trace_value_bytes(entry.width);
+      maxRecordBytes += 4 + trace_value_bytes(entry.width);
+    }
+  }
+
+  cpp << "static FILE *traceFile = nullptr;" << std::endl;
+  cpp << "static unsigned char traceBuf["+toStr(std::max(maxRecordBytes, 1u << 20))+"];" << std::endl;
+  cpp << "static size_t traceLen = 0;" << std::endl;
+  cpp << "static unsigned char traceShadow["+toStr(std::max(shadowBytes, 1u))+"];  // Values of the last record" << std::endl;
+  cpp << "static bool traceFirst = true;" << std::endl;
+  cpp << "static uint32_t traceInstr = "+toStr(TRACE_INIT)+"u;" << std::endl << std::endl;
+
+  cpp << "static void trace_flush() {" << std::endl;
+  cpp << "  fwrite(traceBuf, 1, traceLen, traceFile);" << std::endl;
+  cpp << "  traceLen = 0;" << std::endl;
+  cpp << "}" << std::endl << std::endl;
+
+  cpp << "static void trace_close() {" << std::endl;
+  cpp << "  if (!traceFile) return;" << std::endl;
+  cpp << "  trace_flush();" << std::endl;
+  cpp << "  fclose(traceFile);" << std::endl;
+  cpp << "  traceFile = nullptr;" << std::endl;
+  cpp << "}" << std::endl << std::endl;
+
+  cpp << "static void trace_put(const void *data, size_t size) {" << std::endl;
+  cpp << "  memcpy(traceBuf+traceLen, data, size);" << std::endl;
+  cpp << "  traceLen += size;" << std::endl;
+  cpp << "}" << std::endl << std::endl;
+
+  cpp << "static void trace_open() {" << std::endl;
+  cpp << "  const char *fileName = getenv(\"ILA_TRACE\");" << std::endl;
+  cpp << "  if (!fileName) fileName = \"ila_trace.bin\";" << std::endl;
+  cpp << "  traceFile = fopen(fileName, \"wb\");" << std::endl;
+  cpp << "  if (!traceFile) {" << std::endl;
+  cpp << "    printf(\"Cannot write trace file %s\\n\", fileName);" << std::endl;
+  cpp << "    exit(-1);" << std::endl;
+  cpp << "  }" << std::endl;
+  cpp << "  atexit(trace_close);" << std::endl;
+  cpp << "  static const struct { uint32_t width, length; const char *name; } vars[] = {" << std::endl;
+  for(auto &var : vars)
+    cpp << "    {"+toStr(var.first.width)+", "+toStr(var.first.length)+", \""+var.first.name+"\"}," << std::endl;
+  cpp << "  };" << std::endl;
+  cpp << "  uint32_t header[2] = {"+toStr(TRACE_VERSION)+", "+toStr(vars.size())+"};" << std::endl;
+  cpp << "  fwrite(\""+std::string(TRACE_MAGIC)+"\", 1, 4, traceFile);" << std::endl;
+  cpp << "  fwrite(header, sizeof(uint32_t), 2, traceFile);" << std::endl;
+  cpp << "  for (auto &var : vars) {" << std::endl;
+  cpp << "    uint32_t data[3] = {var.width, var.length, (uint32_t)strlen(var.name)};" << std::endl;
+  cpp << "    fwrite(data, sizeof(uint32_t), 3, traceFile);" << std::endl;
+  cpp << "    fwrite(var.name, 1, data[2], traceFile);" << std::endl;
+  cpp << "  }" << std::endl;
+  cpp << "}" << std::endl << std::endl;
+
+  cpp << "// Add the entry to the record if it changed since the last one" << std::endl;
+  cpp << "static inline void trace_value(uint32_t entry, const void *value, size_t size," << std::endl;
+  cpp << "                               size_t offset, uint32_t &count) {" << std::endl;
+  cpp << "  if (!traceFirst && memcmp(traceShadow+offset, value, size) == 0) return;" << std::endl;
+  cpp << "  memcpy(traceShadow+offset, value, size);" << std::endl;
+  cpp << "  trace_put(&entry, sizeof(entry));" << std::endl;
+  cpp << "  trace_put(value, size);" << std::endl;
+  cpp << "  count++;" << std::endl;
+  cpp << "}" << std::endl << std::endl;
+
+  cpp << "static void trace_asvs() {" << std::endl;
+  cpp << "  if (!traceFile) trace_open();" << std::endl;
+  cpp << "  if (traceLen+"+toStr(maxRecordBytes)+" > sizeof(traceBuf)) trace_flush();" << std::endl;
+  cpp << "  size_t recordPos = traceLen;" << std::endl;
+  cpp << "  uint32_t count = 0;" << std::endl;
+  cpp << "  traceLen += 8;" << std::endl;
+  uint32_t entryIdx = 0;
+  uint32_t offset = 0;
+  for(auto &var : vars) {
+    for(auto &entry : var.second) {
+      uint32_t bytes = trace_value_bytes(entry.width);
+      std::string valueVar = entry.cName;
+      if (entry.cName[0] == '(') {
+        // Not an lvalue
+        cpp << "  uint64_t value"+toStr(entryIdx)+" = "+entry.cName+";" << std::endl;
+        valueVar = "value"+toStr(entryIdx);
+      }
+      cpp << "  trace_value("+toStr(entryIdx)+", &"+valueVar+", "+toStr(bytes)+", "
+             +toStr(offset)+", count);" << std::endl;
+      entryIdx++;
+      offset += bytes;
+    }
+  }
+  cpp << "  memcpy(traceBuf+recordPos, &traceInstr, 4);" << std::endl;
+  cpp << "  memcpy(traceBuf+recordPos+4, &count, 4);" << std::endl;
+  cpp << "  traceFirst = false;" << std::endl;
+  cpp << "}" << std::endl << std::endl;
+}
+
+
+// ==========  Checkpoints (-checkpoint)
+//
+// A checkpoint file holds the simulation state after some number of
+// instructions (or commands):
+//   "ILAS", u32 version, u64 layout hash, u64 instruction count,
+// followed by the raw bytes of the C variables listed by
+// collect_checkpoint_vars(), in that order.  The layout hash is over
+// their names and sizes, so a checkpoint is only restored by a simulator
+// of the same design.  The _nxt variables are not saved: between
+// instructions they hold the same values as the current ones.
+
+const uint32_t g_checkpointVersion = 1;
+
+struct CheckpointVar_t {
+  std::string name;
+  std::string layout;  // Name and size, for the layout hash
+  bool hasNxt;
+};
+
+
+// All C variables of the simulation state: the scalar ASVs, the register
+// arrays, and mem[] and dmem[] of processor designs
+static void collect_checkpoint_vars(std::vector<CheckpointVar_t> &vars) {
+  std::map<std::string, uint32_t> scalars;
+  collect_scalar_asvs(scalars);
+  for(auto &pair : scalars)
+    vars.push_back({pair.first, pair.first+":"+toStr(pair.second), true});
+  for(auto &name : {g_dataAddrVar, g_dataIn, std::string("data_byte_addr")}) {
+    if (!scalars.count(name)) vars.push_back({name, name+":32", false});
+  }
+
+  for(auto &pair : g_registerArrays) {
+    std::string layout = pair.first+"["+toStr(pair.second.getLength())+"]:"
+                         +toStr(pair.second.getWidth());
+    vars.push_back({pair.first, layout, true});
+  }
+
+  if (g_fetch_instr_from_mem && g_memSize > 0 && !g_paged_mem)
+    vars.push_back({"mem", "mem["+toStr(g_memSize)+"]:32", false});
+  if (g_set_dmem)
+    vars.push_back({"dmem", "dmem[64]:"+toStr(g_dmem_width), false});
+}
+
+
+// FNV-1a, which unlike std::hash is the same in every build of sim_gen
+static uint64_t layout_hash(const std::vector<CheckpointVar_t> &vars) {
+  uint64_t hash = 0xcbf29ce484222325ull;
+  for(auto &var : vars) {
+    for(char c : var.layout+";") {
+      hash ^= (uint8_t)c;
+      hash *= 0x100000001b3ull;
+    }
+  }
+  return hash;
+}
+
+
+// Generate save_checkpoint(), restore_checkpoint() and
+// save_numbered_checkpoint().  The first two are declared in ila.h,
+// for a user-written main().
+void print_checkpoint_funcs(std::ofstream &cpp) {
+  std::vector<CheckpointVar_t> vars;
+  collect_checkpoint_vars(vars);
+
+  cpp << "const uint32_t CHECKPOINT_VERSION = "+toStr(g_checkpointVersion)+";" << std::endl;
+  // The pages of a paged memory follow the variables
+  std::vector<CheckpointVar_t> layoutVars = vars;
+  if (g_paged_mem) layoutVars.push_back({"mem", "mem:paged", false});
+  cpp << "const uint64_t CHECKPOINT_LAYOUT = "+toStr(layout_hash(layoutVars))+"ull;" << std::endl << std::endl;
+
+  cpp << "int save_checkpoint(const char *fileName, uint64_t instrCount) {" << std::endl;
+  cpp << "  FILE *file = fopen(fileName, \"wb\");" << std::endl;
+  cpp << "  if (!file) {" << std::endl;
+  cpp << "    printf(\"Cannot write checkpoint file %s\\n\", fileName);" << std::endl;
+  cpp << "    return -1;" << std::endl;
+  cpp << "  }" << std::endl;
+  cpp << "  uint32_t version = CHECKPOINT_VERSION;" << std::endl;
+  cpp << "  uint64_t layout = CHECKPOINT_LAYOUT;" << std::endl;
+  cpp << "  bool ok = fwrite(\"ILAS\", 1, 4, file) == 4" << std::endl;
+  cpp << "            && fwrite(&version, sizeof(version), 1, file) == 1" << std::endl;
+  cpp << "            && fwrite(&layout, sizeof(layout), 1, file) == 1" << std::endl;
+  cpp << "            && fwrite(&instrCount, sizeof(instrCount), 1, file) == 1;" << std::endl;
+  for(auto &var : vars)
+    cpp << "  ok = ok && fwrite(&"+var.name+", sizeof("+var.name+"), 1, file) == 1;" << std::endl;
+  if (g_paged_mem) cpp << "  ok = ok && mem_save(file);" << std::endl;
+  cpp << "  if (fclose(file) != 0) ok = false;" << std::endl;
+  cpp << "  if (!ok) printf(\"Cannot write checkpoint file %s\\n\", fileName);" << std::endl;
+  cpp << "  return ok ? 0 : -1;" << std::endl;
+  cpp << "}" << std::endl << std::endl;
+
+  cpp << "int restore_checkpoint(const char *fileName, uint64_t *instrCount) {" << std::endl;
+  cpp << "  FILE *file = fopen(fileName, \"rb\");" << std::endl;
+  cpp << "  if (!file) {" << std::endl;
+  cpp << "    printf(\"Cannot open checkpoint file %s\\n\", fileName);" << std::endl;
+  cpp << "    return -1;" << std::endl;
+  cpp << "  }" << std::endl;
+  cpp << "  char magic[4];" << std::endl;
+  cpp << "  uint32_t version;" << std::endl;
+  cpp << "  uint64_t layout;" << std::endl;
+  cpp << "  if (fread(magic, 1, 4, file) != 4 || memcmp(magic, \"ILAS\", 4) != 0" << std::endl;
+  cpp << "      || fread(&version, sizeof(version), 1, file) != 1 || version != CHECKPOINT_VERSION" << std::endl;
+  cpp << "      || fread(&layout, sizeof(layout), 1, file) != 1 || layout != CHECKPOINT_LAYOUT) {" << std::endl;
+  cpp << "    printf(\"%s is not a checkpoint of this simulator\\n\", fileName);" << std::endl;
+  cpp << "    fclose(file);" << std::endl;
+  cpp << "    return -1;" << std::endl;
+  cpp << "  }" << std::endl;
+  cpp << "  bool ok = fread(instrCount, sizeof(*instrCount), 1, file) == 1;" << std::endl;
+  for(auto &var : vars)
+    cpp << "  ok = ok && fread(&"+var.name+", sizeof("+var.name+"), 1, file) == 1;" << std::endl;
+  if (g_paged_mem) cpp << "  ok = ok && mem_restore(file);" << std::endl;
+  cpp << "  fclose(file);" << std::endl;
+  cpp << "  if (!ok) {" << std::endl;
+  cpp << "    printf(\"Broken checkpoint file %s\\n\", fileName);" << std::endl;
+  cpp << "    return -1;" << std::endl;
+  cpp << "  }" << std::endl;
+  for(auto &var : vars) {
+    if (!var.hasNxt) continue;
+    if (g_registerArrays.count(var.name))
+      cpp << "  memcpy("+var.name+nxt+", "+var.name+", sizeof("+var.name+"));" << std::endl;
+    else
+      cpp << "  "+var.name+nxt+" = "+var.name+";" << std::endl;
+  }
+  if (g_fetch_instr_from_mem) cpp << "  icache_invalidate_all();" << std::endl;
+  cpp << "  return 0;" << std::endl;
+  cpp << "}" << std::endl << std::endl;
+
+  cpp << "// For -every: write <saveFile>.<instrCount>" << std::endl;
+  cpp << "static int save_numbered_checkpoint(const char *saveFile, uint64_t instrCount) {" << std::endl;
+  cpp << "  char fileName[4096];" << std::endl;
+  cpp << "  snprintf(fileName, sizeof(fileName), \"%s.%lu\", saveFile, (unsigned long)instrCount);" << std::endl;
+  cpp << "  return save_checkpoint(fileName, instrCount);" << std::endl;
+  cpp << "}" << std::endl << std::endl;
+}
+
+
+// Generate the parsing of the checkpoint options of main().  They are
+// removed from argv, so the other args keep their positions.
+void print_checkpoint_options(std::ofstream &cpp) {
+  cpp << "  const char *saveFile = nullptr;     // -save <file>: checkpoint at the end" << std::endl;
+  cpp << "  uint64_t saveEvery = 0;             // -every <n>: also <file>.<count> every n instructions" << std::endl;
+  cpp << "  const char *restoreFile = nullptr;  // -restore <file>: continue from a checkpoint" << std::endl;
+  cpp << "  int argNum = 1;" << std::endl;
+  cpp << "  for (int n = 1; n < argc; n++) {" << std::endl;
+  cpp << "    if (strcmp(argv[n], \"-save\") == 0 && n+1 < argc) saveFile = argv[++n];" << std::endl;
+  cpp << "    else if (strcmp(argv[n], \"-every\") == 0 && n+1 < argc) saveEvery = strtoull(argv[++n], nullptr, 10);" << std::endl;
+  cpp << "    else if (strcmp(argv[n], \"-restore\") == 0 && n+1 < argc) restoreFile = argv[++n];" << std::endl;
+  cpp << "    else argv[argNum++] = argv[n];" << std::endl;
+  cpp << "  }" << std::endl;
+  cpp << "  argc = argNum;" << std::endl;
+  cpp << "  if (saveEvery && !saveFile) {" << std::endl;
+  cpp << "    printf(\"-every needs -save <file>\\n\");" << std::endl;
+  cpp << "    return -1;" << std::endl;
+  cpp << "  }" << std::endl;
+}
+
+
+
+// ==========  Instruction sequence profile (-profile) and fused functions (-fuse)
+//
+// A simulator of -profile counts how often each pair and triple of
+// instructions ran straight through, each one from the word after the one
+// before, and writes the counts to instr_profile.txt:
+//
+//   <count> <instr name> <instr name> [<instr name>]
+//
+// With -fuse <n>, sim_gen reads the file and generates one function for
+// each of the n hottest sequences, which executes the bodies of all its
+// instructions.  The fetch loop calls it when the sequence starts at the
+// fetched word, so the compiler (e.g. clang -O3 in link.sh, where the
+// update functions are in the same module) optimizes across the
+// instructions, and ASVs that one instruction writes and the next reads
+// need not go through memory.  A fused function returns early when an
+// instruction does not continue at the next word.
+
+// Generate profile_instr() and write_instr_profile()
+void print_profile_funcs(std::ofstream &cpp) {
+  cpp << "static const char *instrNames["+toStr(g_instrInfo.size())+"] = {" << std::endl;
+  for(auto &instrInfo : g_instrInfo)
+    cpp << "  \""+instrInfo.name+"\"," << std::endl;
+  cpp << "};" << std::endl << std::endl;
+
+  // Key: first | second << 16, and (third+1) << 32 for a triple
+  cpp << "static std::unordered_map<uint64_t, uint64_t> seqCounts;" << std::endl;
+  cpp << "static int profPrev[2] = {-1, -1};" << std::endl;
+  cpp << "static uint32_t profNextAddr = 0;" << std::endl << std::endl;
+
+  cpp << "static void profile_instr(int instrIdx, uint32_t addr) {" << std::endl;
+  cpp << "  if (addr != profNextAddr) profPrev[0] = profPrev[1] = -1;  // Not straight through" << std::endl;
+  cpp << "  if (profPrev[1] >= 0) {" << std::endl;
+  cpp << "    seqCounts[(uint64_t)profPrev[1] | (uint64_t)instrIdx << 16]++;" << std::endl;
+  cpp << "    if (profPrev[0] >= 0)" << std::endl;
+  cpp << "      seqCounts[(uint64_t)profPrev[0] | (uint64_t)profPrev[1] << 16 | (uint64_t)(instrIdx+1) << 32]++;" << std::endl;
+  cpp << "  }" << std::endl;
+  cpp << "  profPrev[0] = profPrev[1];" << std::endl;
+  cpp << "  profPrev[1] = instrIdx;" << std::endl;
+  cpp << "  profNextAddr = addr+1;" << std::endl;
+  cpp << "}" << std::endl << std::endl;
+
+  cpp << "static void write_instr_profile(const char *fileName) {" << std::endl;
+  cpp << "  std::vector<std::pair<uint64_t, uint64_t>> seqs(seqCounts.begin(), seqCounts.end());" << std::endl;
+  cpp << "  std::sort(seqs.begin(), seqs.end(), [](const std::pair<uint64_t, uint64_t> &a," << std::endl;
+  cpp << "                                         const std::pair<uint64_t, uint64_t> &b) {" << std::endl;
+  cpp << "    return a.second > b.second;" << std::endl;
+  cpp << "  });" << std::endl;
+  cpp << "  FILE *file = fopen(fileName, \"w\");" << std::endl;
+  cpp << "  if (!file) {" << std::endl;
+  cpp << "    printf(\"Cannot write %s\\n\", fileName);" << std::endl;
+  cpp << "    return;" << std::endl;
+  cpp << "  }" << std::endl;
+  cpp << "  fprintf(file, \"# <count> <instructions>, for sim_gen -fuse\\n\");" << std::endl;
+  cpp << "  for (auto &seq : seqs) {" << std::endl;
+  cpp << "    fprintf(file, \"%llu %s %s\", (unsigned long long)seq.second," << std::endl;
+  cpp << "            instrNames[seq.first & 0xffff], instrNames[(seq.first >> 16) & 0xffff]);" << std::endl;
+  cpp << "    if (seq.first >> 32) fprintf(file, \" %s\", instrNames[(seq.first >> 32) - 1]);" << std::endl;
+  cpp << "    fprintf(file, \"\\n\");" << std::endl;
+  cpp << "  }" << std::endl;
+  cpp << "  fclose(file);" << std::endl;
+  cpp << "}" << std::endl << std::endl;
+}
+
+
+// Keep the g_fuse sequences of instr_profile.txt that save the most
+// dispatches, i.e. with the largest count * (length-1)
+void read_instr_profile(std::string fileName) {
+  std::ifstream input(fileName);
+  if (!input.is_open()) {
+    toCout("Warning: cannot read "+fileName+", no instructions are fused.  It is written by a simulator of sim_gen -profile.");
+    return;
+  }
+
+  std::map<std::string, uint32_t> instrIdx;
+  for (uint32_t i = 0; i < g_instrInfo.size(); i++)
+    instrIdx.emplace(g_instrInfo[i].name, i);
+
+  std::vector<std::pair<uint64_t, std::vector<uint32_t>>> seqs;
+  std::string line;
+  while (std::getline(input, line)) {
+    if (line.empty() || line[0] == '#') continue;
+    std::istringstream ss(line);
+    uint64_t count;
+    std::string name;
+    std::vector<uint32_t> seq;
+    bool known = (bool)(ss >> count);
+    while (known && ss >> name) {
+      auto pos = instrIdx.find(name);
+      known = pos != instrIdx.end();
+      if (known) seq.push_back(pos->second);
+    }
+    if (!known || seq.size() < 2 || seq.size() > g_fusedMaxLen) {
+      toCout("Warning: ignoring line of "+fileName+": "+line);
+      continue;
+    }
+    seqs.emplace_back(count*(seq.size()-1), seq);
+  }
+
+  std::stable_sort(seqs.begin(), seqs.end(),
+                   [](const std::pair<uint64_t, std::vector<uint32_t>>& a,
+                      const std::pair<uint64_t, std::vector<uint32_t>>& b) {
+                     return a.first > b.first;
+                   });
+  for (uint32_t i = 0; i < seqs.size() && g_fusedSeqs.size() < g_fuse; i++)
+    g_fusedSeqs.push_back(seqs[i].second);
+
+  // match_fused() tries the longest sequences first
+  std::stable_sort(g_fusedSeqs.begin(), g_fusedSeqs.end(),
+                   [](const std::vector<uint32_t>& a, const std::vector<uint32_t>& b) {
+                     return a.size() > b.size();
+                   });
+  toCout("### "+toStr(g_fusedSeqs.size())+" instruction sequences will be fused");
+}
+
+
+// Generate the fused functions, and match_fused(), which finds the one
+// that starts with the decoded instructions of an icache entry
+void print_fused_funcs(std::ofstream &cpp) {
+  cpp << "typedef int (*FusedFunc_t)(const ICacheEntry_t &entry);" << std::endl << std::endl;
+
+  for (uint32_t k = 0; k < g_fusedSeqs.size(); k++) {
+    const std::vector<uint32_t>& seq = g_fusedSeqs[k];
+    std::string names;
+    for (uint32_t idx : seq) names += (names.empty() ? "" : ", ")+g_instrInfo[idx].name;
+
+    cpp << "// Fused: "+names << std::endl;
+    cpp << "static int fused_"+toStr(k)+"(const ICacheEntry_t &entry) {" << std::endl;
+    cpp << "  uint32_t pc = "+g_instrAddrVar+";" << std::endl;
+    for (uint32_t j = 0; j < seq.size(); j++) {
+      if (j > 0)
+        cpp << "  if ((uint32_t)"+g_instrAddrVar+" != pc+"+toStr(4*j)+") return "+toStr(j)+";" << std::endl;
+      cpp << "  {" << std::endl;
+      cpp << "    "+g_instrValueVar+" = "+(j == 0 ? "entry.value" : "entry.next["+toStr(j-1)+"]")+";" << std::endl;
+      print_instr_calls(g_instrInfo[seq[j]].instrEncoding, "    ", cpp);
+      cpp << "  }" << std::endl;
+    }
+    cpp << "  return "+toStr(seq.size())+";" << std::endl;
+    cpp << "}" << std::endl << std::endl;
+  }
+
+  cpp << "static FusedFunc_t match_fused(int instrIdx, const int *nextIdx, uint32_t *len) {" << std::endl;
+  for (uint32_t k = 0; k < g_fusedSeqs.size(); k++) {
+    const std::vector<uint32_t>& seq = g_fusedSeqs[k];
+    std::string cond = "instrIdx == "+toStr(seq[0]);
+    for (uint32_t j = 1; j < seq.size(); j++)
+      cond += " && nextIdx["+toStr(j-1)+"] == "+toStr(seq[j]);
+    cpp << "  if ("+cond+") {" << std::endl;
+    cpp << "    *len = "+toStr(seq.size())+";" << std::endl;
+    cpp << "    return fused_"+toStr(k)+";" << std::endl;
+    cpp << "  }" << std::endl;
+  }
+  cpp << "  return nullptr;" << std::endl;
+  cpp << "}" << std::endl << std::endl;
+}
+
+
+
+// Update functions built with g_post_opto_mux_profile count how often the
+// condition of every mux is true and false (see BranchMux::instrumentSelects()).
+// Their module constructors register the counters, which are written to
+// mux_profile.txt at exit, for a build with g_post_opto_mux_profile_file.
+void print_mux_profile_funcs(std::ofstream &cpp) {
+  cpp << "struct MuxCounts_t {" << std::endl;
+  cpp << "  const char *funcName;" << std::endl;
+  cpp << "  uint64_t *counts;  // True and false count of every mux" << std::endl;
+  cpp << "  uint32_t selectNum;" << std::endl;
+  cpp << "};" << std::endl << std::endl;
+
+  // Registered before main(), so it is created on first use
+  cpp << "static std::vector<MuxCounts_t>& mux_counts() {" << std::endl;
+  cpp << "  static std::vector<MuxCounts_t> counts;" << std::endl;
+  cpp << "  return counts;" << std::endl;
+  cpp << "}" << std::endl << std::endl;
+
+  cpp << "static void write_mux_profile() {" << std::endl;
+  cpp << "  FILE *file = fopen(\"mux_profile.txt\", \"w\");" << std::endl;
+  cpp << "  if (!file) {" << std::endl;
+  cpp << "    printf(\"Cannot write mux_profile.txt\\n\");" << std::endl;
+  cpp << "    return;" << std::endl;
+  cpp << "  }" << std::endl;
+  cpp << "  for (const MuxCounts_t &func : mux_counts()) {" << std::endl;
+  cpp << "    for (uint32_t i = 0; i < func.selectNum; i++) {" << std::endl;
+  cpp << "      if (func.counts[2*i] || func.counts[2*i+1])" << std::endl;
+  cpp << "        fprintf(file, \"%s %u %llu %llu\\n\", func.funcName, i," << std::endl;
+  cpp << "                (unsigned long long)func.counts[2*i], (unsigned long long)func.counts[2*i+1]);" << std::endl;
+  cpp << "    }" << std::endl;
+  cpp << "  }" << std::endl;
+  cpp << "  fclose(file);" << std::endl;
+  cpp << "}" << std::endl << std::endl;
+
+  cpp << "extern \"C\" void ila_mux_profile_register(const char *funcName, uint64_t *counts, uint32_t selectNum) {" << std::endl;
+  cpp << "  if (mux_counts().empty()) atexit(write_mux_profile);" << std::endl;
+  cpp << "  mux_counts().push_back({funcName, counts, selectNum});" << std::endl;
+  cpp << "}" << std::endl << std::endl;
+}
+
+
+
 // For use with variables with multiple per-cycle values
 std::string var_name_cycle_convert(const std::string& varName, int cycle) {
 
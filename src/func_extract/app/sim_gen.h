@@ -22,7 +22,7 @@ std::string c_type(uint32_t width);
 
 std::string func_call(std::string indent, std::string writeASV,
                       const funcExtract::FuncTy_t& funcTy, std::string funcName, 
-                      const InstEncoding_t &encoding,
+                      const funcExtract::InstrInfo_t& instrInfo,
                       std::pair<std::string, uint32_t> dataIn);                      
 
 std::string get_arg_value(const std::string& arg, int cycle, const InstEncoding_t& encoding);
@@ -35,6 +35,9 @@ void print_func_declare(const funcExtract::FuncTy_t& funcTy,
 void print_var_assignments(std::ofstream &cpp, std::string indent, 
                       const InstEncoding_t &inputInstr);
 
+void collect_var_assignments(const InstEncoding_t &inputInstr,
+                             std::vector<std::pair<std::string, llvm::APInt>> &assigns);
+
 std::string apint2initializer(const llvm::APInt& val);
 std::string apint2literal(const llvm::APInt& val);
 
@@ -99,5 +102,67 @@ void print_instr_wrapper_call(const InstEncoding_t& encoding,
                               const std::string &indent,
                               std::ofstream &cpp);
 
+// Declare the decoded-instruction cache of the fetch loop
+void print_icache(std::ofstream &cpp);
+
+// Table of the instruction wrapper functions, indexed like g_instrInfo
+void print_instr_func_table(std::ofstream &cpp);
+
+// Generate decode_instr(), a decision-tree decoder of g_instrValueVar
+void print_instr_decoder(std::ofstream &cpp);
+
+// Variables that can be set by a runtime command, and their widths
+void collect_runtime_vars(std::map<std::string, uint32_t> &varWidths);
+
+// Generate the functions that read a binary command file (see sim_gen.cpp)
+void print_command_reader(std::ofstream &cpp);
+
+// Generate a main() that executes a binary command file
+void print_runtime_main(std::ofstream &cpp);
+
+// Generate a main() that executes many command files, one per lane
+void print_lanes_main(std::ofstream &cpp);
+
+// Generate the IlaState C API of -lib, and its header
+void print_lib_api(std::ofstream &cpp);
+void print_lib_header(std::string fileName);
+
+void collect_scalar_asvs(std::map<std::string, uint32_t> &varWidths);
+
+void declare_state_var(std::ofstream &cpp, const std::string& type,
+                       const std::string& name, const std::string& dims = "");
+
+// True in lane or library mode, where generated functions take the
+// lane or the IlaState they work on
+bool has_state_param();
+std::string state_param(bool comma = false);
+std::string state_arg(bool comma = false);
+
+// Encode the instruction list as a binary command file
+void write_command_file(const std::vector<InstEncoding_t> &instrList,
+                        std::string fileName, std::string layoutFileName);
+
+// Paged memory of -paged_mem
+void tb_mem_vals(std::vector<llvm::APInt>& vals);
+void write_mem_image(const std::vector<llvm::APInt>& vals, std::string fileName);
+void print_paged_mem(std::ofstream &cpp);
+void print_mem_options(std::ofstream &cpp);
+
+// Generate the binary trace writer of -trace
+void print_trace_writer(std::ofstream &cpp);
+
+// Generate the checkpoint save/restore functions, and the parsing of
+// their main() options
+void print_checkpoint_funcs(std::ofstream &cpp);
+void print_checkpoint_options(std::ofstream &cpp);
+
+// Instruction sequence profile of -profile, and the fused functions of -fuse
+void print_profile_funcs(std::ofstream &cpp);
+void read_instr_profile(std::string fileName);
+void print_fused_funcs(std::ofstream &cpp);
+
+// Generate the receiver of the mux counters of instrumented update functions
+void print_mux_profile_funcs(std::ofstream &cpp);
+
 // Make a C-clean name for a cycle-specific variable.  A cycle of 0 means non-cycle-specific
 std::string var_name_cycle_convert(const std::string& varName, int cycle);
@@ -18,36 +18,21 @@
 #include "llvm/IR/Type.h"
 #include "llvm/IR/Verifier.h"
 #include "llvm/IR/ValueSymbolTable.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/Transforms/Utils/ModuleUtils.h"
 
 #include <iostream>
-#include <unordered_set>
-#include <list>
-#include <set>
+#include <fstream>
+#include <sstream>
+#include <queue>
+#include <vector>
+#include <algorithm>
+#include <cstdint>
 
 
 namespace BranchMux {
 
 
-// A compare class that compares Instructions in the same BB by their ordering.
-struct InstrLess {
-  bool operator()(llvm::Instruction* const & a,
-                  llvm::Instruction* const & b) const;
-};
-
-// Does the opposite
-struct InstrMore {
-  bool operator()(llvm::Instruction* const & a,
-                  llvm::Instruction* const & b) const;
-};
-
-// A set with arbitrary ordering (std::unordered_set definitely faster than std::set).
-//typedef std::unordered_set<llvm::Instruction*> InstSet;
-typedef std::set<llvm::Instruction*, InstrLess> InstSet;
-
-// An ordered sortable list that we can efficiently add and remove elements from.
-// No obvious performance difference between std::list and std::deque.
-typedef std::list<llvm::Instruction*> InstList;
-
 std::string instrToString(const llvm::Instruction* inst)
 {
   std::string str;
@@ -68,128 +53,127 @@ llvm::Instruction *getUserInst(const llvm::Use& use)
 }
 
 
-// A compare function that compares Instructions in the same BB by the reverse of their ordering.
-// This lets us sort an Instruction list backwards, so that the first Instruction in the list
-// is last in the BB.
-bool InstrMore::operator()(llvm::Instruction* const& a,
-                           llvm::Instruction* const& b) const
-{
-  if (a == b) return false;
-
-  // Not really meant to be used for Instructions in different BBs.
-  // TODO: Compare actual BB ordering in Function, for full usefulness.
-  if (a->getParent() != b->getParent()) {
-    return a->getParent() < b->getParent();
-  }
-
-  return !a->comesBefore(b);
-}
 
+// Finds the fan-in cones of selects in one function.
+//
+// The instructions are numbered once, in order, so instructions in the
+// same BB compare by number instead of by comesBefore(), which renumbers
+// the whole BB after every split.  Splitting BBs and moving cones keeps the
+// relative order of the instructions, so the numbers stay valid while the
+// selects are converted.  Instructions created since then (the PHIs) have
+// no number and are never in a cone.  Cone and queue membership are
+// stamps indexed by number, so nothing has to be cleared between cones.
+class ConeFinder {
+public:
+  explicit ConeFinder(llvm::Function *func);
+
+  // The fan-in cone of the value of root, in BB order.  With a limit, it
+  // stops after that many instructions, when only the size matters.
+  void getFaninCone(const llvm::Use& root, std::vector<llvm::Instruction*>& cone,
+                    size_t limit = SIZE_MAX);
+
+  // Before an instruction is deleted, so a new one at its address is not
+  // taken for it
+  void forget(llvm::Instruction *inst) { m_number.erase(inst); }
+
+private:
+  // The number of an instruction of bb, or -1
+  int64_t number(const llvm::Value *val, const llvm::BasicBlock *bb) const;
+
+  llvm::DenseMap<const llvm::Instruction*, uint32_t> m_number;
+  std::vector<llvm::Instruction*> m_insts;
+  std::vector<uint32_t> m_inCone;  // Stamp of the cone an instruction is in
+  std::vector<uint32_t> m_queued;  // Stamp of the cone that queued it
+  uint32_t m_stamp = 0;
+};
 
 
-// A compare function that compares Instructions in the same BB by their ordering.
-// This lets us order an Instruction container forwards, so that the container
-// has the instructions in the same order as the BB.
-bool InstrLess::operator()(llvm::Instruction* const& a,
-                           llvm::Instruction* const& b) const
+ConeFinder::ConeFinder(llvm::Function *func)
 {
-  if (a == b) return false;
-
-  // Not really meant to be used for Instructions in different BBs.
-  // TODO: Compare actual BB ordering in Function, for full usefulness.
-  if (a->getParent() != b->getParent()) {
-    return a->getParent() < b->getParent();
+  for (auto& bb : func->getBasicBlockList()) {
+    for (auto& inst : bb) {
+      m_number[&inst] = m_insts.size();
+      m_insts.push_back(&inst);
+    }
   }
-
-  return a->comesBefore(b);
+  m_inCone.assign(m_insts.size(), 0);
+  m_queued.assign(m_insts.size(), 0);
 }
 
 
-
-// Uses a priority-queue-based BFS instead of recursive DFS.
-// No pruning needed.
-void getFaninCone(const llvm::Use& root, InstSet& cone)
+int64_t ConeFinder::number(const llvm::Value *val, const llvm::BasicBlock *bb) const
 {
-  llvm::Value *val = root.get(); // What is being used: An Instruction or a constant
+  const llvm::Instruction *inst = llvm::dyn_cast_or_null<llvm::Instruction>(val);
+  if (!inst || inst->getParent() != bb) return -1;
+  auto pos = m_number.find(inst);
+  return pos == m_number.end() ? -1 : pos->second;
+}
 
-  if (!val || !llvm::isa<llvm::Instruction>(val)) {
-    return;
-  }
 
-  llvm::Instruction *firstInst = llvm::cast<llvm::Instruction>(val);
+// Uses a priority-queue-based BFS instead of recursive DFS, latest
+// instruction first, so every instruction is decided after all its users.
+// No pruning needed.
+void ConeFinder::getFaninCone(const llvm::Use& root, std::vector<llvm::Instruction*>& cone,
+                              size_t limit)
+{
+  cone.clear();
   llvm::Instruction *rootInst = getUserInst(root);
   const llvm::BasicBlock *bb = rootInst->getParent();
-
-  //printf("start with root inst %p %s\n", rootInst, rootInst->getName().str().c_str());
-
-  // TODO: would unordered_set be faster?
-  std::set<llvm::Instruction*, InstrMore> pq;
-  pq.insert(firstInst);
-  //printf("pushed initial inst %p %s\n", firstInst, firstInst->getName().str().c_str());
-
-
-  while (!pq.empty()) {
-    auto iter = pq.begin();
-    llvm::Instruction *inst = *iter;
-    pq.erase(iter);
-
-    //printf("popped inst %p %s  size %lu\n", inst, inst->getName().str().c_str(), pq.size());
-
-    if (cone.count(inst) != 0) {
-      continue;  // Already seen this inst
-    }
-
-    if (inst->getParent() != bb) {
-      continue;  // inst in wrong BB.
+  m_stamp++;
+
+  std::priority_queue<uint32_t> pq;
+  auto push = [&](const llvm::Value *val) {
+    int64_t num = number(val, bb);  // Only instructions in the same BB
+    if (num >= 0 && m_queued[num] != m_stamp) {
+      m_queued[num] = m_stamp;
+      pq.push(num);
     }
+  };
+  push(root.get());
 
-    assert(inst->comesBefore(rootInst));
+  while (!pq.empty() && cone.size() < limit) {
+    uint32_t num = pq.top();
+    pq.pop();
+    llvm::Instruction *inst = m_insts[num];
+    assert(number(rootInst, bb) > num);
 
     // Look at every usage of this inst.  If it is used
     // by anything that cannot be in the cone, we must reject it.
     bool rejected = false;
     for (const llvm::Use& use : inst->uses()) {
-      llvm::Instruction *userInst = getUserInst(use);
-
-      if (userInst == rootInst && use == root) {
+      if (&use == &root) {
         continue;  // The usage by the correct input of the rootInst - ignore
       }
-
-      if (userInst->getParent() != bb) {
-        rejected = true;  // The inst is used by something in another bb.
+      int64_t userNum = number(getUserInst(use), bb);
+      if (userNum < 0 || m_inCone[userNum] != m_stamp) {
+        rejected = true;  // Used in another BB, or outside the cone.
         break;
       }
-
-      if (cone.count(userInst) == 0) {
-        //printf("inst %p %s used outside cone by %p %s\n", inst, inst->getName().str().c_str(),
-                //userInst, userInst->getName().str().c_str());
-        rejected = true;  // The inst is used by something outside the cone.
-        break;
-      }
-    }
-
-    if (rejected) {
-      //printf("rejected inst %p %s  size %lu\n", inst, inst->getName().str().c_str(), cone.size());
-      continue;
     }
+    if (rejected) continue;
 
-    //printf("added to cone inst %p %s  size %lu\n", inst, inst->getName().str().c_str(), cone.size());
-    cone.insert(inst);
+    m_inCone[num] = m_stamp;
+    cone.push_back(inst);
 
     for (const auto& faninUse : inst->operands()) {
-      llvm::Value* faninVal = faninUse.get();
-      if (faninVal && llvm::isa<llvm::Instruction>(faninVal)) {
-        llvm::Instruction *faninInst = llvm::cast<llvm::Instruction>(faninVal);
-        pq.insert(faninInst);
-        //printf("pushed inst %p %s  size %lu\n", faninInst, faninInst->getName().str().c_str(), pq.size());
-      }
+      push(faninUse.get());
     }
   }
+
+  // The instructions were found last to first
+  std::reverse(cone.begin(), cone.end());
 }
 
 
 
-bool convertSelectToBranch(llvm::SelectInst* select, int labelNum, int minSize)
+// The cost of a mispredicted branch, in instructions
+const double mispredictCost = 15;
+
+// With counts, the select is only converted if the profile says it pays off
+bool convertSelectToBranch(llvm::SelectInst* select, ConeFinder& finder, int labelNum,
+                           int minSize, const std::pair<uint64_t, uint64_t> *counts = nullptr,
+                           double minBias = 0, std::ostream *report = nullptr,
+                           int selectIdx = 0)
 {
   llvm::Value *condition = select->getCondition();
   if (!condition->getType()->isIntegerTy()) {
@@ -205,12 +189,22 @@ bool convertSelectToBranch(llvm::SelectInst* select, int labelNum, int minSize)
   // Start with the BB containing the select
   llvm::BasicBlock *bb = select->getParent();
 
-  InstSet trueFaninCone;
-  getFaninCone(select->getOperandUse(1), trueFaninCone);
+  // A select the profile never saw executed is not converted
+  uint64_t total = counts ? counts->first + counts->second : 0;
+  if (counts && total == 0) {
+    return false;
+  }
+
+  // Without a profile, only the size matters, so the cones are only
+  // collected up to the threshold, and completely if the select is converted.
+  size_t limit = counts ? SIZE_MAX : minSize;
+  std::vector<llvm::Instruction*> trueFaninCone;
+  finder.getFaninCone(select->getOperandUse(1), trueFaninCone, limit);
   size_t trueSize = trueFaninCone.size();
 
-  InstSet falseFaninCone;
-  getFaninCone(select->getOperandUse(2), falseFaninCone);
+  std::vector<llvm::Instruction*> falseFaninCone;
+  finder.getFaninCone(select->getOperandUse(2), falseFaninCone,
+                      limit - std::min(limit, trueSize));
   size_t falseSize = falseFaninCone.size();
 
   // Don't bother creating branches around a small number of instructions...
@@ -218,6 +212,26 @@ bool convertSelectToBranch(llvm::SelectInst* select, int labelNum, int minSize)
     return false;
   }
 
+  if (counts) {
+    // A select computes both cones, a branch only the taken one, but a
+    // branch that goes against the bias is mispredicted.
+    double trueRate = (double)counts->first / total;
+    double bias = std::max(trueRate, 1-trueRate);
+    double saved = falseSize*trueRate + trueSize*(1-trueRate) - (1-bias)*mispredictCost;
+    bool convert = bias >= minBias && saved > 0;
+    if (report) {
+      *report << select->getFunction()->getName().str() << " " << selectIdx
+              << " " << trueSize << " " << falseSize
+              << " " << counts->first << " " << counts->second
+              << " " << bias << " " << saved << " " << saved*total
+              << (convert ? " converted" : " kept") << std::endl;
+    }
+    if (!convert) return false;
+  } else {
+    finder.getFaninCone(select->getOperandUse(1), trueFaninCone);
+    finder.getFaninCone(select->getOperandUse(2), falseFaninCone);
+  }
+
   //printf("Processing select %d: true fanin %lu  false fanin %lu\n",
           //labelNum, trueSize, falseSize);
 
@@ -243,13 +257,13 @@ bool convertSelectToBranch(llvm::SelectInst* select, int labelNum, int minSize)
   llvm::IRBuilder<>(bb).CreateCondBr(condition, trueBB, falseBB);
 
   // Move all the True cone instructions into the True BB, in their existing order.
-  for (auto it = trueFaninCone.begin(); it != trueFaninCone.end(); ++it) {
-    (*it)->moveBefore(trueBB->getTerminator());
+  for (llvm::Instruction *inst : trueFaninCone) {
+    inst->moveBefore(trueBB->getTerminator());
   }
 
   // Move all the False cone instructions into the False BB, in their existing order.
-  for (auto it = falseFaninCone.begin(); it != falseFaninCone.end(); ++it) {
-    (*it)->moveBefore(falseBB->getTerminator());
+  for (llvm::Instruction *inst : falseFaninCone) {
+    inst->moveBefore(falseBB->getTerminator());
   }
 
 
@@ -267,6 +281,7 @@ bool convertSelectToBranch(llvm::SelectInst* select, int labelNum, int minSize)
 
   // Remember the select instruction's name (if any), then delete it
   llvm::StringRef selectName = select->getName();
+  finder.forget(select);
   select->eraseFromParent();
 
   // The new PHI instruction inherits the name of the deleted select instruction
@@ -277,29 +292,43 @@ bool convertSelectToBranch(llvm::SelectInst* select, int labelNum, int minSize)
 
 
 
-bool convertSelectsToBranches(llvm::Function *func, int threshold)
+// The selects of a function, in order.  The profile numbers them the same way.
+static std::vector<llvm::SelectInst*> gatherSelects(llvm::Function *func)
 {
-  std::list<llvm::SelectInst*> selects;
-  
-  // Gather the selects, in reverse order.
-  // We can't iterate directly over the contents of the BB
-  // since we are going to cut it apart.
+  std::vector<llvm::SelectInst*> selects;
   for (auto& bb : func->getBasicBlockList()) {
     for (auto& instr : bb.instructionsWithoutDebug()) {
       if (instr.getOpcode() == llvm::Instruction::Select) {
-        llvm::SelectInst& select = llvm::cast<llvm::SelectInst>(instr);
-        selects.push_front(&select);
+        selects.push_back(&llvm::cast<llvm::SelectInst>(instr));
       }
     }
   }
+  return selects;
+}
+
+
+
+bool convertSelectsToBranches(llvm::Function *func, int threshold,
+                              const SelectCounts *counts, double minBias,
+                              std::ostream *report)
+{
+  // Gather the selects first.
+  // We can't iterate directly over the contents of the BB
+  // since we are going to cut it apart.
+  std::vector<llvm::SelectInst*> selects = gatherSelects(func);
 
   // Convert them, starting from the end of the function and working backwards.
   // The backwards order is vital.
+  ConeFinder finder(func);
   int tot = 0;
   int n = 1;
-  for (llvm::SelectInst *select : selects) {
+  for (int idx = (int)selects.size()-1; idx >= 0; idx--) {
     tot++;
-    if (convertSelectToBranch(select, n, threshold)) {
+    // A select missing from the profile was never executed
+    std::pair<uint64_t, uint64_t> selectCounts(0, 0);
+    if (counts && idx < (int)counts->size()) selectCounts = (*counts)[idx];
+    if (convertSelectToBranch(selects[idx], finder, n, threshold, counts ? &selectCounts : nullptr,
+                              minBias, report, idx)) {
       n++;
     }
     fflush(stdout);
@@ -321,16 +350,113 @@ bool convertSelectsToBranches(llvm::Function *func, int threshold)
 }
 
 
-int convertSelectsToBranches(llvm::Module *mod, int threshold)
+int convertSelectsToBranches(llvm::Module *mod, int threshold,
+                             const MuxProfile *profile, double minBias,
+                             std::ostream *report)
 {
   int ret = 0;
 
   for (llvm::Function& func : (*mod)) {
-    ret += convertSelectsToBranches(&func, threshold);
+    const SelectCounts *counts = nullptr;
+    SelectCounts noCounts;  // The function was not profiled
+    if (profile) {
+      auto pos = profile->find(func.getName().str());
+      counts = (pos == profile->end()) ? &noCounts : &pos->second;
+    }
+    ret += convertSelectsToBranches(&func, threshold, counts, minBias, report);
   }
 
   return ret;
 }
 
 
+
+int instrumentSelects(llvm::Module *mod)
+{
+  llvm::LLVMContext& context = mod->getContext();
+  llvm::Type *i64Ty = llvm::Type::getInt64Ty(context);
+  llvm::PointerType *i64PtrTy = llvm::PointerType::getUnqual(i64Ty);
+
+  std::vector<llvm::Function*> funcs;
+  for (llvm::Function& func : (*mod)) {
+    if (!func.isDeclaration()) funcs.push_back(&func);
+  }
+
+  llvm::Function *ctor = nullptr;
+  llvm::FunctionCallee registerFunc;
+  int tot = 0;
+
+  for (llvm::Function *func : funcs) {
+    std::vector<llvm::SelectInst*> selects = gatherSelects(func);
+    if (selects.empty()) continue;
+
+    // Counter 2*i is for select i with a true condition, 2*i+1 for false
+    llvm::ArrayType *countsTy = llvm::ArrayType::get(i64Ty, 2*selects.size());
+    llvm::GlobalVariable *counts =
+      new llvm::GlobalVariable(*mod, countsTy, false, llvm::GlobalValue::InternalLinkage,
+                               llvm::ConstantAggregateZero::get(countsTy),
+                               func->getName()+"_mux_counts");
+
+    for (size_t i = 0; i < selects.size(); i++) {
+      llvm::SelectInst *select = selects[i];
+      if (!select->getCondition()->getType()->isIntegerTy()) {
+        continue;  // We don't support vectorized selects.
+      }
+      llvm::IRBuilder<> builder(select);
+      llvm::Value *idx = builder.CreateAdd(builder.getInt64(2*i),
+                           builder.CreateZExt(builder.CreateNot(select->getCondition()), i64Ty));
+      llvm::Value *ptr = builder.CreateInBoundsGEP(countsTy, counts, {builder.getInt64(0), idx});
+      builder.CreateStore(builder.CreateAdd(builder.CreateLoad(i64Ty, ptr), builder.getInt64(1)), ptr);
+      tot++;
+    }
+
+    if (!ctor) {
+      // void ila_mux_profile_register(const char *funcName, uint64_t *counts, uint32_t selectNum)
+      registerFunc = mod->getOrInsertFunction("ila_mux_profile_register",
+                                              llvm::Type::getVoidTy(context),
+                                              llvm::Type::getInt8PtrTy(context),
+                                              i64PtrTy, llvm::Type::getInt32Ty(context));
+      ctor = llvm::Function::Create(llvm::FunctionType::get(llvm::Type::getVoidTy(context), false),
+                                    llvm::GlobalValue::InternalLinkage, "mux_profile_init", mod);
+      llvm::BasicBlock::Create(context, "entry", ctor);
+    }
+    llvm::IRBuilder<> ctorBuilder(&ctor->getEntryBlock());
+    ctorBuilder.CreateCall(registerFunc, {ctorBuilder.CreateGlobalStringPtr(func->getName()),
+                                          ctorBuilder.CreatePointerCast(counts, i64PtrTy),
+                                          ctorBuilder.getInt32(selects.size())});
+  }
+
+  if (ctor) {
+    llvm::IRBuilder<>(&ctor->getEntryBlock()).CreateRetVoid();
+    llvm::appendToGlobalCtors(*mod, ctor, 65535);
+  }
+
+  printf("Instrumented %d muxes\n", tot);
+  return tot;
+}
+
+
+
+bool readMuxProfile(const std::string& fileName, MuxProfile& profile)
+{
+  std::ifstream input(fileName);
+  if (!input.is_open()) return false;
+
+  std::string line;
+  while (std::getline(input, line)) {
+    std::istringstream ss(line);
+    std::string funcName;
+    size_t idx;
+    uint64_t trueCount, falseCount;
+    if (!(ss >> funcName >> idx >> trueCount >> falseCount)) continue;
+
+    SelectCounts& counts = profile[funcName];
+    if (counts.size() <= idx) counts.resize(idx+1, {0, 0});
+    counts[idx].first += trueCount;
+    counts[idx].second += falseCount;
+  }
+  return true;
+}
+
+
 };
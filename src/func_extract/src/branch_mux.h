@@ -12,10 +12,40 @@
 #include "llvm/IR/PassManager.h"
 
 
+#include <map>
+#include <vector>
+#include <string>
+#include <ostream>
+
+
 namespace BranchMux {
 
-  bool convertSelectsToBranches(llvm::Function *func, int threshold);
-  int convertSelectsToBranches(llvm::Module *mod, int threshold);
+  // The true and false counts of every select of a function, in the
+  // order of the function, and the counts of all profiled functions
+  typedef std::vector<std::pair<uint64_t, uint64_t>> SelectCounts;
+  typedef std::map<std::string, SelectCounts> MuxProfile;
+
+  // Without a profile, a select is converted if its fan-in cones have at
+  // least threshold instructions.  With a profile, it is converted only if
+  // its condition is also true or false in at least minBias of the runs,
+  // and the instructions it saves are worth the mispredictions.  Every
+  // decision on an executed select of that size is written to report.
+  bool convertSelectsToBranches(llvm::Function *func, int threshold,
+                                const SelectCounts *counts = nullptr,
+                                double minBias = 0.9, std::ostream *report = nullptr);
+  int convertSelectsToBranches(llvm::Module *mod, int threshold,
+                               const MuxProfile *profile = nullptr,
+                               double minBias = 0.9, std::ostream *report = nullptr);
+
+  // Count how often the condition of every select is true and false.
+  // A module constructor registers the counters with
+  // ila_mux_profile_register(), which a simulator of sim_gen -mux_profile
+  // defines, and which writes them to mux_profile.txt at exit.
+  int instrumentSelects(llvm::Module *mod);
+
+  // Read mux_profile.txt.  Lines: <function> <select> <true count> <false count>
+  // The counts of repeated lines are added up.
+  bool readMuxProfile(const std::string& fileName, MuxProfile& profile);
 
 };
 
@@ -0,0 +1,205 @@
+#include "decode_tree.h"
+#include "llvm/ADT/StringExtras.h"
+
+#include <sstream>
+#include <algorithm>
+#include <cassert>
+
+#define toStr(a) std::to_string(a)
+
+namespace funcExtract {
+
+
+static std::string hex_literal(uint64_t val) {
+  std::ostringstream ss;
+  ss << "0x" << std::hex << val;
+  return ss.str();
+}
+
+
+void DecodeTree::build(const std::vector<DecodePattern_t>& patterns,
+                       uint32_t maxFieldWidth) {
+  m_width = 1;
+  for (const auto& pat : patterns)
+    m_width = std::max(m_width, pat.value.getBitWidth());
+  m_maxFieldWidth = maxFieldWidth;
+
+  m_patterns.clear();
+  m_nodes.clear();
+  m_memo.clear();
+  std::vector<uint32_t> cands;
+  for (const auto& pat : patterns) {
+    DecodePattern_t p = {fit(pat.value), fit(pat.mask), pat.instrIdx};
+    p.value &= p.mask;
+    cands.push_back(m_patterns.size());
+    m_patterns.push_back(p);
+  }
+  m_root = build_node(cands, llvm::APInt(m_width, 0));
+}
+
+
+// Pick the field that splits the candidates best:
+// 1. the widest run of bits that every candidate specifies, and that are
+//    not the same in all of them (the opcode-like fields), or else
+// 2. the single bit specified by the most candidates.  The candidates
+//    that do not care about the bit go down both branches.
+// A node with a single candidate, or whose first candidate is already
+// fully tested, becomes a leaf.
+int DecodeTree::build_node(const std::vector<uint32_t>& cands,
+                           const llvm::APInt& tested) {
+  if (cands.empty()) return -1;
+
+  std::string key = llvm::toString(tested, 16, false);
+  for (uint32_t c : cands) key += " "+toStr(c);
+  auto memoIt = m_memo.find(key);
+  if (memoIt != m_memo.end()) return memoIt->second;
+
+  uint32_t n = cands.size();
+  std::vector<bool> full(m_width, false), disc(m_width, false);
+  std::vector<uint32_t> specified(m_width, 0);
+  bool firstDone = (m_patterns[cands[0]].mask & ~tested).isZero();
+  if (n > 1 && !firstDone) {
+    for (uint32_t b = 0; b < m_width; b++) {
+      if (tested[b]) continue;
+      uint32_t ones = 0;
+      for (uint32_t c : cands) {
+        if (!m_patterns[c].mask[b]) continue;
+        specified[b]++;
+        if (m_patterns[c].value[b]) ones++;
+      }
+      full[b] = (specified[b] == n);
+      disc[b] = specified[b] > 0 && !(full[b] && (ones == 0 || ones == n));
+    }
+  }
+
+  uint32_t lo = 0, fieldWidth = 0, bestDisc = 0;
+  for (uint32_t b = 0; b < m_width; ) {
+    if (!full[b]) { b++; continue; }
+    uint32_t end = b;
+    while (end < m_width && full[end]) end++;
+    // In a long run, take the window with the most discriminating bits
+    uint32_t w = std::min(end-b, m_maxFieldWidth);
+    for (uint32_t s = b; s+w <= end; s++) {
+      uint32_t d = std::count(disc.begin()+s, disc.begin()+s+w, true);
+      if (d > bestDisc) {
+        bestDisc = d;
+        lo = s;
+        fieldWidth = w;
+      }
+    }
+    b = end;
+  }
+  if (fieldWidth == 0) {
+    uint32_t bestSpecified = 0;
+    for (uint32_t b = 0; b < m_width; b++) {
+      if (disc[b] && specified[b] > bestSpecified) {
+        bestSpecified = specified[b];
+        lo = b;
+        fieldWidth = 1;
+      }
+    }
+  }
+
+  Node_t node;
+  if (fieldWidth == 0) {
+    node.cands = cands;
+    for (uint32_t c : cands) {
+      node.residualMasks.push_back(m_patterns[c].mask & ~tested);
+      // Nothing after a pattern that surely matches can be reached
+      if (node.residualMasks.back().isZero()) {
+        node.cands.resize(node.residualMasks.size());
+        break;
+      }
+    }
+  } else {
+    node.lo = lo;
+    node.fieldWidth = fieldWidth;
+    llvm::APInt fieldMask = llvm::APInt::getBitsSet(m_width, lo, lo+fieldWidth);
+    llvm::APInt childTested = tested | fieldMask;
+    for (uint64_t v = 0; v < (1ull << fieldWidth); v++) {
+      llvm::APInt fieldVal = llvm::APInt(m_width, v) << lo;
+      std::vector<uint32_t> childCands;
+      for (uint32_t c : cands) {
+        const DecodePattern_t& pat = m_patterns[c];
+        llvm::APInt m = pat.mask & fieldMask;
+        if ((fieldVal & m) == (pat.value & m)) childCands.push_back(c);
+      }
+      node.children.push_back(build_node(childCands, childTested));
+    }
+  }
+
+  int idx = m_nodes.size();
+  m_nodes.push_back(node);
+  m_memo.emplace(key, idx);
+  return idx;
+}
+
+
+const std::vector<uint32_t>& DecodeTree::candidates(const llvm::APInt& val) const {
+  static const std::vector<uint32_t> none;
+  llvm::APInt v = fit(val);
+  int nodeIdx = m_root;
+  while (nodeIdx >= 0 && m_nodes[nodeIdx].fieldWidth > 0) {
+    const Node_t& node = m_nodes[nodeIdx];
+    nodeIdx = node.children[v.extractBitsAsZExtValue(node.fieldWidth, node.lo)];
+  }
+  return nodeIdx < 0 ? none : m_nodes[nodeIdx].cands;
+}
+
+
+uint32_t DecodeTree::lookup(const llvm::APInt& val) const {
+  llvm::APInt v = fit(val);
+  for (uint32_t c : candidates(val)) {
+    const DecodePattern_t& pat = m_patterns[c];
+    if ((v & pat.mask) == pat.value) return pat.instrIdx;
+  }
+  return NO_INSTR;
+}
+
+
+void DecodeTree::print_c(std::ostream& out, const std::string& varName,
+                         const std::string& indent) const {
+  assert(m_width <= 64);
+  print_node(out, m_root, varName, indent);
+}
+
+
+void DecodeTree::print_node(std::ostream& out, int nodeIdx, const std::string& varName,
+                            const std::string& indent) const {
+  if (nodeIdx < 0) return;
+  const Node_t& node = m_nodes[nodeIdx];
+
+  if (node.fieldWidth == 0) {
+    for (uint32_t i = 0; i < node.cands.size(); i++) {
+      const DecodePattern_t& pat = m_patterns[node.cands[i]];
+      uint64_t mask = node.residualMasks[i].getZExtValue();
+      if (mask == 0) {
+        out << indent << "return " << pat.instrIdx << ";" << std::endl;
+      } else {
+        uint64_t val = pat.value.getZExtValue() & mask;
+        out << indent << "if ((" << varName << " & " << hex_literal(mask) << ") == "
+            << hex_literal(val) << ") return " << pat.instrIdx << ";" << std::endl;
+      }
+    }
+    return;
+  }
+
+  uint64_t fieldMask = (1ull << node.fieldWidth) - 1;
+  out << indent << "switch ((" << varName << " >> " << node.lo << ") & "
+      << hex_literal(fieldMask) << ") {" << std::endl;
+  // Values that lead to the same child share one case body
+  std::vector<bool> done(node.children.size(), false);
+  for (uint32_t v = 0; v < node.children.size(); v++) {
+    if (done[v] || node.children[v] < 0) continue;
+    for (uint32_t u = v; u < node.children.size(); u++) {
+      if (node.children[u] != node.children[v]) continue;
+      done[u] = true;
+      out << indent << "  case " << hex_literal(u) << ":" << std::endl;
+    }
+    print_node(out, node.children[v], varName, indent+"    ");
+    out << indent << "    break;" << std::endl;
+  }
+  out << indent << "}" << std::endl;
+}
+
+} // end of namespace funcExtract
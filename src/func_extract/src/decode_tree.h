@@ -0,0 +1,73 @@
+#ifndef FUNC_EXTRACT_DECODE_TREE_H
+#define FUNC_EXTRACT_DECODE_TREE_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <ostream>
+#include <cstdint>
+#include "llvm/ADT/APInt.h"
+
+namespace funcExtract {
+
+// An instruction matches a value v if (v & mask) == value.
+// When several patterns match, the one added first wins, just like
+// a chain of if/else tests.
+struct DecodePattern_t {
+  llvm::APInt value;
+  llvm::APInt mask;
+  uint32_t instrIdx;
+};
+
+
+// Decision tree over the bit fields that discriminate the patterns.
+// Every inner node switches on one field of up to maxFieldWidth bits,
+// and every leaf holds the few patterns left, with the bits that still
+// have to be compared.
+class DecodeTree {
+public:
+  static constexpr uint32_t NO_INSTR = UINT32_MAX;
+
+  // All patterns are zero-extended to the widest one
+  void build(const std::vector<DecodePattern_t>& patterns,
+             uint32_t maxFieldWidth = 8);
+
+  uint32_t width() const { return m_width; }
+  const DecodePattern_t& pattern(uint32_t i) const { return m_patterns[i]; }
+
+  // Indices of the patterns that may match val, in priority order.  Only
+  // the bits tested on the way to the leaf are known to match.
+  const std::vector<uint32_t>& candidates(const llvm::APInt& val) const;
+
+  // instrIdx of the first pattern that matches val, NO_INSTR if no one does
+  uint32_t lookup(const llvm::APInt& val) const;
+
+  // Emit C statements that return the instrIdx decoded from varName,
+  // a C integer of at most 64 bits.  Falls through if nothing matches.
+  void print_c(std::ostream& out, const std::string& varName,
+               const std::string& indent) const;
+
+private:
+  struct Node_t {
+    uint32_t lo = 0;      // Inner node: switch on bits [lo, lo+fieldWidth)
+    uint32_t fieldWidth = 0;  // 0 for a leaf
+    std::vector<int> children;  // -1: no pattern can match
+    std::vector<uint32_t> cands;  // Leaf: pattern indices
+    std::vector<llvm::APInt> residualMasks;  // Leaf: bits not yet tested
+  };
+
+  int build_node(const std::vector<uint32_t>& cands, const llvm::APInt& tested);
+  void print_node(std::ostream& out, int nodeIdx, const std::string& varName,
+                  const std::string& indent) const;
+  llvm::APInt fit(const llvm::APInt& val) const { return val.zextOrTrunc(m_width); }
+
+  std::vector<DecodePattern_t> m_patterns;
+  std::vector<Node_t> m_nodes;
+  std::map<std::string, int> m_memo;  // Candidates and tested bits -> node
+  uint32_t m_width = 1;
+  uint32_t m_maxFieldWidth = 8;
+  int m_root = -1;
+};
+
+} // end of namespace funcExtract
+#endif
@@ -398,7 +398,7 @@ void nb_expr(std::string line) {
 }
 
 
-void always_expr(std::string line, std::ifstream &input) {
+void always_expr(std::string line, LineReader &input) {
   std::smatch m;
   if( !std::regex_match(line, m, pAlwaysClk) ) {
     std::cout << "!! Error in parsing always with clk & rst !!" << std::endl;
@@ -406,7 +406,7 @@ void always_expr(std::string line, std::ifstream &input) {
   }
   g_recentClk = m.str(2);
   // parse first assignment
-  std::getline(input, line);
+  input.getline(line);
   if(line.find("if (_127_)") != std::string::npos) 
     toCoutVerb("Find it!");
   if( std::regex_match(line, m, pNonblock) || std::regex_match(line, m, pNonblockConcat) ) {
@@ -456,7 +456,7 @@ void mem_if_assign_expr(std::string line) {
 //  else if(cond2) var <= data2; (optional)
 // first returned is the destName, the second returned is index for yuzeng
 std::pair<std::string, std::string> nonblockif_expr(std::string line, 
-                                                    std::ifstream &input,
+                                                    LineReader &input,
                                                     bool insertNBTable) {
   std::smatch m;
   if ( !std::regex_match(line, m, pNonblockIf) ) {
@@ -508,7 +508,7 @@ std::pair<std::string, std::string> nonblockif_expr(std::string line,
   std::string elseValue;
   // need to check if there is "else" statement
   auto endOfIf = input.tellg();
-  std::getline(input, line);
+  input.getline(line);
   if( !std::regex_match(line, m, pNBElseIf) ) {
     if(line.find("else if") != std::string::npos) {
       toCout("Error: unexpected else if: "+line);
@@ -597,7 +597,7 @@ std::pair<std::string, std::string> nonblockif_expr(std::string line,
 //  if (cond) var <= data1;
 //  else var <= data2; (optional)
 //  else if(cond2) var <= data2; (optional)
-void if_expr(std::string line, std::ifstream &input) {
+void if_expr(std::string line, LineReader &input) {
   std::smatch m;
   if ( !std::regex_match(line, m, pIf) )
     return;
@@ -606,7 +606,7 @@ void if_expr(std::string line, std::ifstream &input) {
 
   auto endOfIf = input.tellg();
   std::string nextLine;
-  std::getline(input, nextLine);
+  input.getline(nextLine);
   // if the next line is directly nonblocking, then switch to always_if_else_expr
   if( std::regex_match(nextLine, m, pNonblock) ) {
     input.seekg(endOfIf);
@@ -651,25 +651,25 @@ void if_expr(std::string line, std::ifstream &input) {
 }
 
 
-void always_clkrst_expr(std::string line, std::ifstream &input) {
+void always_clkrst_expr(std::string line, LineReader &input) {
   std::smatch m;
   if ( !std::regex_match(line, m, pAlwaysClkRst) )
     return;
 
   // read lines of if...else...
-  std::getline(input, line);
+  input.getline(line);
   always_if_else_expr(line, input);
 }
 
 
-void always_if_else_expr(std::string line, std::ifstream &input) {
+void always_if_else_expr(std::string line, LineReader &input) {
   std::smatch m;  
   if ( !std::regex_match(line, m, pIf) )
     return;
   std::string condAndSlice = m.str(2);
   const auto curMod = g_insContextStk.get_curMod();
 
-  std::getline(input, line);
+  input.getline(line);
   if ( !std::regex_match(line, m, pNonblock) ) {
     toCout("Error in matching if else: "+line);
     abort();
@@ -684,13 +684,13 @@ void always_if_else_expr(std::string line, std::ifstream &input) {
   uint32_t destWidth = g_insContextStk.get_var_slice_width_simp(dest);
   g_allRegs.emplace(dest, destWidth);
 
-  std::getline(input, line);
+  input.getline(line);
   if ( !std::regex_match(line, m, pElse) ) {
     toCout("Error in matching if else: "+line);
     abort();
   }
 
-  std::getline(input, line);
+  input.getline(line);
   if ( !std::regex_match(line, m, pNonblock) ) {
     toCout("Error in matching if else: "+line);
     abort();
@@ -725,10 +725,10 @@ void always_if_else_expr(std::string line, std::ifstream &input) {
 }
 
 
-void case_expr(std::string line, std::ifstream &input) {
+void case_expr(std::string line, LineReader &input) {
   std::smatch m;
   std::string caseFirstLine;
-  std::getline(input, caseFirstLine);
+  input.getline(caseFirstLine);
   if ( !std::regex_match(caseFirstLine, m, pCase) ) {
     toCout("Error: does not match pCase: "+caseFirstLine);
     abort();
@@ -746,7 +746,7 @@ void case_expr(std::string line, std::ifstream &input) {
 
 /// In this function, do not distinguish input and output ports
 /// store all connections in both two maps: wire2InsPortMp & insPort2wireMp
-void submodule_expr(std::string firstLine, std::ifstream &input) {
+void submodule_expr(std::string firstLine, LineReader &input) {
   const auto curMod = g_insContextStk.get_curMod();
   std::smatch m;
   if ( !std::regex_match(firstLine, m, pInstanceBegin) ) {
@@ -779,7 +779,7 @@ void submodule_expr(std::string firstLine, std::ifstream &input) {
   std::string line;
   std::map<std::string, std::string> wire2PortMp;
   std::vector<std::string> portVec;
-  while(std::getline(input, line) && !std::regex_match(line, m, pInstanceEnd)) {
+  while(input.getline(line) && !std::regex_match(line, m, pInstanceEnd)) {
     if(is_comment_line(line))
       continue;
     if(!std::regex_match(line, m, pInstancePort)) {
@@ -810,11 +810,11 @@ void submodule_expr(std::string firstLine, std::ifstream &input) {
 }
 
      
-void switch_expr(std::ifstream &input) {
+void switch_expr(LineReader &input) {
   const auto curMod = g_insContextStk.get_curMod();
 
   std::string alwaysLine;
-  std::getline(input, alwaysLine);
+  input.getline(alwaysLine);
   if(alwaysLine.find("always @(posedge") == std::string::npos
       && alwaysLine.find("always @ (posedge") == std::string::npos ) {
     toCout("Error: not expected always line: "+alwaysLine);
@@ -822,7 +822,7 @@ void switch_expr(std::ifstream &input) {
   }
 
   std::string caseLine;
-  std::getline(input, caseLine);
+  input.getline(caseLine);
   if(caseLine.find("case") == std::string::npos) {
     toCout("Error: not expected case line: "+caseLine);
     abort();
@@ -835,7 +835,7 @@ void switch_expr(std::ifstream &input) {
   std::string switchVar = m.str(3);
 
   std::string assignLine;
-  std::getline(input, assignLine);
+  input.getline(assignLine);
   std::string destVar;
   std::vector<std::pair<std::string, std::string>> assignVec;
   bool isFirst = true;
@@ -864,7 +864,7 @@ void switch_expr(std::ifstream &input) {
       abort();
     }
     lastSwitchValue = switchNum;
-    std::getline(input, assignLine);    
+    input.getline(assignLine);    
   }
 
   if(curMod->switchTable.find(destVar) != curMod->switchTable.end()) {
@@ -38,23 +38,23 @@ void dest_concat_expr(std::string line);
 
 void nb_expr(std::string line);
 
-void always_expr(std::string line, std::ifstream &input);
+void always_expr(std::string line, taintGen::LineReader &input);
 
 std::pair<std::string, std::string> nonblockif_expr(std::string line, 
-                                                    std::ifstream &input,
+                                                    taintGen::LineReader &input,
                                                     bool insertNBTable=true);
 
-void if_expr(std::string line, std::ifstream &input);
+void if_expr(std::string line, taintGen::LineReader &input);
 
-void always_clkrst_expr(std::string line, std::ifstream &input);
+void always_clkrst_expr(std::string line, taintGen::LineReader &input);
 
-void always_if_else_expr(std::string line, std::ifstream &input);
+void always_if_else_expr(std::string line, taintGen::LineReader &input);
 
-void case_expr(std::string line, std::ifstream &input);
+void case_expr(std::string line, taintGen::LineReader &input);
 
-void switch_expr(std::ifstream &input);
+void switch_expr(taintGen::LineReader &input);
 
-void submodule_expr(std::string line, std::ifstream &input);
+void submodule_expr(std::string line, taintGen::LineReader &input);
 
 void put_into_reg2Slice(std::string destAndSlice);
 
@@ -93,11 +93,23 @@ void FuncExtractFlow::get_all_update() {
     m_workSet.mtxClear();
   }
 
+  if (g_post_opto_mux_to_branch && !g_post_opto_mux_profile
+      && !g_post_opto_mux_profile_file.empty()) {
+    m_hasMuxProfile = BranchMux::readMuxProfile(g_path+"/"+g_post_opto_mux_profile_file, m_muxProfile);
+    if (m_hasMuxProfile) {
+      std::ofstream report(g_path+"/mux_to_branch_report.txt");
+      report << "# <function> <select> <true cone> <false cone> <true count> <false count>"
+                " <bias> <saved instructions per run> <saved in the profile> <decision>" << std::endl;
+    } else {
+      toCout("Warning: cannot read "+g_post_opto_mux_profile_file+", muxes are converted by cone size only");
+    }
+  }
+
+  if (g_discover_delay_bounds) read_delay_bounds(g_path+"/delay_bounds.txt");
+
   // declaration for llvm
   std::ofstream funcInfo(g_path+"/func_info.txt");
   std::ofstream asvInfo(g_path+"/asv_info.txt");
-  //std::vector<std::string> m_fileNameVec;
-  struct ThreadSafeVector_t m_fileNameVec;
   std::vector<std::thread> threadVec;
 
   if(!g_use_multi_thread && m_innerLoopIsInstrs) {
@@ -214,7 +226,16 @@ void FuncExtractFlow::get_all_update() {
     } // end of while loop
   }
 
+  if (g_discover_delay_bounds) print_delay_bounds(g_path+"/delay_bounds.txt");
+  if (g_dedup_update_functions) dedup_update_functions();
+  for (auto it = m_fileNameVec.begin(); it != m_fileNameVec.end(); it++) {
+    if (!m_mergedFiles.count(*it)) m_linkFiles.push_back(*it);
+  }
+  if (!g_combine_llvm_modules.empty()) combine_llvm_modules();
+
   print_llvm_script(g_path+"/link.sh");
+  print_llvm_script(g_path+"/link_lib.sh", true);
+  print_make_file(g_path+"/ila.mk");
   print_func_info(funcInfo);
   print_asv_info(asvInfo);
 }
@@ -227,6 +248,111 @@ FuncExtractFlow::get_update_function(std::string target,
                                          InstrInfo_t instrInfo,
                                          uint32_t instrIdx) {
 
+  std::string instrName = instrInfo.name;
+  m_dependVarMapMtx.lock();
+  if(m_dependVarMap.find(instrName) == m_dependVarMap.end())
+    m_dependVarMap.emplace( instrName, std::map<std::string, ArgVec_t>());
+  m_dependVarMapMtx.unlock();
+
+  // Search for a smaller delay bound, unless allowed_target.txt asks for
+  // several of them, or an earlier run has found it.
+  bool searchBound = false;
+  if (g_discover_delay_bounds) {
+    auto tgtPos = g_allowedTgt.find(target);
+    searchBound = (tgtPos == g_allowedTgt.end() || tgtPos->second.size() <= 1);
+    std::lock_guard<std::mutex> lock(m_delayBoundMtx);
+    auto pos = m_discoveredBounds.find(std::make_pair(instrName, target));
+    if (searchBound && pos != m_discoveredBounds.end() && pos->second.first == delayBound) {
+      toCout("Using the discovered delay bound "+toStr(pos->second.second)+" for instr "
+             +instrName+", target "+target);
+      delayBound = pos->second.second;
+      searchBound = false;
+    }
+  }
+
+  std::string llvmFileName;
+  std::string wrapperFuncName;
+  ArgVec_t argVec;
+  bool usefulFunc = make_update_function(target, delayBound, isVec, instrInfo, instrIdx,
+                                         llvmFileName, wrapperFuncName, argVec);
+
+  if (usefulFunc && searchBound) {
+    uint32_t minBound = discover_delay_bound(target, delayBound, isVec, instrInfo, instrIdx,
+                                             llvmFileName, wrapperFuncName, argVec);
+    std::lock_guard<std::mutex> lock(m_delayBoundMtx);
+    m_discoveredBounds[std::make_pair(instrName, target)] = std::make_pair(delayBound, minBound);
+  }
+
+  if(usefulFunc) {
+    m_fileNameVec.push_back(llvmFileName);        
+    toCout("----- For instr "+instrInfo.name+", "+target+" is affected!");
+    m_dependVarMapMtx.lock();
+    if(m_dependVarMap[instrName].find(target) == m_dependVarMap[instrName].end()) {
+      m_dependVarMap[instrName].emplace(target, argVec);
+      m_funcFiles.emplace(std::make_pair(instrName, target),
+                          std::make_pair(llvmFileName, wrapperFuncName));
+    }
+    else {
+      toCout("Warning: for instruction "+instrInfo.name+", target: "+target+" is seen before");
+      //abort();
+    }
+    m_dependVarMapMtx.unlock();
+  }
+  else {
+    toCout("----- For instr "+instrInfo.name+", "+target+" is NOT affected!");
+  }
+
+  for(auto arg : argVec) {
+    std::string reg = arg.name;
+    int cycle = arg.cycle;
+    uint32_t width = std::abs(arg.width);  // For pointers, we want the pointee width.
+
+    // The simulator reads a symbolic field from its input signal
+    if (const InstrField_t *field = find_field_arg(instrInfo, reg)) {
+      reg = field->signal;
+      cycle = field->cycle;
+      width = m_info.get_var_width_simp(reg);
+    }
+
+    if(g_push_new_target && !m_visitedTgt.mtxExist(reg)) {
+      m_workSet.mtxInsert(reg);
+    }
+
+    // Add any discovered registers that had not already been identified as ASVs
+    // or register arrays.
+    // Ignore any special non-ASV/non-register function args, indicated by a 
+    // reserved name (those go in func_info.txt).
+    // And skip args already known to be in a register array.
+    if (!is_special_arg_name(reg) && g_allowedTgt.count(reg) == 0 &&
+        g_allowedTgtVec.count(reg) == 0 &&
+        get_vector_of_target(reg, nullptr).empty()) {
+      // If we have a specific clock cycle, we may need to update an existing entry in m_asvSet
+      if(!m_asvSet.contains(reg)) {
+        m_asvSet.emplace(reg, {width});
+      } 
+      WidthCycles_t& data = m_asvSet.at(reg);  // Possibly fetch what we just inserted.
+      assert(data.width == width);  // Check for inconsistent bitwidth
+      if (cycle > 0) {
+        data.cycles.insert(cycle);  // Cycles will be empty if no specific cycle is used.
+      }
+    }
+  }
+}
+
+
+// Generate and optimize the update function of the target for the delay
+// bound, and add its wrapper function.  Return false if the target is
+// not affected by the instruction.
+bool
+FuncExtractFlow::make_update_function(std::string target,
+                                      uint32_t delayBound,
+                                      bool isVec,
+                                      const InstrInfo_t& instrInfo,
+                                      uint32_t instrIdx,
+                                      std::string& llvmFileName,
+                                      std::string& wrapperFuncName,
+                                      ArgVec_t& argVec) {
+
   std::shared_ptr<UFGenerator> UFGen = m_genFactory.makeGenerator();
 
   time_t startTime = time(NULL);
@@ -308,11 +434,6 @@ FuncExtractFlow::get_update_function(std::string target,
   }
 
 
-  std::string instrName = instrInfo.name;
-  m_dependVarMapMtx.lock();
-  if(m_dependVarMap.find(instrName) == m_dependVarMap.end())
-    m_dependVarMap.emplace( instrName, std::map<std::string, ArgVec_t>());
-  m_dependVarMapMtx.unlock();
   g_currInstrInfo = instrInfo;
   destInfo.set_instr_name(instrInfo.name);      
   assert(!instrInfo.name.empty());
@@ -325,7 +446,7 @@ FuncExtractFlow::get_update_function(std::string target,
   std::string cleanOptoFileName = fileName+".clean-o3-ll";
   std::string rewriteFileName = fileName + ".rewrite-ll";
   std::string reoptFileName = fileName + ".reopt-ll";
-  std::string llvmFileName = fileName+".ll";
+  llvmFileName = fileName+".ll";
 
   toCout("---  BEGIN INSTRUCTION #"+toStr(instrIdx)+": "+instrInfo.name+
          "  ASV: "+destSimpleName+"  delay bound: "+toStr(delayBound)+" ---");
@@ -388,10 +509,8 @@ FuncExtractFlow::get_update_function(std::string target,
     m_TimeFileMtx.unlock();
   }
 
-  ArgVec_t argVec;
   bool usefulFunc = false;
 
-
   // Load in the optimized LLVM file
   llvm::SMDiagnostic Err;
   llvm::LLVMContext Context;
@@ -407,13 +526,24 @@ FuncExtractFlow::get_update_function(std::string target,
     usefulFunc = clean_main_func(*M, funcName);
     if (usefulFunc) {
 
-      if (g_post_opto_mux_to_branch) {
+      if (g_post_opto_mux_profile) {
+        // An instrumentation build, for a simulator of sim_gen -mux_profile
+        toCout("Instrumenting muxes...");
+        BranchMux::instrumentSelects(M.get());
+      } else if (g_post_opto_mux_to_branch && m_hasMuxProfile) {
+        toCout("Converting muxes to branches with the mux profile...");
+        std::ostringstream report;
+        BranchMux::convertSelectsToBranches(M.get(), g_post_opto_mux_to_branch_threshold,
+                                            &m_muxProfile, g_post_opto_mux_to_branch_bias, &report);
+        std::lock_guard<std::mutex> lock(m_muxReportMtx);
+        std::ofstream(g_path+"/mux_to_branch_report.txt", std::ios::app) << report.str();
+      } else if (g_post_opto_mux_to_branch) {
         toCout("Converting muxes to branches...");
         BranchMux::convertSelectsToBranches(M.get(), g_post_opto_mux_to_branch_threshold);
       }
       
       // Add a C-compatible wrapper function that calls the main function.
-      std::string wrapperFuncName = create_wrapper_func(*M, funcName);
+      wrapperFuncName = create_wrapper_func(*M, funcName, instrInfo, delayBound);
 
       // Annotate the standard x86-64 Clang data layout to the module,
       // to prevent warnings when linking to C/C++ code.
@@ -439,50 +569,7 @@ FuncExtractFlow::get_update_function(std::string target,
     }
   }
 
-  if(usefulFunc) {
-    m_fileNameVec.push_back(llvmFileName);        
-    toCout("----- For instr "+instrInfo.name+", "+target+" is affected!");
-    m_dependVarMapMtx.lock();
-    if(m_dependVarMap[instrName].find(target) == m_dependVarMap[instrName].end())
-      m_dependVarMap[instrName].emplace(target, argVec);
-    else {
-      toCout("Warning: for instruction "+instrInfo.name+", target: "+target+" is seen before");
-      //abort();
-    }
-    m_dependVarMapMtx.unlock();
-  }
-  else {
-    toCout("----- For instr "+instrInfo.name+", "+target+" is NOT affected!");
-  }
-
-  for(auto arg : argVec) {
-    std::string reg = arg.name;
-    int cycle = arg.cycle;
-    if(g_push_new_target && !m_visitedTgt.mtxExist(reg)) {
-      m_workSet.mtxInsert(reg);
-    }
-
-    uint32_t width = std::abs(arg.width);  // For pointers, we want the pointee width.
-
-    // Add any discovered registers that had not already been identified as ASVs
-    // or register arrays.
-    // Ignore any special non-ASV/non-register function args, indicated by a 
-    // reserved name (those go in func_info.txt).
-    // And skip args already known to be in a register array.
-    if (!is_special_arg_name(reg) && g_allowedTgt.count(reg) == 0 &&
-        g_allowedTgtVec.count(reg) == 0 &&
-        get_vector_of_target(reg, nullptr).empty()) {
-      // If we have a specific clock cycle, we may need to update an existing entry in m_asvSet
-      if(!m_asvSet.contains(reg)) {
-        m_asvSet.emplace(reg, {width});
-      } 
-      WidthCycles_t& data = m_asvSet.at(reg);  // Possibly fetch what we just inserted.
-      assert(data.width == width);  // Check for inconsistent bitwidth
-      if (cycle > 0) {
-        data.cycles.insert(cycle);  // Cycles will be empty if no specific cycle is used.
-      }
-    }
-  }
+  return usefulFunc;
 }
 
 
@@ -539,7 +626,7 @@ FuncExtractFlow::get_delay_bounds(std::string var, const InstrInfo_t &instrInfo)
 
 
 
-// Check if this type is too big to be passed in a register.
+// Check if this type is too big to be passed in registers.
 // Pointers and void are not considered big.
 // Except in special cases, all parameters to update functions are integer types.
 static bool
@@ -554,16 +641,59 @@ isBigType(const llvm::Type *type) {
   }
   
   // Normal scalar, or void.
-  return (type->isIntegerTy() && type->getIntegerBitWidth() > 64);
+  return (type->isIntegerTy() && type->getIntegerBitWidth() > 128);
 }
 
 
+// Integers of 65 to 128 bits are passed and returned by value as i128,
+// which is the unsigned __int128 of the C/C++ side (two registers).
+static bool
+isWideType(const llvm::Type *type) {
+  return type->isIntegerTy() && type->getIntegerBitWidth() > 64
+         && type->getIntegerBitWidth() <= 128;
+}
+
+
+
+// The fields of an instruction family that make up the main function arg,
+// if instr.txt names all its x bits, and the constant bits of the arg.
+// Otherwise the arg is passed as it is.
+std::vector<const InstrField_t*>
+FuncExtractFlow::arg_fields(const llvm::Argument& arg, const InstrInfo_t& instrInfo,
+                            int delayBound, llvm::APInt& constBits) {
+  std::vector<const InstrField_t*> fields;
+  llvm::Type *type = arg.getType();
+  if (instrInfo.fields.empty() || !type->isIntegerTy() || type->getIntegerBitWidth() > 128)
+    return fields;
+
+  int cycle = 0;
+  std::string var = arg_var_cycle(arg.getName().str(), delayBound, cycle);
+  auto pos = instrInfo.instrEncoding.find(var);
+  if (cycle <= 0 || pos == instrInfo.instrEncoding.end() || pos->second.size() < (uint32_t)cycle)
+    return fields;
+
+  uint32_t width = type->getIntegerBitWidth();
+  llvm::APInt fieldMask(width, 0);
+  for (const InstrField_t& field : instrInfo.fields) {
+    if (field.signal == var && field.cycle == (uint32_t)cycle && field.hi < width) {
+      fieldMask.setBits(field.lo, field.hi+1);
+      fields.push_back(&field);
+    }
+  }
+  llvm::APInt xMask = convert_to_single_apint(pos->second[cycle-1], true/*xmask*/);
+  if (fields.empty() || xMask.zextOrTrunc(width) != fieldMask) fields.clear();
+  constBits = convert_to_single_apint(pos->second[cycle-1]).zextOrTrunc(width);
+  return fields;
+}
+
 
 // Make the wrapper function for C/C++ interfacing.
 // Return its name
 std::string
 FuncExtractFlow::create_wrapper_func(llvm::Module& M,
-                                         std::string mainFuncName) {
+                                         std::string mainFuncName,
+                                         const InstrInfo_t& instrInfo,
+                                         int delayBound) {
 
   llvm::Function *mainFunc = M.getFunction(mainFuncName);
   assert(mainFunc);
@@ -571,21 +701,51 @@ FuncExtractFlow::create_wrapper_func(llvm::Module& M,
   llvm::LLVMContext& Context = mainFunc->getContext();
 
   // First build a FunctionType for the wrapper function: it has pointers for
-  // every arg bigger than 64 bits.  If the return value is bigger than 64 bits,
+  // every arg bigger than 128 bits.  If the return value is bigger than 128 bits,
   // one more pointer arg is added for it, and the wrapper function returns void.
+  // Args and return values of 65 to 128 bits are widened to i128.
+  // For an instruction family, an input made of symbolic fields is replaced
+  // by one arg per field, and the wrapper function puts the input together.
 
   std::vector<llvm::Type *> wrapperArgTy;
+  llvm::Type *int128Ty = llvm::Type::getInt128Ty(Context);
+
+  // The wrapper arg of each main function arg, -1 for one made of fields
+  std::vector<int> wrapperArgNo;
+  std::vector<std::vector<const InstrField_t*>> mainArgFields;
+  std::vector<llvm::APInt> mainArgConst;
+  // The field args, after the others, by field name
+  std::map<std::string, unsigned> fieldArgNo;
+  std::vector<std::string> fieldArgNames;
 
   for (const llvm::Argument& arg : mainFunc->args()) {
+    mainArgConst.emplace_back();
+    mainArgFields.push_back(arg_fields(arg, instrInfo, delayBound, mainArgConst.back()));
+    if (!mainArgFields.back().empty()) {
+      wrapperArgNo.push_back(-1);
+      continue;
+    }
+    wrapperArgNo.push_back(wrapperArgTy.size());
     llvm::Type *type = arg.getType();
     if (isBigType(type)) {
       wrapperArgTy.push_back(llvm::PointerType::getUnqual(type));
+    } else if (isWideType(type)) {
+      wrapperArgTy.push_back(int128Ty);
     } else {
       // This handles small args, as well as pointers to register arrays.
       wrapperArgTy.push_back(type);
     }
   }
 
+  for (const auto& fields : mainArgFields) {
+    for (const InstrField_t *field : fields) {
+      if (fieldArgNo.count(field->name)) continue;
+      fieldArgNo.emplace(field->name, wrapperArgTy.size());
+      fieldArgNames.push_back(field->name);
+      wrapperArgTy.push_back(llvm::IntegerType::get(Context, field->hi-field->lo+1));
+    }
+  }
+
   llvm::Type* mainRetTy = mainFunc->getReturnType();
 
   // Deal with small vs large return values
@@ -595,6 +755,8 @@ FuncExtractFlow::create_wrapper_func(llvm::Module& M,
     // Add one more pointer argument for return value.
     wrapperArgTy.push_back(llvm::PointerType::getUnqual(mainRetTy));
     wrapperRetTy = llvm::Type::getVoidTy(Context);
+  } else if (isWideType(mainRetTy)) {
+    wrapperRetTy = int128Ty;
   } else {
     wrapperRetTy = mainRetTy;
   }
@@ -615,7 +777,8 @@ FuncExtractFlow::create_wrapper_func(llvm::Module& M,
 
   // Set the names of the wrapper function args, based on the main function arg names
   for (const llvm::Argument& mainArg : mainFunc->args()) {
-    unsigned argNo = mainArg.getArgNo();
+    if (wrapperArgNo[mainArg.getArgNo()] < 0) continue;
+    unsigned argNo = wrapperArgNo[mainArg.getArgNo()];
     llvm::Argument* wrapperArg = wrapperFunc->getArg(argNo);
     wrapperArg->setName(mainArg.getName());
 
@@ -625,13 +788,17 @@ FuncExtractFlow::create_wrapper_func(llvm::Module& M,
       wrapperArg->addAttr(llvm::Attribute::NonNull);
     }
     // Copy parameter attributes (important for pointer args).
-    llvm::AttrBuilder b(Context, mainFunc->getAttributes().getParamAttrs(argNo));
+    llvm::AttrBuilder b(Context, mainFunc->getAttributes().getParamAttrs(mainArg.getArgNo()));
     wrapperFunc->addParamAttrs(argNo, b);
     // Remove the "returned" attribute, since it may no longer be correct.
     wrapperFunc->removeParamAttr(argNo, llvm::Attribute::Returned);
 
   }
 
+  for (const std::string& name : fieldArgNames) {
+    wrapperFunc->getArg(fieldArgNo[name])->setName(FIELD_ARG_PREFIX+name);
+  }
+
   llvm::Argument* wrapperLastArg = wrapperFunc->arg_end()-1;
 
   // If needed, add an extra arg that handles big return types
@@ -653,12 +820,27 @@ FuncExtractFlow::create_wrapper_func(llvm::Module& M,
   std::vector<llvm::Value*> callArgs;
   for (llvm::Argument& mainArg : mainFunc->args()) {
     llvm::Type *mainArgType = mainArg.getType();
-    llvm::Argument* wrapperArg = wrapperFunc->getArg(mainArg.getArgNo());
+
+    if (wrapperArgNo[mainArg.getArgNo()] < 0) {
+      // Put the fields in their bits, the other bits are constant in the encoding
+      llvm::Value *argVal = llvm::ConstantInt::get(mainArgType, mainArgConst[mainArg.getArgNo()]);
+      for (const InstrField_t *field : mainArgFields[mainArg.getArgNo()]) {
+        llvm::Value *fieldVal = Builder->CreateZExt(wrapperFunc->getArg(fieldArgNo[field->name]),
+                                                    mainArgType);
+        argVal = Builder->CreateOr(argVal, Builder->CreateShl(fieldVal, field->lo));
+      }
+      callArgs.push_back(argVal);
+      continue;
+    }
+
+    llvm::Argument* wrapperArg = wrapperFunc->getArg(wrapperArgNo[mainArg.getArgNo()]);
 
     llvm::Value *argVal = nullptr;
     if (isBigType(mainArgType)) {
       // Dereference the pointer
       argVal = Builder->CreateLoad(mainArgType, wrapperArg);
+    } else if (isWideType(mainArgType)) {
+      argVal = Builder->CreateZExtOrTrunc(wrapperArg, mainArgType);
     } else {
       // Pass the arg by value
       argVal = wrapperArg;
@@ -676,6 +858,8 @@ FuncExtractFlow::create_wrapper_func(llvm::Module& M,
     Builder->CreateRetVoid();
   } else if (mainRetTy->isVoidTy()) {
     Builder->CreateRetVoid();
+  } else if (isWideType(mainRetTy)) {
+    Builder->CreateRet(Builder->CreateZExtOrTrunc(call, int128Ty));
   } else {
     // Return the return value of the call to mainFunc
     Builder->CreateRet(call);
@@ -818,6 +1002,38 @@ FuncExtractFlow::clean_main_func(llvm::Module& M,
 }
 
 
+// Extract the ASV name from the argument name (by removing the cycle count),
+// and the cycle of instr.txt, 0 if the name has no cycle count.
+// Note that the name will not have quotes or backslashes, like you would see in the textual IR.
+// TODO: have the client provide a parsing function for the arg name.
+std::string
+FuncExtractFlow::arg_var_cycle(const std::string& argname, int delayBound, int& cycle) {
+  uint32_t pos = argname.find(DELIM, 0);
+  std::string var = argname.substr(0, pos);
+
+  cycle = 0;
+  if (pos != std::string::npos) {
+    // Pick out the numeric portion of the arg name
+    // Doug TODO: Do register array vars have a cycle number in their name?
+    std::string cycleStr = argname.substr(pos + DELIM.size(), std::string::npos);
+    if (cycleStr.size() > 0) {
+      cycle = std::stoi(cycleStr);
+
+      // If the internal cycle numbering starts at the cycle count and decreases
+      // down to 0 at the final cycle, the cycle numbers must be mapped to the
+      // convention used in instr.txt, where the cycle numbering starts at 0
+      // and goes upwards as time passes.
+      if (m_reverseCycleOrder) {
+        cycle = delayBound - cycle;
+      } else {
+        cycle = cycle - 1;
+      }
+    }
+  }
+  return var;
+}
+
+
 // Push information about the wrapperFunc args to argVec, to be written out to func_info.txt
 
 bool
@@ -865,31 +1081,8 @@ FuncExtractFlow::gather_wrapper_func_args(llvm::Module& M,
       }
       argVec.push_back({argname, size, 0});
     } else {
-      // Extract the ASV name from the argument name (by removing the cycle count).
-      // Note that the name will not have quotes or backslashes, like you would see in the textual IR.
-      // TODO: have the client provide a parsing function for the arg name.
-      uint32_t pos = argname.find(DELIM, 0);
-      std::string var = argname.substr(0, pos);
-
       int cycle = 0;
-      if (pos != std::string::npos) {
-        // Pick out the numeric portion of the arg name
-        // Doug TODO: Do register array vars have a cycle number in their name?
-        std::string cycleStr = argname.substr(pos + DELIM.size(), std::string::npos);
-        if (cycleStr.size() > 0) {
-          cycle = std::stoi(cycleStr);
-
-          // If the internal cycle numbering starts at the cycle count and decreases
-          // down to 0 at the final cycle, the cycle numbers must be mapped to the
-          // convention used in instr.txt, where the cycle numbering starts at 0
-          // and goes upwards as time passes.
-          if (m_reverseCycleOrder) {
-            cycle = delayBound - cycle;
-          } else {
-            cycle = cycle - 1;
-          }
-        }
-      }
+      std::string var = arg_var_cycle(argname, delayBound, cycle);
 
       if (!isPointer) {
         // A small thing (presumably a scalar ASV) passed by value
@@ -921,6 +1114,245 @@ FuncExtractFlow::gather_wrapper_func_args(llvm::Module& M,
 }
 
 
+// The text of the update function in the LLVM file, without the names that
+// differ between two identical update functions: those of the main and
+// wrapper functions, of their args and of their values.
+static bool
+normalized_func_text(const std::string& fileName, const std::string& wrapperFuncName,
+                     std::string& text) {
+  llvm::SMDiagnostic Err;
+  llvm::LLVMContext Context;
+  std::unique_ptr<llvm::Module> M = llvm::parseIRFile(fileName, Err, Context);
+  if (!M) {
+    Err.print("func_extract", llvm::errs());
+    return false;
+  }
+
+  std::string funcName = wrapperFuncName.substr(0, wrapperFuncName.rfind("_wrapper"));
+  llvm::Function *mainFunc = M->getFunction(funcName);
+  llvm::Function *wrapperFunc = M->getFunction(wrapperFuncName);
+  if (!mainFunc || !wrapperFunc) return false;
+  mainFunc->setName("update_func");
+  wrapperFunc->setName("update_func_wrapper");
+
+  for (llvm::Function& func : *M) {
+    for (llvm::Argument& arg : func.args()) arg.setName("");
+    for (llvm::BasicBlock& bb : func) {
+      bb.setName("");
+      for (llvm::Instruction& inst : bb) inst.setName("");
+    }
+  }
+  M->setModuleIdentifier("");
+  M->setSourceFileName("");
+
+  llvm::raw_string_ostream OS(text);
+  OS << *M;
+  OS.flush();
+  return true;
+}
+
+
+// Merge the update functions that came out identical after the optimization,
+// e.g. the ones that keep the value of an ASV, or those of opcode variants
+// that compute the same result.  The first one (in the order of func_info.txt)
+// is kept, and the others call it: func_info.txt gives its wrapper function as
+// their "Alias:", and their files are left out of link.sh and ila.mk.
+// Args are passed by position, so the arg names do not have to match.
+void
+FuncExtractFlow::dedup_update_functions() {
+  toCout("### Begin dedup_update_functions");
+  // The canonical update functions, by the hash of their text
+  std::map<size_t, std::vector<std::pair<std::string, std::string>>> canonicals;
+  uint32_t mergedNum = 0;
+
+  for (const auto& pair : m_funcFiles) {
+    const std::string& fileName = pair.second.first;
+    const std::string& wrapperFuncName = pair.second.second;
+    std::string text;
+    if (!normalized_func_text(fileName, wrapperFuncName, text)) {
+      toCout("Warning: cannot read "+wrapperFuncName+" from "+fileName+", it is not merged");
+      continue;
+    }
+
+    // Compare the full text on a hash match, to rule out collisions
+    std::vector<std::pair<std::string, std::string>>& candidates = canonicals[std::hash<std::string>{}(text)];
+    const std::pair<std::string, std::string> *canonical = nullptr;
+    for (const auto& candidate : candidates) {
+      std::string candidateText;
+      if (normalized_func_text(candidate.first, candidate.second, candidateText)
+          && candidateText == text) {
+        canonical = &candidate;
+        break;
+      }
+    }
+
+    if (!canonical) {
+      candidates.push_back(pair.second);
+      continue;
+    }
+    toCout("Update function "+wrapperFuncName+" is identical to "+canonical->second);
+    m_funcAliases.emplace(pair.first, canonical->second);
+    m_mergedFiles.insert(fileName);
+    mergedNum++;
+  }
+
+  toCout("Merged "+toStr(mergedNum)+" of "+toStr(m_funcFiles.size())
+         +" update functions into identical ones");
+}
+
+
+// Search for the smallest delay bound below the given one, at which the
+// update function of the target is already the same as with the given
+// bound: the target does not change any more in the later cycles.  The
+// functions are compared like in dedup_update_functions(), and must take
+// the same vars of the same instr.txt cycles.  The bounds are tried in
+// increasing order, since the smaller ones are the cheaper to unroll.
+// If one is found, the LLVM file, wrapper function and args are replaced
+// with its own.  Return the bound.
+uint32_t
+FuncExtractFlow::discover_delay_bound(std::string target,
+                                      uint32_t delayBound,
+                                      bool isVec,
+                                      const InstrInfo_t& instrInfo,
+                                      uint32_t instrIdx,
+                                      std::string& llvmFileName,
+                                      std::string& wrapperFuncName,
+                                      ArgVec_t& argVec) {
+  std::string text;
+  if (!normalized_func_text(llvmFileName, wrapperFuncName, text)) {
+    toCout("Warning: cannot read "+wrapperFuncName+" from "+llvmFileName
+           +", keeping the delay bound "+toStr(delayBound));
+    return delayBound;
+  }
+
+  auto sameArgs = [](const ArgVec_t& a, const ArgVec_t& b) {
+    if (a.size() != b.size()) return false;
+    for (size_t i = 0; i < a.size(); i++) {
+      if (a[i].name != b[i].name || a[i].width != b[i].width || a[i].cycle != b[i].cycle)
+        return false;
+    }
+    return true;
+  };
+
+  for (uint32_t bound = 1; bound < delayBound; bound++) {
+    std::string boundFileName;
+    std::string boundWrapperName;
+    ArgVec_t boundArgVec;
+    if (!make_update_function(target, bound, isVec, instrInfo, instrIdx,
+                              boundFileName, boundWrapperName, boundArgVec)) {
+      continue;
+    }
+    std::string boundText;
+    if (sameArgs(boundArgVec, argVec)
+        && normalized_func_text(boundFileName, boundWrapperName, boundText)
+        && boundText == text) {
+      toCout("Discovered delay bound "+toStr(bound)+" (instead of "+toStr(delayBound)
+             +") for instr "+instrInfo.name+", target "+target);
+      llvmFileName = boundFileName;
+      wrapperFuncName = boundWrapperName;
+      argVec = boundArgVec;
+      return bound;
+    }
+  }
+  return delayBound;
+}
+
+
+// delay_bounds.txt has the delay bounds found by discover_delay_bound(),
+// one per line: <instr>:<target>:<bound searched from>:<discovered bound>
+void
+FuncExtractFlow::read_delay_bounds(std::string fileName) {
+  std::ifstream input(fileName);
+  std::string line;
+  while (std::getline(input, line)) {
+    if (line.empty()) continue;
+    // The target name may have ':' in it, but not the instr name or the bounds
+    size_t pos1 = line.find(':');
+    size_t pos3 = line.rfind(':');
+    size_t pos2 = (pos3 == std::string::npos || pos3 == 0) ? std::string::npos
+                                                            : line.rfind(':', pos3-1);
+    if (pos1 == std::string::npos || pos2 == std::string::npos || pos2 <= pos1) {
+      toCout("Warning: ignoring bad line in "+fileName+": "+line);
+      continue;
+    }
+    std::string instr = line.substr(0, pos1);
+    std::string target = line.substr(pos1+1, pos2-pos1-1);
+    uint32_t bound = std::stoi(line.substr(pos2+1, pos3-pos2-1));
+    uint32_t minBound = std::stoi(line.substr(pos3+1));
+    m_discoveredBounds[std::make_pair(instr, target)] = std::make_pair(bound, minBound);
+  }
+}
+
+
+void
+FuncExtractFlow::print_delay_bounds(std::string fileName) {
+  std::ofstream output(fileName);
+  for (const auto& pair : m_discoveredBounds) {
+    output << pair.first.first << ":" << pair.first.second << ":"
+           << pair.second.first << ":" << pair.second.second << std::endl;
+  }
+}
+
+
+// Link the .ll files of each instruction (g_combine_llvm_modules is "instr")
+// or of the whole design ("design") into one file, so that the declarations,
+// the data layout and the linkonce constant arrays are there only once.  The
+// mergefunc pass then merges the helper functions that came out identical.
+// link.sh and ila.mk build these files instead of one per update function.
+void
+FuncExtractFlow::combine_llvm_modules() {
+  toCout("### Begin combine_llvm_modules");
+  std::map<std::string, std::string> fileInstrs;
+  for (const auto& pair : m_funcFiles) {
+    fileInstrs.emplace(pair.second.first, pair.first.first);
+  }
+
+  // The files to combine into each file, in the order of m_linkFiles
+  std::map<std::string, std::vector<std::string>> groups;
+  std::vector<std::string> linkFiles;
+  for (const std::string& fileName : m_linkFiles) {
+    std::string combined;
+    if (g_combine_llvm_modules == "design") {
+      combined = g_path+"/combined.ll";
+    } else if (fileInstrs.count(fileName)) {
+      combined = g_path+"/combined_"+fileInstrs[fileName]+".ll";
+    } else {
+      // Not in func_info.txt, e.g. the function of a second delay bound
+      linkFiles.push_back(fileName);
+      continue;
+    }
+    if (groups[combined].empty()) linkFiles.push_back(combined);
+    groups[combined].push_back(fileName);
+  }
+
+  std::string llvmPath = g_llvm_path.length() ? g_llvm_path+"/" : "";
+  for (const auto& pair : groups) {
+    const std::string& combined = pair.first;
+    std::string baseName = combined.substr(0, combined.size()-3);
+
+    // The file names go in a response file, they can be too many for a command line
+    std::ofstream listFile(baseName+".files-ll");
+    for (const std::string& fileName : pair.second) {
+      listFile << fileName << std::endl;
+    }
+    listFile.close();
+
+    std::string linkCmd(llvmPath+"llvm-link @"+baseName+".files-ll -S -o="+baseName+".link-ll");
+    std::string mergeCmd(llvmPath+"opt -passes=mergefunc "+baseName+".link-ll -S -o="+combined);
+    toCoutVerb(linkCmd);
+    toCoutVerb(mergeCmd);
+    if (system(linkCmd.c_str()) != 0 || system(mergeCmd.c_str()) != 0) {
+      toCout("Error: cannot combine "+toStr(pair.second.size())+" LLVM files into "+combined);
+      abort();
+    }
+  }
+
+  toCout("Combined "+toStr(m_linkFiles.size()-(linkFiles.size()-groups.size()))
+         +" LLVM files into "+toStr(groups.size()));
+  m_linkFiles = linkFiles;
+}
+
+
 void
 FuncExtractFlow::print_func_info(std::ofstream &output) {
   m_dependVarMapMtx.lock();
@@ -928,6 +1360,10 @@ FuncExtractFlow::print_func_info(std::ofstream &output) {
     output << "Instr:"+pair1.first << std::endl;
     for (const auto pair2 : pair1.second) {
       output << "Target:"+pair2.first << std::endl;
+      auto alias = m_funcAliases.find(std::make_pair(pair1.first, pair2.first));
+      if (alias != m_funcAliases.end()) {
+        output << "Alias:"+alias->second << std::endl;
+      }
       for (const auto arg : pair2.second) {
         output << arg.name+":"+toStr(arg.width);
         if (arg.cycle != 0) {
@@ -978,19 +1414,24 @@ FuncExtractFlow::print_asv_info(std::ofstream &output) {
 
 
 void
-FuncExtractFlow::print_llvm_script( std::string fileName) {
+FuncExtractFlow::print_llvm_script( std::string fileName, bool sharedLib) {
   // Any command-line args (e.g. -O3) will be given to clang.
+  // With sharedLib, the script builds libila.so from the ila.cpp of sim_gen -lib.
+  std::string pic = sharedLib ? " -fPIC" : "";
   std::ofstream output(fileName);
-  output << "clang $* ila.cpp -emit-llvm -S -o main.ll" << std::endl;
+  output << "clang"+pic+" $* ila.cpp -emit-llvm -S -o main.ll" << std::endl;
   std::string line = "llvm-link -v main.ll \\";
   output << line << std::endl;
-  for(auto it = m_fileNameVec.begin(); it != m_fileNameVec.end(); it++) {
+  for(auto it = m_linkFiles.begin(); it != m_linkFiles.end(); it++) {
     line = *it + " \\";
     output << line << std::endl;
   }
   line = "-S -o linked.ll";
   output << line << std::endl;
-  output << "clang $* linked.ll" << std::endl;
+  if (sharedLib)
+    output << "clang -shared -fPIC $* linked.ll -o libila.so" << std::endl;
+  else
+    output << "clang $* linked.ll" << std::endl;
   output.close();
 
   // Make the new file executable, to the extent that it is readable.
@@ -1004,6 +1445,53 @@ FuncExtractFlow::print_llvm_script( std::string fileName) {
 }
 
 
+// The same build as link.sh and link_lib.sh, as a makefile.  Every update
+// function is compiled to its own object, so "make -j" compiles them in
+// parallel, and after a partial re-extraction only the .ll files that
+// changed are compiled again.
+void
+FuncExtractFlow::print_make_file(std::string fileName) {
+  std::set<std::string> objNames;
+  for(auto it = m_linkFiles.begin(); it != m_linkFiles.end(); it++) {
+    // The makefile is in g_path, like the .ll files
+    std::string name = it->substr(it->rfind('/')+1);
+    objNames.insert("obj/"+name.substr(0, name.size()-3)+".o");
+  }
+
+  std::ofstream output(fileName);
+  output << "# Build the simulator with:       make -f ila.mk -j [CFLAGS=-O3]" << std::endl;
+  output << "# or the library of sim_gen -lib: make -f ila.mk -j libila.so [CFLAGS=-O3]" << std::endl;
+  output << std::endl;
+  output << "CC = clang" << std::endl;
+  output << "CFLAGS =" << std::endl;
+  output << std::endl;
+  output << "OBJS = \\" << std::endl;
+  for(const std::string& obj : objNames) {
+    output << "  " << obj << " \\" << std::endl;
+  }
+  output << std::endl;
+  output << "ila: ila.o $(OBJS)" << std::endl;
+  output << "\t$(CC) $(CFLAGS) $^ -o $@" << std::endl;
+  output << std::endl;
+  output << "libila.so: ila.o $(OBJS)" << std::endl;
+  output << "\t$(CC) -shared -fPIC $(CFLAGS) $^ -o $@" << std::endl;
+  output << std::endl;
+  // ila.cpp includes ila_main.cpp with -separate_main
+  output << "ila.o: ila.cpp ila.h $(wildcard ila_main.cpp ila_api.h)" << std::endl;
+  output << "\t$(CC) -fPIC $(CFLAGS) -c $< -o $@" << std::endl;
+  output << std::endl;
+  output << "obj/%.o: %.ll" << std::endl;
+  output << "\t@mkdir -p obj" << std::endl;
+  output << "\t$(CC) -fPIC $(CFLAGS) -c $< -o $@" << std::endl;
+  output << std::endl;
+  output << "clean:" << std::endl;
+  output << "\trm -rf ila.o obj" << std::endl;
+  output << std::endl;
+  output << ".PHONY: clean" << std::endl;
+  output.close();
+}
+
+
 void WorkSet_t::mtxInsert(std::string reg) {
   mtx.lock();
   workSet.insert(reg);
@@ -14,6 +14,7 @@
 #include <functional>
 #include <atomic>
 #include "global_data_struct.h"
+#include "branch_mux.h"
 
 namespace funcExtract {
 
@@ -94,6 +95,28 @@ private:
 
   std::mutex m_TimeFileMtx;
 
+  // The LLVM file and wrapper function of each update function in
+  // m_dependVarMap, keyed by instr and target.  With g_dedup_update_functions,
+  // the update functions identical to an earlier one get its wrapper function
+  // in m_funcAliases, and their files are not linked.
+  std::map<std::pair<std::string, std::string>, std::pair<std::string, std::string>> m_funcFiles;
+  std::map<std::pair<std::string, std::string>, std::string> m_funcAliases;
+  std::set<std::string> m_mergedFiles;
+
+  // With g_discover_delay_bounds, the delay bound searched from and the
+  // bound found, keyed by instr and target (see delay_bounds.txt)
+  std::map<std::pair<std::string, std::string>, std::pair<uint32_t, uint32_t>> m_discoveredBounds;
+  std::mutex m_delayBoundMtx;
+
+  // The .ll files that link.sh and ila.mk build
+  std::vector<std::string> m_linkFiles;
+
+  // The profile that guides the mux-to-branch conversion, if any, and the
+  // report of its decisions
+  BranchMux::MuxProfile m_muxProfile;
+  bool m_hasMuxProfile = false;
+  std::mutex m_muxReportMtx;
+
   ThreadSafeMap_t<WidthCycles_t> m_asvSet;
 
   WorkSet_t m_workSet;
@@ -117,7 +140,16 @@ public:
                        std::string funcName);
 
   std::string create_wrapper_func(llvm::Module& M,
-                           std::string mainFuncName);
+                           std::string mainFuncName,
+                           const InstrInfo_t& instrInfo,
+                           int delayBound);
+
+  std::vector<const InstrField_t*> arg_fields(const llvm::Argument& arg,
+                                              const InstrInfo_t& instrInfo,
+                                              int delayBound,
+                                              llvm::APInt& constBits);
+
+  std::string arg_var_cycle(const std::string& argname, int delayBound, int& cycle);
 
   bool gather_wrapper_func_args(llvm::Module& M,
                         std::string wrapperFuncName,
@@ -128,11 +160,30 @@ public:
   std::vector<uint32_t>
   get_delay_bounds(std::string var, const InstrInfo_t& instrInfo);
 
+  uint32_t discover_delay_bound(std::string target,
+                                uint32_t delayBound,
+                                bool isVec,
+                                const InstrInfo_t& instrInfo,
+                                uint32_t instrIdx,
+                                std::string& llvmFileName,
+                                std::string& wrapperFuncName,
+                                ArgVec_t& argVec);
+
+  void read_delay_bounds(std::string fileName);
+
+  void print_delay_bounds(std::string fileName);
+
+  void dedup_update_functions();
+
+  void combine_llvm_modules();
+
   void print_func_info(std::ofstream &output);
 
   void print_asv_info(std::ofstream &output);
 
-  void print_llvm_script( std::string fileName);
+  void print_llvm_script( std::string fileName, bool sharedLib=false);
+
+  void print_make_file(std::string fileName);
 
   void get_update_function(std::string target,
                            uint32_t delayBound,
@@ -140,6 +191,15 @@ public:
                            InstrInfo_t instrInfo,
                            uint32_t instrIdx);
 
+  bool make_update_function(std::string target,
+                            uint32_t delayBound,
+                            bool isVec,
+                            const InstrInfo_t& instrInfo,
+                            uint32_t instrIdx,
+                            std::string& llvmFileName,
+                            std::string& wrapperFuncName,
+                            ArgVec_t& argVec);
+
   llvm::Function *remove_dead_args(llvm::Function *func);
 
 
@@ -81,6 +81,12 @@ bool g_overwrite_existing_llvm = true;
 bool g_do_bitwise_opt = false;
 bool g_post_opto_mux_to_branch = false; // disabled by default
 int g_post_opto_mux_to_branch_threshold = -1; // Use default threshold
+double g_post_opto_mux_to_branch_bias = 0.9; // With a profile, convert only biased muxes
+bool g_post_opto_mux_profile = false; // Instrument the muxes instead of converting them
+std::string g_post_opto_mux_profile_file = ""; // Mux profile that guides the conversion
+bool g_dedup_update_functions = false; // Link one copy of identical update functions
+std::string g_combine_llvm_modules = ""; // "instr" or "design" to link .ll files into bigger ones
+bool g_discover_delay_bounds = false; // Search for the smallest delay bound of every update function
 std::string g_llvm_path = "";
 uint32_t g_do_instr_num;
 std::ofstream g_outFile;
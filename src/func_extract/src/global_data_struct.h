@@ -54,6 +54,9 @@ inline bool is_special_arg_name(const std::string& name) {
   return name == RETURN_VAL_PTR_ID || name == RETURN_ARRAY_PTR_ID;
 }
 
+// Prefix of the arg names of the symbolic fields of an instruction family
+constexpr const char *FIELD_ARG_PREFIX = "#";  // Not a legal Verilog identifier.
+
 
 //struct LoadDataInfo_t {
 //    // only load instruction has dataAddr: to get data from dmem
@@ -87,6 +90,9 @@ struct FuncTy_t {
   int retTy;
   // Names and bitwidths of args. <0 means a pointer, 0 means something special.
   ArgVec_t argTy;
+  // The identical update function to call instead, if func_extract merged
+  // this one with it (see g_dedup_update_functions).  Empty if none.
+  std::string alias;
 };
 
 
@@ -96,6 +102,20 @@ struct FuncTy_t {
 typedef std::map<std::string, std::vector<std::string>> InstEncoding_t;
 
 
+// A symbolic field of an instruction family: bits hi..lo of an input
+// signal in one cycle of the encoding, which instr.txt leaves x and names.
+// The update functions of the family take the field as the arg
+// FIELD_ARG_PREFIX+name, instead of the signal.  A field that appears in
+// several cycles has one InstrField_t per cycle.
+struct InstrField_t {
+  std::string name;
+  std::string signal;
+  uint32_t cycle;  // Cycle of the encoding, from 1
+  uint32_t hi;
+  uint32_t lo;
+};
+
+
 struct InstrInfo_t {
   InstEncoding_t instrEncoding;
   //std::set<std::string> readASV;
@@ -121,9 +141,31 @@ struct InstrInfo_t {
   std::map<std::string, uint32_t> delayExceptions;
   // map update function to new target var(s)
   std::map<std::string, std::set<std::string>> funcTgtMap;
+  // Symbolic fields, if the instruction is a family
+  std::vector<InstrField_t> fields;
 };
 
 
+// The field that the update function arg passes (its first cycle),
+// nullptr if the arg is not a field
+inline const InstrField_t *find_field_arg(const InstrInfo_t& instrInfo, const std::string& argName) {
+  if (argName.rfind(FIELD_ARG_PREFIX, 0) != 0) return nullptr;
+  for (const InstrField_t& field : instrInfo.fields) {
+    if (FIELD_ARG_PREFIX+field.name == argName) return &field;
+  }
+  return nullptr;
+}
+
+
+// The var that holds the value of the update function arg, as sim_gen
+// assigns it from tb.txt: a field is read from its signal
+inline Arg_t arg_var(const InstrInfo_t& instrInfo, const Arg_t& arg) {
+  const InstrField_t *field = find_field_arg(instrInfo, arg.name);
+  if (!field) return arg;
+  return {field->signal, 0, (int)field->cycle};
+}
+
+
 struct Switch_info {
   std::string switchVar;
   // first is the value for switch variable, 
@@ -358,6 +400,12 @@ extern bool g_overwrite_existing_llvm;
 extern bool g_do_bitwise_opt;
 extern bool g_post_opto_mux_to_branch;
 extern int g_post_opto_mux_to_branch_threshold;
+extern double g_post_opto_mux_to_branch_bias;
+extern bool g_post_opto_mux_profile;
+extern std::string g_post_opto_mux_profile_file;
+extern bool g_dedup_update_functions;
+extern std::string g_combine_llvm_modules;
+extern bool g_discover_delay_bounds;
 extern std::string g_llvm_path;
 extern uint32_t g_do_instr_num;
 extern std::set<std::string> g_readASV;
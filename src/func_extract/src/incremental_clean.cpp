@@ -0,0 +1,230 @@
+#include "incremental_clean.h"
+#include "helper.h"
+#include "../../live_analysis/src/taint_gen.h"
+#include "../../live_analysis/src/global_data.h"
+
+#include <map>
+#include <cstring>
+#include <sstream>
+#include <iomanip>
+#include <cstdio>
+#include <sys/stat.h>
+
+#define toStr(a) std::to_string(a)
+
+using namespace taintGen;
+
+namespace funcExtract {
+
+
+// FNV-1a.  Only used to detect changed module text, so it does not need to
+// be cryptographically strong.
+uint64_t hash_text(const std::string& text) {
+  uint64_t h = 0xcbf29ce484222325ULL;
+  for (unsigned char c : text) {
+    h ^= c;
+    h *= 0x100000001b3ULL;
+  }
+  return h;
+}
+
+
+static std::string hash_to_hex(uint64_t h) {
+  std::ostringstream ss;
+  ss << std::hex << std::setw(16) << std::setfill('0') << h;
+  return ss.str();
+}
+
+
+// Return true if the line begins with the given keyword, ignoring leading blanks.
+static bool starts_with_keyword(const std::string& line, const char *keyword) {
+  size_t pos = line.find_first_not_of(" \t");
+  if (pos == std::string::npos) return false;
+  size_t len = strlen(keyword);
+  if (line.compare(pos, len, keyword) != 0) return false;
+  return line.size() == pos+len || isspace(line[pos+len]) || line[pos+len] == '('
+         || line[pos+len] == ';';
+}
+
+
+void split_design_modules(const std::string& fileName,
+                          std::vector<ModuleChunk_t>& chunks) {
+  std::ifstream input(fileName);
+  if (!input.is_open()) {
+    toCout("Error: the file cannot be open: "+fileName);
+    abort();
+  }
+
+  std::string line;
+  std::string pending;  // Text seen outside of any module
+  bool inModule = false;
+  while (std::getline(input, line)) {
+    if (!inModule && starts_with_keyword(line, "module")) {
+      ModuleChunk_t chunk;
+      size_t pos = line.find("module") + 6;
+      size_t begin = line.find_first_not_of(" \t\\", pos);
+      size_t end = line.find_first_of(" \t(;", begin);
+      if (begin != std::string::npos)
+        chunk.name = line.substr(begin, end-begin);
+      chunk.text.swap(pending);
+      chunks.push_back(chunk);
+      inModule = true;
+    }
+
+    std::string& dest = inModule ? chunks.back().text : pending;
+    dest += line;
+    dest += '\n';
+
+    if (inModule && starts_with_keyword(line, "endmodule")) {
+      inModule = false;
+    }
+  }
+
+  // Keep any trailing text, so that nothing of the original file is lost.
+  if (!pending.empty()) {
+    if (chunks.empty()) chunks.push_back(ModuleChunk_t());
+    chunks.back().text += pending;
+  }
+
+  for (auto& chunk : chunks) {
+    chunk.hash = hash_text(chunk.text);
+  }
+}
+
+
+// The manifest starts with "next <N>", followed by one line per module:
+// <hash> <first fangyuan> <end fangyuan> <module name>
+// Every cleaned module owns its own range of fangyuan numbers, so cached
+// modules never collide with modules cleaned in a later run.
+struct CacheEntry_t {
+  uint32_t fangyuanBegin = 0;
+  uint32_t fangyuanEnd = 0;
+  std::string name;
+};
+
+
+static void read_clean_manifest(const std::string& fileName,
+                                uint32_t& nextFangyuan,
+                                std::vector<std::string>& order,
+                                std::map<std::string, CacheEntry_t>& entries) {
+  std::ifstream input(fileName);
+  std::string line;
+  nextFangyuan = 0;
+  while (std::getline(input, line)) {
+    std::istringstream ss(line);
+    std::string hash;
+    if (!(ss >> hash)) continue;
+    if (hash == "next") {
+      ss >> nextFangyuan;
+      continue;
+    }
+    CacheEntry_t entry;
+    if (!(ss >> entry.fangyuanBegin >> entry.fangyuanEnd)) continue;
+    ss >> entry.name;
+    order.push_back(hash);
+    entries[hash] = entry;
+  }
+}
+
+
+// Collect the widths of declared wires/regs/ports of a cached module, as
+// clean_file() would have done while cleaning it.  clean_submod() depends on them.
+static void fill_cached_var_width(const std::string& text) {
+  std::istringstream ss(text);
+  std::string line;
+  while (std::getline(ss, line)) {
+    if (starts_with_keyword(line, "input") || starts_with_keyword(line, "output")
+        || starts_with_keyword(line, "reg") || starts_with_keyword(line, "wire")) {
+      fill_var_width(line, varWidth);
+    }
+  }
+}
+
+
+bool incremental_clean_file(const std::string& fileName) {
+  toCout("### Begin incremental_clean_file: "+fileName);
+
+  std::string cacheDir = fileName+".cache";
+  std::string manifestName = cacheDir+"/manifest.txt";
+  mkdir(cacheDir.c_str(), 0755);
+
+  std::vector<ModuleChunk_t> chunks;
+  split_design_modules(fileName, chunks);
+
+  uint32_t nextFangyuan;
+  std::vector<std::string> oldOrder;
+  std::map<std::string, CacheEntry_t> oldEntries;
+  read_clean_manifest(manifestName, nextFangyuan, oldOrder, oldEntries);
+
+  std::vector<std::string> newOrder;
+  std::map<std::string, CacheEntry_t> newEntries;
+  uint32_t recleaned = 0;
+
+  struct stat statbuf;
+  for (const auto& chunk : chunks) {
+    std::string hash = hash_to_hex(chunk.hash);
+    std::string cachedName = cacheDir+"/"+hash+".nocomment";
+    newOrder.push_back(hash);
+    if (newEntries.count(hash)) continue;  // Identical module text seen before
+
+    if (oldEntries.count(hash) && stat(cachedName.c_str(), &statbuf) == 0) {
+      newEntries[hash] = oldEntries[hash];
+      continue;
+    }
+
+    toCout("=== Cleaning changed module: "+chunk.name);
+    std::string srcName = cacheDir+"/"+hash+".v";
+    std::ofstream src(srcName);
+    src << chunk.text;
+    src.close();
+
+    NEW_FANGYUAN = nextFangyuan;
+    clean_file(srcName, false);
+    rename((srcName+".nocomment").c_str(), cachedName.c_str());
+    remove(srcName.c_str());
+
+    newEntries[hash] = CacheEntry_t{nextFangyuan, (uint32_t)NEW_FANGYUAN, chunk.name};
+    nextFangyuan = NEW_FANGYUAN;
+    recleaned++;
+  }
+
+  toCout("### "+toStr(recleaned)+" of "+toStr(chunks.size())+" modules cleaned");
+
+  if (recleaned == 0 && newOrder == oldOrder
+      && stat((fileName+".clean").c_str(), &statbuf) == 0) {
+    toCout("### No module changed since last clean");
+    return false;
+  }
+
+  // Assemble the cleaned modules, in their original order.
+  std::ofstream output(fileName+".nocomment");
+  for (const std::string& hash : newOrder) {
+    std::ifstream cached(cacheDir+"/"+hash+".nocomment");
+    std::stringstream buf;
+    buf << cached.rdbuf();
+    std::string text = buf.str();
+    fill_cached_var_width(text);
+    output << text;
+  }
+  output.close();
+
+  // remove_functions() creates more fangyuan variables, which must not
+  // collide with any created while cleaning.
+  NEW_FANGYUAN = nextFangyuan;
+  did_clean_file = true;
+
+  std::ofstream manifest(manifestName);
+  manifest << "next " << nextFangyuan << std::endl;
+  for (const std::string& hash : newOrder) {
+    const CacheEntry_t& entry = newEntries[hash];
+    manifest << hash << " " << entry.fangyuanBegin << " " << entry.fangyuanEnd
+             << " " << entry.name << std::endl;
+  }
+  manifest.close();
+
+  toCout("### End incremental_clean_file");
+  return true;
+}
+
+
+} // end of namespace funcExtract
@@ -0,0 +1,35 @@
+#ifndef FUNC_EXTRACT_INCREMENTAL_CLEAN_H
+#define FUNC_EXTRACT_INCREMENTAL_CLEAN_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+namespace funcExtract {
+
+// One "module ... endmodule" block of the original design file.  Any text
+// between modules (comments, `timescale, attributes) is attached to the
+// following module, so concatenating all the texts reproduces the file.
+struct ModuleChunk_t {
+  std::string name;
+  std::string text;
+  uint64_t hash = 0;
+};
+
+
+void split_design_modules(const std::string& fileName,
+                          std::vector<ModuleChunk_t>& chunks);
+
+uint64_t hash_text(const std::string& text);
+
+// Module-granular replacement for clean_file().  Each module of fileName is
+// cleaned separately, and the result is cached in <fileName>.cache/ keyed by
+// a hash of the module text, so only modules whose text changed since the
+// last run are cleaned again.  The cached pieces are then concatenated into
+// <fileName>.nocomment, just as clean_file() would have produced.
+// Returns false (and writes nothing) if no module changed and
+// <fileName>.clean already exists.
+bool incremental_clean_file(const std::string& fileName);
+
+} // end of namespace funcExtract
+#endif
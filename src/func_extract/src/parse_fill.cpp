@@ -51,7 +51,7 @@ void clear_global_vars() {
 // parse the verilog lines, and store them into ssaTable & nbTable
 void parse_verilog(std::string fileName) {
   toCout("### Begin parse_verilog");
-  std::ifstream input(fileName);
+  LineReader input(fileName);
   if(!input.is_open()) {
     toCout("Error: the file cannot be open: "+fileName);
     abort();
@@ -62,7 +62,7 @@ void parse_verilog(std::string fileName) {
   //g_curMod->name = g_topModule;
   //g_curMod->invarRegs = g_invarRegs;
   //g_moduleInfoMap.emplace(g_topModule, g_curMod);
-  while( std::getline(input, line) ) {
+  while( input.getline(line) ) {
     toCoutVerb(line);
     if(line.empty() 
          || line.find_first_not_of(' ') == std::string::npos
@@ -87,7 +87,7 @@ void parse_verilog(std::string fileName) {
     }
 
     if(line.find("/* memory */") != std::string::npos) {
-      std::getline(input, line);
+      input.getline(line);
       if(line.find("module") == std::string::npos) {
         toCout("Error: does not find the module definition for memory: "+line);
         abort();
@@ -328,10 +328,10 @@ ModuleInfo_t::~ModuleInfo_t() {
 /// this function only gets module name and their 
 void get_io(const std::string &fileName) {
   toCout("### Begin get IO information");
-  std::ifstream input(fileName);
+  LineReader input(fileName);
   std::string line;
   std::smatch match;
-  while( std::getline(input, line) ) {
+  while( input.getline(line) ) {
     toCoutVerb(line);
     if(line.find("reg [7:0] out;") != std::string::npos)
       toCoutVerb("Find it!");
@@ -578,6 +578,42 @@ void read_config(std::string fileName) {
         g_do_bitwise_opt = (value == "true");
         configNum++;
         toCout("read g_do_bitwise_opt: " + value);
+      } else if (config == "g_post_opto_mux_to_branch") {
+        g_post_opto_mux_to_branch = (value == "true");
+        configNum++;
+        toCout("read g_post_opto_mux_to_branch: " + value);
+      } else if (config == "g_post_opto_mux_to_branch_threshold") {
+        g_post_opto_mux_to_branch_threshold = std::stoi(value);
+        configNum++;
+        toCout("read g_post_opto_mux_to_branch_threshold: " + value);
+      } else if (config == "g_post_opto_mux_to_branch_bias") {
+        g_post_opto_mux_to_branch_bias = std::stod(value);
+        configNum++;
+        toCout("read g_post_opto_mux_to_branch_bias: " + value);
+      } else if (config == "g_post_opto_mux_profile") {
+        g_post_opto_mux_profile = (value == "true");
+        configNum++;
+        toCout("read g_post_opto_mux_profile: " + value);
+      } else if (config == "g_post_opto_mux_profile_file") {
+        g_post_opto_mux_profile_file = value;
+        configNum++;
+        toCout("read g_post_opto_mux_profile_file: " + value);
+      } else if (config == "g_dedup_update_functions") {
+        g_dedup_update_functions = (value == "true");
+        configNum++;
+        toCout("read g_dedup_update_functions: " + value);
+      } else if (config == "g_combine_llvm_modules") {
+        if (!value.empty() && value != "instr" && value != "design") {
+          toCout("Error: g_combine_llvm_modules must be instr or design: " + value);
+          abort();
+        }
+        g_combine_llvm_modules = value;
+        configNum++;
+        toCout("read g_combine_llvm_modules: " + value);
+      } else if (config == "g_discover_delay_bounds") {
+        g_discover_delay_bounds = (value == "true");
+        configNum++;
+        toCout("read g_discover_delay_bounds: " + value);
       } else
       {
         toCout("Warning: variable " + config + " in config.txt is not defined!!!");
@@ -6,12 +6,53 @@ namespace funcExtract {
 
 using namespace taintGen;
 
+// Take the named symbolic fields of an instruction family out of the
+// encoding of the signal, and return the plain encoding.
+// E.g. "7'b0+rs2:5'bx+rs1:5'bx+3'h0+rd:5'bx+7'h33" has the fields rs2, rs1
+// and rd, and every segment of such an encoding needs a width.
+static std::string
+take_instr_fields(const std::string& signalName, const std::string& encoding,
+                  std::vector<InstrField_t>& fields) {
+  static const std::regex pField("^([a-zA-Z_][a-zA-Z0-9_]*):(\\d+)'[bh]x$");
+  static const std::regex pWidth("^(\\d+)'.+$");
+  std::vector<std::string> segments;
+  split_by(encoding, "+", segments);
+
+  // The last segment has the lowest bits
+  std::string plain;
+  uint32_t lo = 0;
+  for (auto it = segments.rbegin(); it != segments.rend(); it++) {
+    std::string segment = *it;
+    remove_two_end_space(segment);
+    std::smatch m;
+    uint32_t width;
+    if (std::regex_match(segment, m, pField)) {
+      width = std::stoi(m.str(2));
+      if (width == 0 || width > 64) {
+        toCout("Error: a field must have 1 to 64 bits: "+segment);
+        abort();
+      }
+      fields.push_back({m.str(1), signalName, 0, lo+width-1, lo});
+      segment = segment.substr(segment.find(':')+1);
+    } else if (std::regex_match(segment, m, pWidth)) {
+      width = std::stoi(m.str(1));
+    } else {
+      toCout("Error: segment without a width in an encoding with fields: "+encoding);
+      abort();
+    }
+    plain = plain.empty() ? segment : segment+"+"+plain;
+    lo += width;
+  }
+  return plain;
+}
+
+
 // parse instr.txt file
 // parsed result is in g_instrInfo
 void read_in_instructions(std::string fileName) {
   toCout("### Begin read in instr info: "+fileName);
   g_instrInfo.clear();
-  std::ifstream input(fileName);
+  LineReader input(fileName);
   if(!input.is_open()) {
     toCout("Error: cannot open "+fileName);
     abort();
@@ -24,7 +65,7 @@ void read_in_instructions(std::string fileName) {
   enum State state;
   std::set<unsigned>  currentCycleSet;  // Clock cycles currnetly being processed
   std::string lastMemReadAddr;
-  while(std::getline(input, line)) {
+  while(input.getline(line)) {
     toCoutVerb(line);
     if (!line.empty())
       remove_two_end_space(line);
@@ -124,7 +165,7 @@ void read_in_instructions(std::string fileName) {
       }
       g_instrInfo.back().loadDataInfo.emplace(varName, std::make_pair("", 0));
       std::string newLine;
-      std::getline(input, newLine);
+      input.getline(newLine);
       while(newLine != "}") {
         remove_two_end_space(newLine);
         if(newLine.substr(0, 2) == "//") {}
@@ -149,13 +190,13 @@ void read_in_instructions(std::string fileName) {
           toCout("Unexpected line: "+newLine);
           abort();
         }
-        std::getline(input, newLine);
+        input.getline(newLine);
       }
       continue;
     }
     if(line.substr(0, 7) == "#VarMap") {
       std::string newLine;
-      std::getline(input, newLine);      
+      input.getline(newLine);      
       while(newLine != "}") {
         remove_two_end_space(newLine);
         if(newLine.substr(0, 2) == "//") {}
@@ -179,7 +220,7 @@ void read_in_instructions(std::string fileName) {
           toCout("Unexpected line: "+newLine);
           abort();
         }
-        std::getline(input, newLine);
+        input.getline(newLine);
       }
       continue;
     }
@@ -284,6 +325,10 @@ void read_in_instructions(std::string fileName) {
             remove_two_end_space(signalName);
             std::string encoding = line.substr(pos+2);
             remove_two_end_space(encoding);
+            std::vector<InstrField_t> fields;
+            if(encoding.find(':') != std::string::npos) {
+              encoding = take_instr_fields(signalName, encoding, fields);
+            }
             if(!check_input_val(encoding)) {
               toCout("Encoding is not x or number, line is: "+line);
               abort();
@@ -309,6 +354,18 @@ void read_in_instructions(std::string fileName) {
               }
 
               signalEncoding[cycle-1] = encoding;
+
+              for (InstrField_t field : fields) {
+                field.cycle = cycle;
+                for (const InstrField_t& other : g_instrInfo.back().fields) {
+                  if (other.name == field.name && other.hi-other.lo != field.hi-field.lo) {
+                    toCout("Error: field "+field.name+" has different widths in instruction "
+                           +g_instrInfo.back().name);
+                    abort();
+                  }
+                }
+                g_instrInfo.back().fields.push_back(field);
+              }
             }
 
             state = SubsequentSignal;
@@ -352,14 +409,14 @@ void read_in_instructions(std::string fileName) {
               }
             }
             else { // if is a vector of regs
-              std::getline(input, line);              
+              input.getline(line);              
               while(line[0] != ']') {
                 if(line.substr(0, 2) != "//") {
                   g_instrInfo.back().writeASVVec.push_back(line);
                   g_instrInfo.back().skipWriteASV.insert(line);
                   moduleAs.insert(line);
                 }
-                std::getline(input, line);
+                input.getline(line);
               }
               // line begins with "]"
               size_t pos = line.find(" ");
@@ -504,7 +561,7 @@ void read_in_instructions(std::string fileName) {
 void read_in_instructions_old(std::string fileName) {
   toCout("### Begin read in instr info: "+fileName);
   g_instrInfo.clear();
-  std::ifstream input(fileName);
+  LineReader input(fileName);
   if(!input.is_open()) {
     toCout("Error: cannot open "+fileName);
     abort();
@@ -519,7 +576,7 @@ void read_in_instructions_old(std::string fileName) {
   bool firstWord = true;
   bool firstSignalSeen = false;
   std::string lastMemReadAddr;
-  while(std::getline(input, line)) {
+  while(input.getline(line)) {
     toCoutVerb(line);
     if (!line.empty())
       remove_two_end_space(line);
@@ -618,7 +675,7 @@ void read_in_instructions_old(std::string fileName) {
       }
       g_instrInfo.back().loadDataInfo.emplace(varName, std::make_pair("", 0));
       std::string newLine;
-      std::getline(input, newLine);
+      input.getline(newLine);
       while(newLine != "}") {
         remove_two_end_space(newLine);
         if(newLine.substr(0, 2) == "//") {}
@@ -643,13 +700,13 @@ void read_in_instructions_old(std::string fileName) {
           toCout("Unexpected line: "+newLine);
           abort();
         }
-        std::getline(input, newLine);
+        input.getline(newLine);
       }
       continue;
     }
     if(line.substr(0, 7) == "#VarMap") {
       std::string newLine;
-      std::getline(input, newLine);      
+      input.getline(newLine);      
       while(newLine != "}") {
         remove_two_end_space(newLine);
         if(newLine.substr(0, 2) == "//") {}
@@ -673,7 +730,7 @@ void read_in_instructions_old(std::string fileName) {
           toCout("Unexpected line: "+newLine);
           abort();
         }
-        std::getline(input, newLine);
+        input.getline(newLine);
       }
       continue;
     }
@@ -814,14 +871,14 @@ void read_in_instructions_old(std::string fileName) {
               }
             }
             else { // if is a vector of regs
-              std::getline(input, line);              
+              input.getline(line);              
               while(line[0] != ']') {
                 if(line.substr(0, 2) != "//") {
                   g_instrInfo.back().writeASVVec.push_back(line);
                   g_instrInfo.back().skipWriteASV.insert(line);
                   moduleAs.insert(line);
                 }
-                std::getline(input, line);
+                input.getline(line);
               }
               // line begins with "]"
               size_t pos = line.find(" ");
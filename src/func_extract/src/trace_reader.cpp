@@ -0,0 +1,105 @@
+#include "trace_reader.h"
+#include "llvm/ADT/ArrayRef.h"
+
+#include <cstring>
+
+#define toStr(a) std::to_string(a)
+
+namespace funcExtract {
+
+
+uint32_t trace_value_bytes(uint32_t width) {
+  if (width <= 8) return 1;
+  if (width <= 16) return 2;
+  if (width <= 32) return 4;
+  return (width+63)/64*8;
+}
+
+
+TraceReader::~TraceReader() {
+  if (m_file) fclose(m_file);
+}
+
+
+static bool read_u32(FILE *file, uint32_t& val) {
+  return fread(&val, sizeof(val), 1, file) == 1;
+}
+
+
+bool TraceReader::open(const std::string& fileName) {
+  if (m_file) fclose(m_file);
+  m_file = fopen(fileName.c_str(), "rb");
+  if (!m_file) return false;
+  setvbuf(m_file, nullptr, _IOFBF, 1 << 20);
+
+  char magic[4];
+  uint32_t version, varNum;
+  if (fread(magic, 1, 4, m_file) != 4 || memcmp(magic, TRACE_MAGIC, 4) != 0
+      || !read_u32(m_file, version) || version != TRACE_VERSION
+      || !read_u32(m_file, varNum)) {
+    return false;
+  }
+
+  m_vars.clear();
+  m_entryVar.clear();
+  m_entryOffset.clear();
+  uint32_t offset = 0;
+  for (uint32_t i = 0; i < varNum; ++i) {
+    TraceVar_t var;
+    uint32_t nameLen;
+    if (!read_u32(m_file, var.width) || !read_u32(m_file, var.length)
+        || !read_u32(m_file, nameLen) || var.width == 0) {
+      return false;
+    }
+    var.name.resize(nameLen);
+    if (fread(&var.name[0], 1, nameLen, m_file) != nameLen) return false;
+    var.firstEntry = m_entryVar.size();
+
+    uint32_t entries = var.length ? var.length : 1;
+    for (uint32_t j = 0; j < entries; ++j) {
+      m_entryVar.push_back(i);
+      m_entryOffset.push_back(offset);
+      offset += trace_value_bytes(var.width);
+    }
+    m_vars.push_back(var);
+  }
+
+  m_values.assign(offset, 0);
+  m_changed.clear();
+  m_instr = TRACE_INIT;
+  return true;
+}
+
+
+bool TraceReader::next() {
+  m_changed.clear();
+  uint32_t count;
+  if (!m_file || !read_u32(m_file, m_instr) || !read_u32(m_file, count))
+    return false;
+
+  for (uint32_t i = 0; i < count; ++i) {
+    uint32_t entry;
+    if (!read_u32(m_file, entry) || entry >= m_entryVar.size()) return false;
+    uint32_t bytes = trace_value_bytes(entry_width(entry));
+    if (fread(&m_values[m_entryOffset[entry]], 1, bytes, m_file) != bytes) return false;
+    m_changed.push_back(entry);
+  }
+  return true;
+}
+
+
+std::string TraceReader::entry_name(uint32_t entry) const {
+  const TraceVar_t& var = m_vars[m_entryVar[entry]];
+  if (var.length == 0) return var.name;
+  return var.name+"["+toStr(entry-var.firstEntry)+"]";
+}
+
+
+llvm::APInt TraceReader::value(uint32_t entry) const {
+  uint32_t width = entry_width(entry);
+  std::vector<uint64_t> words((width+63)/64, 0);
+  memcpy(words.data(), &m_values[m_entryOffset[entry]], trace_value_bytes(width));
+  return llvm::APInt(width, words);
+}
+
+} // end of namespace funcExtract
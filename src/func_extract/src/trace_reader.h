@@ -0,0 +1,79 @@
+#ifndef FUNC_EXTRACT_TRACE_READER_H
+#define FUNC_EXTRACT_TRACE_READER_H
+
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdint>
+#include "llvm/ADT/APInt.h"
+
+namespace funcExtract {
+
+// Binary ASV trace, written by a simulator generated with sim_gen -trace.
+//
+// Header:  "ILAT", u32 version, u32 var count, and for every var
+//          u32 width, u32 length (0 for a scalar), u32 name length, name.
+// Records: u32 instr index (TRACE_INIT for the reset values), u32 count,
+//          and count times u32 entry, value.
+//
+// Every scalar is one entry, and every register array is one entry per
+// element, numbered in the order of the header.  A value is stored in
+// the bytes of its C type in the simulator (see trace_value_bytes()).
+// The first record has all entries, later ones only those that changed.
+
+constexpr const char *TRACE_MAGIC = "ILAT";
+constexpr uint32_t TRACE_VERSION = 1;
+constexpr uint32_t TRACE_INIT = UINT32_MAX;
+
+// Size of the C type sim_gen uses for the width (see c_type())
+uint32_t trace_value_bytes(uint32_t width);
+
+
+struct TraceVar_t {
+  std::string name;
+  uint32_t width;
+  uint32_t length;  // Array length, 0 for a scalar
+  uint32_t firstEntry;
+};
+
+
+class TraceReader {
+public:
+  ~TraceReader();
+
+  // Read the header.  False if the file cannot be read.
+  bool open(const std::string& fileName);
+
+  // Read the next record.  False at the end of the trace, or if it is broken.
+  bool next();
+
+  // The instr index of the last record, TRACE_INIT for the reset values
+  uint32_t instr() const { return m_instr; }
+
+  // The entries changed by the last record
+  const std::vector<uint32_t>& changed() const { return m_changed; }
+
+  const std::vector<TraceVar_t>& vars() const { return m_vars; }
+  uint32_t entry_num() const { return m_entryVar.size(); }
+
+  // Like the text printed by the simulator: the var name, with "[<idx>]"
+  // for an array element
+  std::string entry_name(uint32_t entry) const;
+  uint32_t entry_width(uint32_t entry) const { return m_vars[m_entryVar[entry]].width; }
+
+  // The value after the last record
+  llvm::APInt value(uint32_t entry) const;
+
+private:
+  FILE *m_file = nullptr;
+  std::vector<TraceVar_t> m_vars;
+  std::vector<uint32_t> m_entryVar;     // Entry -> var index
+  std::vector<uint32_t> m_entryOffset;  // Entry -> position in m_values
+  std::vector<uint8_t> m_values;
+  std::vector<uint32_t> m_changed;
+  uint32_t m_instr = TRACE_INIT;
+};
+
+} // end of namespace funcExtract
+
+#endif
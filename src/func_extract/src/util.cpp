@@ -2,7 +2,10 @@
 #include "parse_fill.h"
 #include "global_data_struct.h"
 #include "helper.h"
+#include "decode_tree.h"
 #include "../../live_analysis/src/global_data.h"
+#include "../../live_analysis/src/line_reader.h"
+#include <charconv>
 #define toCout(a) std::cout << a << std::endl;
 #define toStr(a) std::to_string(a)
 
@@ -164,26 +167,26 @@ void read_asv_info(std::string fileName, bool convertName) {
 // The data goes into the global data structures g_instrInfo and
 // is checked against what is already in g_registerArrays.
 void read_func_info(std::string fileName) { 
-  std::ifstream input(fileName);
+  LineReader input(fileName);
   std::string instrName, target;
-  std::string line;
+  std::string_view line;
   uint32_t idx;
 
   assert(!g_asv.empty());
 
-  while(std::getline(input, line)) {
-    toCoutVerb(line);
-    if(line.substr(0, 2) == "\\\\") {
-      toCout("Error: find \\\\: "+line);
+  while(input.getline(line)) {
+    if(g_verb) toCout(line);
+    if(starts_with(line, "\\\\")) {
+      toCout("Error: find \\\\: "+std::string(line));
       assert(false);
     }
-    if(line.substr(0, 2) == "//") continue;
-    if(line.substr(0, 6) == "Instr:") {
-      instrName = line.substr(6);
+    if(starts_with(line, "//")) continue;
+    if(starts_with(line, "Instr:")) {
+      instrName.assign(line.substr(6));
       idx = get_instr_by_name(instrName);
     }
-    else if(line.substr(0, 7) == "Target:") {
-      target = line.substr(7);
+    else if(starts_with(line, "Target:")) {
+      target.assign(line.substr(7));
       int retValWidth = 0; // TODO: encode the function return value explicitly in func_info.txt
 
       if(g_asv.count(target)) {
@@ -191,7 +194,8 @@ void read_func_info(std::string fileName) {
         retValWidth = (int)g_asv[target].width;
         assert(retValWidth > 0);
         // Big values are returned via a pointer arg, and the function itself returns void.
-        if (retValWidth > 64) 
+        // Values of up to 128 bits are returned as unsigned __int128.
+        if (retValWidth > 128) 
           retValWidth = 0;
       } else if (g_registerArrays.count(target)) {
         // Target is a register array. These are always returned via a pointer arg.
@@ -210,25 +214,31 @@ void read_func_info(std::string fileName) {
         g_instrInfo[idx].funcTypes.emplace(target, type);
       }
     }
-    else if(line.find(":") != std::string::npos) {
+    else if(starts_with(line, "Alias:")) {
+      // The update function was merged with an identical one
+      g_instrInfo[idx].funcTypes[target].alias.assign(line.substr(6));
+    }
+    else if(line.find(':') != std::string_view::npos) {
       // A single ASV function arg.  format is <name>:<width>[:<cycle>]
-      size_t pos = line.find(":");
-      std::string asv = line.substr(0, pos);
-      std::string widthCycle = line.substr(pos+1);
-      size_t pos2 = widthCycle.find(":");
-      int width;
-      int cycle;
-      if(pos2 != std::string::npos) {
-        width = std::stoi(widthCycle.substr(0,pos2));
-        cycle = std::stoi(widthCycle.substr(pos2+1));
+      size_t pos = line.find(':');
+      std::string asv(line.substr(0, pos));
+      std::string_view widthCycle = line.substr(pos+1);
+      size_t pos2 = widthCycle.find(':');
+      int width = 0;
+      int cycle = 0;
+      const char *wcEnd = widthCycle.data() + widthCycle.size();
+      if(pos2 != std::string_view::npos) {
+        std::from_chars(widthCycle.data(), widthCycle.data()+pos2, width);
+        std::from_chars(widthCycle.data()+pos2+1, wcEnd, cycle);
       } else {
-        width = std::stoi(widthCycle);
-        cycle = 0;
+        std::from_chars(widthCycle.data(), wcEnd, width);
       }
       assert(width != 0);  // Width will be negative if the arg is a pointer to a big ASV
       assert(cycle >= 0);  
 
       g_instrInfo[idx].funcTypes[target].argTy.push_back({asv, width, cycle});
+      // Older update functions returned anything wider than 64 bits this way
+      if (asv == RETURN_VAL_PTR_ID) g_instrInfo[idx].funcTypes[target].retTy = 0;
     }
   }
 
@@ -252,26 +262,96 @@ uint32_t get_instr_by_name(std::string instrName) {
 
 
 // return the corresponding instruction's name
+static bool instr_matches(const InstrInfo_t& instr,
+                          const std::map<std::string, std::vector<std::string>> &inputInstr) {
+  for(auto pair : inputInstr) {
+    std::string varName = pair.first;
+    const std::vector<std::string>& inputValue = pair.second;
+    auto pos = instr.instrEncoding.find(varName);
+    if (pos == instr.instrEncoding.end()) {
+      // If input has a value that is not specified by the instruction, it is OK.
+      continue;
+    }
+    const std::vector<std::string>& instrValue = pos->second;
+    if(!is_compatible(instrValue, inputValue)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+
+// The variable whose first-cycle value tells the most instructions apart,
+// e.g. the instruction word or an opcode input.
+std::string decode_key_var() {
+  std::map<std::string, std::pair<uint32_t, uint32_t>> score;  // instr num, mask bits
+  for(const auto& instr : g_instrInfo) {
+    for(const auto& pair : instr.instrEncoding) {
+      if(pair.second.empty()) continue;
+      llvm::APInt mask = convert_to_single_apint(pair.second.front(), true/*xmask*/);
+      if(mask.isZero()) continue;
+      score[pair.first].first++;
+      score[pair.first].second += mask.countPopulation();
+    }
+  }
+  std::string keyVar;
+  std::pair<uint32_t, uint32_t> best(0, 0);
+  for(const auto& pair : score) {
+    if(pair.second > best) {
+      best = pair.second;
+      keyVar = pair.first;
+    }
+  }
+  return keyVar;
+}
+
+
+// One pattern per instruction, in the order of g_instrInfo.  An instruction
+// that does not specify keyVar matches any value.
+void decode_patterns(const std::string& keyVar, std::vector<DecodePattern_t>& patterns) {
+  for(uint32_t i = 0; i < g_instrInfo.size(); i++) {
+    auto pos = g_instrInfo[i].instrEncoding.find(keyVar);
+    if(pos == g_instrInfo[i].instrEncoding.end() || pos->second.empty()) {
+      patterns.push_back({llvm::APInt(1, 0), llvm::APInt(1, 0), i});
+      continue;
+    }
+    const std::string& valueStr = pos->second.front();
+    patterns.push_back({convert_to_single_apint(valueStr),
+                        convert_to_single_apint(valueStr, true/*xmask*/), i});
+  }
+}
+
+
+// The decode tree over the first-cycle value of the key variable narrows
+// the instructions down to a few candidates.  These are then checked
+// against the whole input in the order of g_instrInfo, so the result is
+// the same as checking every instruction one by one.
 std::string decode(const std::map<std::string, std::vector<std::string>> &inputInstr) {
-  bool isCompatible;
-  for(const auto instr: g_instrInfo) {
-    isCompatible = true;
-    for(auto pair : inputInstr) {
-      std::string varName = pair.first;
-      const std::vector<std::string>& inputValue = pair.second;
-      auto pos = instr.instrEncoding.find(varName);
-      if (pos == instr.instrEncoding.end()) {
-        // If input has a value that is not specified by the instruction, it is OK.
-        continue;
-      }
-      const std::vector<std::string>& instrValue = pos->second;
-      if(!is_compatible(instrValue, inputValue)) {
-        isCompatible = false;
-        break;
+  static DecodeTree tree;
+  static std::string keyVar;
+  static size_t treeInstrNum = 0;
+  if(treeInstrNum != g_instrInfo.size()) {
+    treeInstrNum = g_instrInfo.size();
+    keyVar = decode_key_var();
+    std::vector<DecodePattern_t> patterns;
+    decode_patterns(keyVar, patterns);
+    tree.build(patterns);
+  }
+
+  auto keyPos = inputInstr.find(keyVar);
+  if(keyPos != inputInstr.end() && !keyPos->second.empty()) {
+    llvm::APInt keyVal = convert_to_single_apint(keyPos->second.front());
+    for(uint32_t c : tree.candidates(keyVal)) {
+      const InstrInfo_t& instr = g_instrInfo[tree.pattern(c).instrIdx];
+      if(instr_matches(instr, inputInstr)) {
+        return instr.name;
       }
     }
-    if(isCompatible) {
-      return instr.name;
+  } else {
+    for(const auto& instr: g_instrInfo) {
+      if(instr_matches(instr, inputInstr)) {
+        return instr.name;
+      }
     }
   }
   toCout("Error: input instruction cannot be decoded!");
@@ -23,6 +23,13 @@ uint32_t get_instr_by_name(std::string instrName);
 
 std::string decode(const std::map<std::string, std::vector<std::string>> &inputInstr);
 
+// The variable that decode() builds its decode tree over
+std::string decode_key_var();
+
+struct DecodePattern_t;
+// One pattern per instruction for the values of keyVar, in the order of g_instrInfo
+void decode_patterns(const std::string& keyVar, std::vector<DecodePattern_t>& patterns);
+
 bool is_compatible(const std::vector<std::string> &multiCycleInstrVal,
                    const std::vector<std::string> &multiCycleInputVal);
 
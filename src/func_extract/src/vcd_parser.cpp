@@ -2,13 +2,73 @@
 #include "helper.h"
 #include "global_data_struct.h"
 
-#include <forward_list>
+#include <vector>
+#include <unordered_map>
+#include "../../live_analysis/src/line_reader.h"
+
+#define toStr(a) std::to_string(a)
 
 using namespace taintGen;
 
 namespace funcExtract {
 
 
+// A VCD file is a sequence of blank-separated tokens, and line breaks carry
+// no meaning.  The scanner below walks over the mmapped file one token at a
+// time, dispatching on the first byte of each token, so nothing is copied
+// except for the variables we keep.
+class VcdScanner {
+public:
+  explicit VcdScanner(std::string_view text)
+    : m_cur(text.data()), m_end(text.data()+text.size()) {}
+
+  // Return an empty view at the end of the file
+  std::string_view next_token() {
+    while (m_cur < m_end && is_blank(*m_cur)) {
+      if (*m_cur == '\n') m_lineNum++;
+      m_cur++;
+    }
+    const char *begin = m_cur;
+    while (m_cur < m_end && !is_blank(*m_cur)) m_cur++;
+    return std::string_view(begin, m_cur-begin);
+  }
+
+  // Skip everything up to and including the next "$end"
+  void skip_to_end() {
+    std::string_view tok;
+    do {
+      tok = next_token();
+    } while (!tok.empty() && tok != "$end");
+  }
+
+  int line_num() const { return m_lineNum; }
+
+private:
+  static bool is_blank(char c) {
+    return c == ' ' || c == '\n' || c == '\t' || c == '\r';
+  }
+
+  const char *m_cur;
+  const char *m_end;
+  int m_lineNum = 1;
+};
+
+
+// A variable of the VCD that we want the value of
+struct VcdSignal_t {
+  std::string var;
+  uint32_t width;
+  std::string_view value;  // Points into the mmapped file
+  bool isVector;
+};
+
+
+static std::string_view strip_backslashes(std::string_view name) {
+  while (!name.empty() && name.front() == '\\') name.remove_prefix(1);
+  return name;
+}
+
+
 /// This function now handles hierarchial designs(with multiple scopes)
 void vcd_parser(std::string fileName) {
   if(!g_rstVal.empty()) {
@@ -18,222 +78,166 @@ void vcd_parser(std::string fileName) {
 
   toCout("### Begin vcd_parser: "+fileName);
 
-  std::map<std::string, std::string> nameVarMap;
-  std::map<std::string, uint32_t> nameWidthMap;
-
-  // Example: "$var reg 8 n35 state_stk[0] $end"
-  static const std::regex pNameDef("^\\$var (?:(?:reg)|(?:wire)) (\\d+) (\\S+) (\\S+) (\\[[0-9:]+\\] )?\\$end$");
-  static const std::regex pEndDefinitions("^\\$enddefinitions\\s+\\$end$");
-  static const std::regex pScope("^\\$scope\\s+(module|function|task)\\s+(\\S+)\\s+\\$end$");
-  static const std::regex pUpscope("^\\$upscope\\s+\\$end$");
-  static const std::regex pVersion("^\\$version\\s+.+\\s+\\$end$");
-  static const std::regex pTimescale("^\\$timescale\\s+.+\\s+\\$end$");
-  static const std::regex pVar("^\\$var\\s+.+\\s+\\$end$");
-  static const std::regex pDate("^\\$date\\s+.+\\s+\\$end$");
-  static const std::regex pComment("^\\$comment\\s+.+\\s+\\$end$");
-  static const std::regex pBeginDate("^\\$date\\s*$");   // Multi-line $date, terminated by $end
-  static const std::regex pBeginVersion("^\\$version\\s*$");   // Multi-line $version, terminated by $end
-  static const std::regex pBeginComment("^\\$comment\\s*$"); 
-  static const std::regex pBeginTimescale("^\\$timescale\\s*$"); 
-  static const std::regex pDumpvars("^\\$dumpvars\\s*$");
-  static const std::regex pEnd("^\\$end\\s*$");
-  static const std::regex pSomething("^\\$\\S+\\s+.+\\s+\\$end$");
-
-  std::string line;
-  std::ifstream input(fileName);
-  if(!input.good()) {
+  LineReader input(fileName);
+  if(!input.is_open()) {
     toCout("Error: "+fileName+" cannot be read!");
     abort();
   }
-
-  enum State {READ_NAME_DEFS, READ_VALUES, READ_DUMPVARS, READ_TO_END};
-  enum State state = READ_NAME_DEFS;
-  int depth = 0;
-  std::forward_list<std::string> scopeStack;
-  std::smatch m;
-
-  int lineNum = 0;
-  std::string lineNumStr;
-
-  while(std::getline(input, line)) {
-    ++lineNum;
-    lineNumStr = std::to_string(lineNum);
-    toCoutVerb(line);
-
-    if(state == READ_TO_END) {
-      // Ignore anything besides $end
-      if(std::regex_match(line, m, pEnd)) {
-        // Return to reading defs
-        state = READ_NAME_DEFS;
-      } 
-    } else if(state == READ_NAME_DEFS) {
-      if(std::regex_match(line, m, pNameDef)) {
-        uint32_t width = std::stoi(m.str(1));
-        // Note that name can contain pretty much any non-space characters
-        std::string name = m.str(2);
-        std::string var = m.str(3);
-
-        // Remove any backslashes
-        while (var[0] == '\\') {
-          var.erase(0,1);
-        }
-
-        // build hierarchical name
-        // For the top level of hierarchy, scopeStack.front() will be a blank string,
-        // and hierVar == var;
-        std::string hierVar;
-
-        assert(!scopeStack.empty());
-        if (!scopeStack.front().empty()) {
-          hierVar = scopeStack.front() + var;
-        } else {
-          hierVar = var;
-        }
-
-        toCoutVerb("Considering "+name+" = "+hierVar+"  "+var);
-
-        if (g_allRegs.empty()) {
-          // If g_allRegs is empty, assume we want everything.
-          nameVarMap.emplace(name, hierVar);
-          nameWidthMap.emplace(name, width);
-        } else if (is_reg(hierVar)) {
-          nameVarMap.emplace(name, hierVar);
-          nameWidthMap.emplace(name, width);
-        } else if (is_reg("\\"+hierVar)) {
-          nameVarMap.emplace(name, "\\"+hierVar);
-          nameWidthMap.emplace(name, width);
-        }
-      }
-      else if(std::regex_match(line, m, pScope)) {
-        if (m.str(1) != "module") {
-          toCout("Warning: Non-module scope at line "+lineNumStr+": "+line);
-          // Keep parsing, to reach the $upscope.
-        }
-
+  VcdScanner scanner(input.content());
+
+  // Id codes of the signals we keep.  Only these are looked at in the
+  // value section; every other value change is dropped after one lookup.
+  std::unordered_map<std::string_view, uint32_t> idMap;
+  std::vector<VcdSignal_t> signals;
+  // For the top level of hierarchy, the scope prefix is a blank string.
+  std::vector<std::string> scopeStack;
+
+  auto unexpected = [&](const std::string& what, std::string_view tok) {
+    toCout(what+" at line "+toStr(scanner.line_num())+": "+std::string(tok));
+  };
+
+  // ===== Header: scopes and variable definitions
+  std::string_view tok;
+  bool inHeader = true;
+  while (inHeader && !(tok = scanner.next_token()).empty()) {
+    if (tok == "$var") {
+      // Example: "$var reg 8 n35 state_stk[0] $end"
+      std::string_view type = scanner.next_token();
+      std::string_view widthStr = scanner.next_token();
+      std::string_view id = scanner.next_token();
+      std::string_view name = strip_backslashes(scanner.next_token());
+      scanner.skip_to_end();  // An optional bit range, then $end
+
+      if (type != "reg" && type != "wire") {
+        unexpected("Variable definition ignored", type);
+        continue;
+      }
+      if (idMap.count(id)) continue;  // Another name for a net we keep
+
+      assert(!scopeStack.empty());
+      std::string hierVar = scopeStack.back() + std::string(name);
+      if (g_verb) toCout("Considering "+std::string(id)+" = "+hierVar);
+
+      // If g_allRegs is empty, assume we want everything.
+      if (!g_allRegs.empty() && !is_reg(hierVar)) {
+        if (is_reg("\\"+hierVar)) hierVar = "\\"+hierVar;
+        else continue;
+      }
+
+      VcdSignal_t sig;
+      sig.var = hierVar;
+      sig.width = 0;
+      for (char c : widthStr) sig.width = sig.width*10 + (c-'0');
+      sig.isVector = false;
+      idMap.emplace(id, signals.size());
+      signals.push_back(sig);
+    }
+    else if (tok == "$scope") {
+      std::string_view kind = scanner.next_token();
+      std::string_view modname = strip_backslashes(scanner.next_token());
+      scanner.skip_to_end();
+      if (kind != "module") {
         // BTW, we treat module and function identically.
-        if (depth == 0) {
-          // Very first scope: the top module.  No need to
-          // explicitly use its name.
-          assert(scopeStack.empty());
-          scopeStack.push_front("");
-        } else {
-          std::string modname = m.str(2);
-          // Strip off any leading backslashes
-          while (modname[0] == '\\') {
-            modname.erase(0,1);
-          }
-          scopeStack.push_front(scopeStack.front() + modname + ".");
-        }
-        depth++;
-      }
-      else if(std::regex_match(line, pUpscope)) {
-        assert(!scopeStack.empty());
-        scopeStack.pop_front();
-        depth--;
-      }
-      else if(std::regex_match(line, pEndDefinitions)) {
-        assert(scopeStack.empty());
-        assert(depth == 0);
-        state = READ_VALUES;
-      }
-      else if(std::regex_match(line, pVersion)) {
-        // No action needed.
-      }
-      else if(std::regex_match(line, pComment)) {
-        // No action needed.
-      }
-      else if(std::regex_match(line, pTimescale)) {
-        // No action needed.
-      }
-      else if(std::regex_match(line, pDate)) {
-        // No action needed.
-      }
-      else if(std::regex_match(line, pBeginDate)) {
-        // Skip over lines until we reach $end
-        state = READ_TO_END;
-      }
-      else if(std::regex_match(line, pBeginVersion)) {
-        // Skip over lines until we reach $end
-        state = READ_TO_END;
-      }
-      else if(std::regex_match(line, pBeginComment)) {
-        state = READ_TO_END;
-      }
-      else if(std::regex_match(line, pBeginTimescale)) {
-        state = READ_TO_END;
-      }
-      else if(std::regex_match(line, pVar)) {
-        // Variable definition: ignored
-        toCout("Variable definition ignored at line "+lineNumStr+": "+line);
-      }
-      else if(std::regex_match(line, pSomething)) {
-        // A syntactically valid, but unknown line
-        toCout("Unexpected format at line "+lineNumStr+": "+line);
-      } else {
-        toCout("Syntax error at line "+lineNumStr+": "+line);
+        // Keep parsing, to reach the $upscope.
+        unexpected("Warning: Non-module scope", modname);
       }
+      // Very first scope: the top module.  No need to
+      // explicitly use its name.
+      if (scopeStack.empty()) scopeStack.push_back("");
+      else scopeStack.push_back(scopeStack.back() + std::string(modname) + ".");
     }
-    else if(state == READ_VALUES && std::regex_match(line, pDumpvars)) {
-      // The $dumpvars section is really just the values for time step 0.
-      // But we have to watch out for the $end
-      assert(scopeStack.empty());
-      assert(depth == 0);
-      state = READ_DUMPVARS;
+    else if (tok == "$upscope") {
+      assert(!scopeStack.empty());
+      scopeStack.pop_back();
+      scanner.skip_to_end();
     }
-    else if(state == READ_DUMPVARS && std::regex_match(line, pEnd)) {
+    else if (tok == "$enddefinitions") {
       assert(scopeStack.empty());
-      assert(depth == 0);
-      state = READ_VALUES;
+      scanner.skip_to_end();
+      inHeader = false;
     }
-    else if(state == READ_VALUES || state == READ_DUMPVARS) {
-      if(line.front() == '#') {
-        // Clock cycle count - ignore
-      }
-      else if(line[0] == 'b' || line[0] == 'B') {
-        // Syntax: ^b[01xz]+ <name>$
-        uint32_t blankPos = line.find(" ");
-        std::string rstVal = line.substr(1, blankPos-1);
-        // add binary symbol prefix
-        std::string name = line.substr(blankPos+1);
-        if(nameVarMap.find(name) == nameVarMap.end()) {
-          toCoutVerb(name+" is irrelevant");  // Something that is not a reg we are interested in
-          continue;
+    else if (tok.front() == '$') {
+      // $date, $version, $timescale, $comment, ...
+      scanner.skip_to_end();
+    }
+    else {
+      unexpected("Syntax error", tok);
+    }
+  }
+
+  // ===== Value changes.  Only the last value of every kept signal is stored.
+  while (!(tok = scanner.next_token()).empty()) {
+    switch (tok.front()) {
+      case '#':  // Time step - ignore
+        break;
+      case 'r':
+      case 'R':  // Real values are never reset values of regs
+        scanner.next_token();
+        break;
+      case 'b':
+      case 'B':
+        {
+          // Syntax: b[01xz]+ <id>
+          std::string_view id = scanner.next_token();
+          auto it = idMap.find(id);
+          if (it == idMap.end()) break;  // Not a reg we are interested in
+          VcdSignal_t& sig = signals[it->second];
+          sig.value = tok.substr(1);
+          sig.isVector = true;
         }
-        std::string var = nameVarMap[name];
-        uint32_t rstValWidth = 0;
-        if (g_allRegs.count(var)) {
-          // If the var is in g_allRegs, consider that to be the authoritative width.
-          rstValWidth = g_allRegs[var];
-        } else if (nameWidthMap.count(name)) {
-          // Otherwise use the width we parsed from the VCD file.
-          rstValWidth = nameWidthMap[name];  
-        } else {
-          rstValWidth = rstVal.length();  // Number of binary digits in rstVal
+        break;
+      case '0':
+      case '1':
+      case 'x':
+      case 'X':
+      case 'z':
+      case 'Z':
+        {
+          // Simplified syntax: [01xz]<id>  (no space)
+          auto it = idMap.find(tok.substr(1));
+          if (it == idMap.end()) break;
+          VcdSignal_t& sig = signals[it->second];
+          sig.value = tok.substr(0, 1);
+          sig.isVector = false;
         }
-        rstVal = std::to_string(rstValWidth)+"'b"+rstVal;
+        break;
+      case '$':
+        // $dumpvars, $dumpall, $dumpon, $dumpoff and their $end carry
+        // no value of their own.  A $comment has to be skipped.
+        if (tok == "$comment") scanner.skip_to_end();
+        break;
+      default:
+        unexpected("Syntax error", tok);
+        break;
+    }
+  }
 
-        toCoutVerb(rstVal+" saved as rst value of "+var);
-        g_rstVal[var] = rstVal;  // We end up keeping the final value of the var.
-      }
-      else if(line[0] == '0' || line[0] == '1' || line[0] == 'x' || line[0] == 'z') {
-        // Simplified syntax: ^[01xz]<name>$  (no space)
-        std::string rstVal = std::string(1, line.front());
-        std::string name = line.substr(1);
-        if(nameVarMap.find(name) == nameVarMap.end())
-          continue;
-        std::string var = nameVarMap[name];
-        g_rstVal[var] = rstVal;
-      } else {
-        toCout("Syntax error at line "+lineNumStr+": "+line);
-      }
+  uint32_t valueNum = 0;
+  for (const auto& sig : signals) {
+    if (sig.value.empty()) continue;
+    valueNum++;
+    if (!sig.isVector) {
+      g_rstVal[sig.var] = std::string(sig.value);
+      continue;
+    }
+    uint32_t rstValWidth;
+    auto regIt = g_allRegs.find(sig.var);
+    if (regIt != g_allRegs.end()) {
+      // If the var is in g_allRegs, consider that to be the authoritative width.
+      rstValWidth = regIt->second;
+    } else if (sig.width > 0) {
+      // Otherwise use the width we parsed from the VCD file.
+      rstValWidth = sig.width;
     } else {
-      assert(false);  // Junk state
+      rstValWidth = sig.value.length();  // Number of binary digits in the value
     }
+    // add binary symbol prefix
+    g_rstVal[sig.var] = toStr(rstValWidth)+"'b"+std::string(sig.value);
+    if (g_verb) toCout(g_rstVal[sig.var]+" saved as rst value of "+sig.var);
   }
-  assert(scopeStack.empty());
-  assert(depth == 0);
-  toCout("### "+std::to_string(nameVarMap.size())+" useful variable definitions found");
-  toCout("### "+std::to_string(g_rstVal.size())+" reset values found");
+
+  toCout("### "+toStr(signals.size())+" useful variable definitions found");
+  toCout("### "+toStr(valueNum)+" reset values found");
   print_rst_val();
   toCout("### End vcd_parser");
 }
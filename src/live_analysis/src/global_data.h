@@ -3,6 +3,7 @@
 #include "types.h"
 #include "varWidth.h"
 #include "pass_info.h"
+#include "packed_values.h"
 #include <vector>
 #include <string>
 #include <unordered_map>
@@ -46,8 +47,8 @@ extern std::unordered_map<std::string, std::string> g_moduleClk;
 extern std::unordered_map<std::string, std::unordered_map<std::string, std::string>> g_mod2instMap;
 extern std::unordered_map<std::string, std::vector<std::string>> g_mod2assertMap;
 extern std::map<std::string, std::set<std::string>> g_modChangedRegs;
-extern std::map<std::string, std::unordered_map<std::string, std::string>> g_rstValMap;
-extern std::map<std::string, std::unordered_map<std::string, std::string>> g_normValMap;
+extern VcdValMap g_rstValMap;
+extern VcdValMap g_normValMap;
 extern std::map<std::string, std::set<std::string>> g_finalRegCondMap;
 extern std::map<std::string, std::set<std::string>> g_trueReg2Slice;
 //extern std::vector<struct InstrInfo_t> g_instrInfo;
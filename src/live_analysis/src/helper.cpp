@@ -1063,8 +1063,18 @@ void parse_func_statements(std::vector<std::pair<std::string, std::string>> &cas
 }
 
 
+static bool read_line(std::ifstream &input, std::string &line) {
+  return bool(read_line(input, line));
+}
+
+static bool read_line(LineReader &input, std::string &line) {
+  return input.getline(line);
+}
+
+
 // returns the returnVar in case
-std::string parse_case_statements(std::vector<std::pair<std::string, std::string>> &caseAssignPairs, std::ifstream &input, bool returnBegin) {
+template <typename Input>
+static std::string parse_case_statements_impl(std::vector<std::pair<std::string, std::string>> &caseAssignPairs, Input &input, bool returnBegin) {
   auto caseBegin = input.tellg();  
   std::string line;
   std::smatch m;
@@ -1074,7 +1084,7 @@ std::string parse_case_statements(std::vector<std::pair<std::string, std::string
   std::string pairValue;
   std::string pairAssign;
   std::string returnVar;
-  while( std::getline(input, line) && !std::regex_match(line, m, pDefault) ) {
+  while( read_line(input, line) && !std::regex_match(line, m, pDefault) ) {
     if( readSwitchValue ) {
       readSwitchValue = false;
       if(std::regex_search(line, m, pNumExist)) {
@@ -1094,7 +1104,7 @@ std::string parse_case_statements(std::vector<std::pair<std::string, std::string
       caseAssignPairs.emplace_back(pairValue, pairAssign);      
     }
   }
-  std::getline(input, line);
+  read_line(input, line);
   pairValue = "default";
   if( !std::regex_match(line, m, pBlock) ) {
     std::cout << "!! Error in parsing case !!" << std::endl;
@@ -1102,7 +1112,7 @@ std::string parse_case_statements(std::vector<std::pair<std::string, std::string
   pairAssign = m.str(3);
   returnVar = m.str(2);
   caseAssignPairs.emplace_back(pairValue, pairAssign);
-  std::getline(input, line);
+  read_line(input, line);
   if(line.find("endcase", 0) == std::string::npos){
     toCout("Error: endcase is not found, first line is: "+firstLine);
     abort();
@@ -1112,6 +1122,16 @@ std::string parse_case_statements(std::vector<std::pair<std::string, std::string
 }
 
 
+std::string parse_case_statements(std::vector<std::pair<std::string, std::string>> &caseAssignPairs, std::ifstream &input, bool returnBegin) {
+  return parse_case_statements_impl(caseAssignPairs, input, returnBegin);
+}
+
+
+std::string parse_case_statements(std::vector<std::pair<std::string, std::string>> &caseAssignPairs, LineReader &input, bool returnBegin) {
+  return parse_case_statements_impl(caseAssignPairs, input, returnBegin);
+}
+
+
 std::string pairVec2taintString( std::vector<std::pair<std::string, std::string>> &pairVec, std::string notIncluded, std::string taint, std::ofstream &output ) {
   assert(pairVec.size() >= 2);
   std::vector<std::string> rhsVec;
@@ -7,6 +7,7 @@
 #include <iostream>
 #include <regex>
 #include "global_data.h"
+#include "line_reader.h"
 
 namespace taintGen {
 
@@ -118,6 +119,8 @@ void parse_func_statements(std::vector<std::pair<std::string, std::string>> &cas
 
 std::string parse_case_statements(std::vector<std::pair<std::string, std::string>> &caseAssignPairs, std::ifstream &input, bool returnBegin=false);
 
+std::string parse_case_statements(std::vector<std::pair<std::string, std::string>> &caseAssignPairs, LineReader &input, bool returnBegin=false);
+
 std::string pairVec2taintString( std::vector<std::pair<std::string, std::string>> &pairVec, std::string notIncluded, std::string taint, std::ofstream &output );
 
 std::string max_num(uint32_t width);
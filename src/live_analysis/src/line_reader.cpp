@@ -0,0 +1,66 @@
+#include "line_reader.h"
+
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace taintGen {
+
+LineReader::LineReader(const std::string& fileName) {
+  int fd = open(fileName.c_str(), O_RDONLY);
+  if (fd < 0) return;
+
+  struct stat statbuf;
+  if (fstat(fd, &statbuf) != 0) {
+    close(fd);
+    return;
+  }
+  m_isOpen = true;
+  if (statbuf.st_size == 0) {
+    // mmap() does not accept a zero length, and there is nothing to read anyway
+    close(fd);
+    return;
+  }
+
+  m_mapSize = statbuf.st_size;
+  void *addr = mmap(nullptr, m_mapSize, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (addr == MAP_FAILED) {
+    m_mapSize = 0;
+    m_isOpen = false;
+    return;
+  }
+  madvise(addr, m_mapSize, MADV_SEQUENTIAL);
+
+  m_begin = static_cast<const char*>(addr);
+  m_cur = m_begin;
+  m_end = m_begin + m_mapSize;
+}
+
+
+LineReader::~LineReader() {
+  if (m_mapSize > 0)
+    munmap(const_cast<char*>(m_begin), m_mapSize);
+}
+
+
+bool LineReader::getline(std::string_view& line) {
+  if (m_cur >= m_end) return false;
+  const char *nl = static_cast<const char*>(memchr(m_cur, '\n', m_end-m_cur));
+  if (nl == nullptr) nl = m_end;
+  line = std::string_view(m_cur, nl-m_cur);
+  m_cur = (nl == m_end) ? m_end : nl+1;
+  return true;
+}
+
+
+bool LineReader::getline(std::string& line) {
+  std::string_view view;
+  if (!getline(view)) return false;
+  line.assign(view.data(), view.size());  // Reuses the capacity of line
+  return true;
+}
+
+} // end of namespace taintGen
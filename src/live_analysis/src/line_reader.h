@@ -0,0 +1,70 @@
+#ifndef LIVE_ANALYSIS_LINE_READER_H
+#define LIVE_ANALYSIS_LINE_READER_H
+
+#include <string>
+#include <string_view>
+#include <regex>
+#include <cstddef>
+#include <algorithm>
+
+namespace taintGen {
+
+// Reads a whole file through mmap() and hands out its lines one by one.
+// getline(std::string_view&) returns a view directly into the mapping, so
+// no copy or allocation is made per line; the view is valid as long as the
+// reader is alive.  getline(std::string&) is a drop-in for std::getline, for
+// the code that still needs a std::string (e.g. for std::smatch).
+// As with std::getline, the '\n' is stripped, and a last line without '\n'
+// is still returned.
+class LineReader {
+public:
+  explicit LineReader(const std::string& fileName);
+  ~LineReader();
+
+  LineReader(const LineReader&) = delete;
+  LineReader& operator=(const LineReader&) = delete;
+
+  bool is_open() const { return m_isOpen; }
+  bool good() const { return m_isOpen && m_cur < m_end; }
+  bool eof() const { return m_cur >= m_end; }
+
+  bool getline(std::string_view& line);
+  bool getline(std::string& line);
+
+  // Offset of the next line, so that a parser can look ahead and come back
+  size_t tellg() const { return m_cur - m_begin; }
+  void seekg(size_t pos) { m_cur = m_begin + std::min(pos, (size_t)(m_end-m_begin)); }
+
+  // The whole content of the file
+  std::string_view content() const { return std::string_view(m_begin, m_end-m_begin); }
+
+private:
+  const char *m_begin = nullptr;
+  const char *m_cur = nullptr;
+  const char *m_end = nullptr;
+  size_t m_mapSize = 0;
+  bool m_isOpen = false;
+};
+
+
+typedef std::match_results<std::string_view::const_iterator> SvMatch;
+
+inline bool regex_match(std::string_view line, SvMatch& m, const std::regex& re) {
+  return std::regex_match(line.begin(), line.end(), m, re);
+}
+
+inline bool regex_match(std::string_view line, const std::regex& re) {
+  return std::regex_match(line.begin(), line.end(), re);
+}
+
+inline std::string_view sv_match_str(const SvMatch& m, size_t i) {
+  if (!m[i].matched) return std::string_view();
+  return std::string_view(&*m[i].first, m[i].length());
+}
+
+inline bool starts_with(std::string_view line, std::string_view prefix) {
+  return line.substr(0, prefix.size()) == prefix;
+}
+
+} // end of namespace taintGen
+#endif
@@ -1568,17 +1568,17 @@ void nonblock_taint_gen(std::string line, std::ofstream &output) {
   // _r_flag
   std::string neqRst = "";
   if(g_set_rflag_if_not_rst_val) {
-    if(g_rstValMap[moduleName].find(dest) == g_rstValMap[moduleName].end()) {
+    if(!g_rstValMap.has(moduleName, dest)) {
       toCout("Warning: cannot find in g_rstValMap for module: "+moduleName+", var: "+dest);
       neqRst = " && ("+dest+" != 0";
     }
-    else if(std::regex_match(g_rstValMap[moduleName][dest], m, pX))
+    else if(std::regex_match(g_rstValMap.get(moduleName, dest), pX))
       neqRst = " && ("+dest+" != 0";
     else
-      neqRst = " && ("+dest+" != "+g_rstValMap[moduleName][dest];
+      neqRst = " && ("+dest+" != "+g_rstValMap.get(moduleName, dest);
     if(g_set_rflag_if_not_norm_val) {
-      if(g_normValMap[moduleName].find(dest) != g_normValMap[moduleName].end())
-        neqRst = neqRst + " && "+dest+" != "+g_normValMap[moduleName][dest];
+      if(g_normValMap.has(moduleName, dest))
+        neqRst = neqRst + " && "+dest+" != "+g_normValMap.get(moduleName, dest);
     }
     neqRst = neqRst + " )";
   }
@@ -1678,17 +1678,17 @@ void nonblockconcat_taint_gen(std::string line, std::ofstream &output) {
   // r_flag
   std::string neqRst = "";
   if(g_set_rflag_if_not_rst_val) {
-    if(g_rstValMap[moduleName].find(dest) == g_rstValMap[moduleName].end()) {
+    if(!g_rstValMap.has(moduleName, dest)) {
       toCout("Warning: cannot find in g_rstValMap for module: "+moduleName+", var: "+dest);
       neqRst = " && ("+dest+" != 0";
     }
-    else if(std::regex_match(g_rstValMap[moduleName][dest], m, pX))
+    else if(std::regex_match(g_rstValMap.get(moduleName, dest), pX))
       neqRst = " && ("+dest+" != 0";
     else
-      neqRst = " && ("+dest+" != "+g_rstValMap[moduleName][dest];
+      neqRst = " && ("+dest+" != "+g_rstValMap.get(moduleName, dest);
     if(g_set_rflag_if_not_norm_val) {
-      if(g_normValMap[moduleName].find(dest) != g_normValMap[moduleName].end())
-        neqRst = neqRst + " && "+dest+" != "+g_normValMap[moduleName][dest];
+      if(g_normValMap.has(moduleName, dest))
+        neqRst = neqRst + " && "+dest+" != "+g_normValMap.get(moduleName, dest);
     }
     neqRst = neqRst + " )";
   }
@@ -1788,14 +1788,14 @@ void nonblockif_taint_gen(std::string line, std::string always_line, std::ifstre
       std::string neqRst = "";
       std::smatch m;      
       if(g_set_rflag_if_not_rst_val) {
-        if(g_rstValMap[moduleName].find(dest) == g_rstValMap[moduleName].end()) {
+        if(!g_rstValMap.has(moduleName, dest)) {
           toCout("Error: cannot find in g_rstValMap for module: "+moduleName+", var: "+dest);
           neqRst = " && "+dest+" "+destSlice+" != 0";          
         }
-        else if(std::regex_match(g_rstValMap[moduleName][dest], m, pX))
+        else if(std::regex_match(g_rstValMap.get(moduleName, dest), pX))
           neqRst = " && "+dest+" "+destSlice+" != 0";          
         else
-          neqRst = " && "+dest+" "+destSlice+" != "+g_rstValMap[moduleName][dest];
+          neqRst = " && "+dest+" "+destSlice+" != "+g_rstValMap.get(moduleName, dest);
       }
       output << always_line << std::endl;  
       output << blank + "if(rst_zy) " + dest + "_r_flag <= 0;" << std::endl;
@@ -1830,14 +1830,14 @@ void nonblockif_taint_gen(std::string line, std::string always_line, std::ifstre
       std::string neqRst = "";
       std::smatch m;      
       if(g_set_rflag_if_not_rst_val) {
-        if(g_rstValMap[moduleName].find(dest) == g_rstValMap[moduleName].end()) {
+        if(!g_rstValMap.has(moduleName, dest)) {
           toCout("Error: cannot find in g_rstValMap for module: "+moduleName+", var: "+dest);
           neqRst = " && "+dest+" "+destSlice+" != 0";          
         }
-        else if(std::regex_match(g_rstValMap[moduleName][dest], m, pX))
+        else if(std::regex_match(g_rstValMap.get(moduleName, dest), pX))
           neqRst = " && "+dest+" "+destSlice+" != 0";
         else
-          neqRst = " && "+dest+" "+destSlice+" != "+g_rstValMap[moduleName][dest];
+          neqRst = " && "+dest+" "+destSlice+" != "+g_rstValMap.get(moduleName, dest);
       }
       output << always_line << std::endl;
       output << blank + "if(rst_zy) " + dest + "_r_flag <= 0;" << std::endl;      
@@ -1932,14 +1932,14 @@ void nonblockif_taint_gen(std::string line, std::string always_line, std::ifstre
       std::string neqRst = "";
       std::smatch m;      
       if(g_set_rflag_if_not_rst_val) {
-        if(g_rstValMap[moduleName].find(dest) == g_rstValMap[moduleName].end()) {
+        if(!g_rstValMap.has(moduleName, dest)) {
           toCout("Error: cannot find in g_rstValMap for module: "+moduleName+", var: "+dest);
           neqRst = " && "+dest+" "+destSlice+" != 0";          
         }
-        else if(std::regex_match(g_rstValMap[moduleName][dest], m, pX))
+        else if(std::regex_match(g_rstValMap.get(moduleName, dest), pX))
           neqRst = " && "+dest+" "+destSlice+" != 0";
         else
-          neqRst = " && "+dest+" "+destSlice+" != "+g_rstValMap[moduleName][dest];
+          neqRst = " && "+dest+" "+destSlice+" != "+g_rstValMap.get(moduleName, dest);
       }
       output << always_line << std::endl; 
       output << blank + "if(rst_zy) " + dest + "_r_flag <= 0;" << std::endl;      
@@ -1973,14 +1973,14 @@ void nonblockif_taint_gen(std::string line, std::string always_line, std::ifstre
       std::string neqRst = "";
       std::smatch m;        
       if(g_set_rflag_if_not_rst_val) {
-        if(g_rstValMap[moduleName].find(dest) == g_rstValMap[moduleName].end()) {
+        if(!g_rstValMap.has(moduleName, dest)) {
           toCout("Error: cannot find in g_rstValMap for module: "+moduleName+", var: "+dest);
           neqRst = " && "+dest+" "+destSlice+" != 0";          
         }
-        else if(std::regex_match(g_rstValMap[moduleName][dest], m, pX))
+        else if(std::regex_match(g_rstValMap.get(moduleName, dest), pX))
           neqRst = " && "+dest+" "+destSlice+" != 0"; 
         else
-          neqRst = " && "+dest+" "+destSlice+" != "+g_rstValMap[moduleName][dest];
+          neqRst = " && "+dest+" "+destSlice+" != "+g_rstValMap.get(moduleName, dest);
       }
       output << always_line << std::endl;
       output << blank + "if(rst_zy) " + dest + "_r_flag <= 0;" << std::endl;      
@@ -2072,14 +2072,14 @@ void nonblockif2_taint_gen(std::string line, std::string always_line, std::ifstr
     std::string neqRst = "";
     std::smatch m;
     if(g_set_rflag_if_not_rst_val) {
-      if(g_rstValMap[moduleName].find(dest) == g_rstValMap[moduleName].end()) {
+      if(!g_rstValMap.has(moduleName, dest)) {
         toCout("Error: cannot find in g_rstValMap for module: "+moduleName+", var: "+dest);
         neqRst = " && "+dest+" "+destSlice+" != 0";          
       }
-      else if(std::regex_match(g_rstValMap[moduleName][dest], m, pX))
+      else if(std::regex_match(g_rstValMap.get(moduleName, dest), pX))
         neqRst = " && "+dest+" "+destSlice+" != 0"; 
       else
-        neqRst = " && "+dest+" "+destSlice+" != "+g_rstValMap[moduleName][dest];
+        neqRst = " && "+dest+" "+destSlice+" != "+g_rstValMap.get(moduleName, dest);
     }
     output << blank + "if (" + condAndSlice + ") " + dest + "_r_flag " + destSlice + " <= " + dest + "_r_flag " + destSlice + " ? 1 : " + dest + "_t_flag " + destSlice + " ? 0 : ( |" + dest + _r + " " + destSlice + neqRst + " ) ;" << std::endl;
   } while( std::getline(input, line) && std::regex_match(line, m, pNonblockIf2) );
@@ -0,0 +1,112 @@
+#include "packed_values.h"
+
+#include <algorithm>
+
+namespace taintGen {
+
+SignalTable g_vcdSignals;
+
+
+uint32_t SignalTable::intern(const std::string& name) {
+  auto res = m_ids.emplace(name, m_names.size());
+  if (res.second) m_names.push_back(name);
+  return res.first->second;
+}
+
+
+uint32_t SignalTable::find(const std::string& name) const {
+  auto it = m_ids.find(name);
+  return it == m_ids.end() ? NONE : it->second;
+}
+
+
+static uint64_t encode_bit(char c) {
+  switch (c) {
+    case '0': return 0;
+    case '1': return 1;
+    case 'x': case 'X': return 2;
+    default: return 3;  // z
+  }
+}
+
+
+static const char bitChars[4] = {'0', '1', 'x', 'z'};
+
+
+void PackedValues::set(uint32_t sig, std::string_view bits) {
+  uint32_t width = bits.size();
+  auto it = m_slots.find(sig);
+  if (it == m_slots.end() || it->second.width != width) {
+    // A value of another width takes new words, the old ones are just left unused
+    Slot_t slot{width, (uint32_t)m_words.size()};
+    m_words.resize(m_words.size() + word_num(width), 0);
+    it = m_slots.insert_or_assign(sig, slot).first;
+  }
+
+  uint64_t *words = &m_words[it->second.offset];
+  std::fill(words, words + word_num(width), 0);
+  for (uint32_t i = 0; i < width; i++) {
+    // bit 0 is the last character
+    words[i/32] |= encode_bit(bits[width-1-i]) << ((i%32)*2);
+  }
+}
+
+
+std::string PackedValues::to_string(uint32_t sig) const {
+  auto it = m_slots.find(sig);
+  if (it == m_slots.end()) return "";
+
+  uint32_t width = it->second.width;
+  const uint64_t *words = &m_words[it->second.offset];
+  bool isZero = width > 0;
+  for (uint32_t i = 0; i < word_num(width) && isZero; i++)
+    isZero = (words[i] == 0);
+  if (isZero) return "0";
+
+  std::string bits(width, '0');
+  for (uint32_t i = 0; i < width; i++) {
+    bits[width-1-i] = bitChars[(words[i/32] >> ((i%32)*2)) & 3];
+  }
+  return std::to_string(width)+"'b"+bits;
+}
+
+
+bool PackedValues::equal(const PackedValues& other) const {
+  if (m_slots.size() != other.m_slots.size())
+    return false;
+  for (const auto& pair : m_slots) {
+    auto it = other.m_slots.find(pair.first);
+    if (it == other.m_slots.end() || it->second.width != pair.second.width)
+      return false;
+    const uint64_t *words1 = &m_words[pair.second.offset];
+    const uint64_t *words2 = &other.m_words[it->second.offset];
+    if (!std::equal(words1, words1 + word_num(pair.second.width), words2))
+      return false;
+  }
+  return true;
+}
+
+
+bool VcdValMap::has(const std::string& modName, const std::string& var) const {
+  auto it = m_modules.find(modName);
+  if (it == m_modules.end()) return false;
+  uint32_t sig = g_vcdSignals.find(var);
+  return sig != SignalTable::NONE && it->second.has(sig);
+}
+
+
+std::string VcdValMap::get(const std::string& modName, const std::string& var) const {
+  auto it = m_modules.find(modName);
+  if (it == m_modules.end()) return "";
+  uint32_t sig = g_vcdSignals.find(var);
+  if (sig == SignalTable::NONE) return "";
+  return it->second.to_string(sig);
+}
+
+
+void VcdValMap::set(const std::string& modName, const std::string& var,
+                    std::string_view bits) {
+  m_modules[modName].set(g_vcdSignals.intern(var), bits);
+}
+
+} // end of namespace taintGen
@@ -0,0 +1,78 @@
+#ifndef LIVE_ANALYSIS_PACKED_VALUES_H
+#define LIVE_ANALYSIS_PACKED_VALUES_H
+
+#include <string>
+#include <string_view>
+#include <map>
+#include <unordered_map>
+#include <vector>
+#include <cstdint>
+
+namespace taintGen {
+
+// Signal names are stored once, and value maps refer to them by index.
+class SignalTable {
+public:
+  static const uint32_t NONE = UINT32_MAX;
+
+  uint32_t intern(const std::string& name);
+  // Returns NONE if the name was never interned
+  uint32_t find(const std::string& name) const;
+  const std::string& name(uint32_t id) const { return m_names[id]; }
+
+private:
+  std::unordered_map<std::string, uint32_t> m_ids;
+  std::vector<std::string> m_names;
+};
+
+extern SignalTable g_vcdSignals;
+
+
+// Values of the signals of one module.  Each bit is stored as 2 bits
+// (0, 1, x, z), 32 bits per 64-bit word, so comparing two values is a
+// word-by-word compare.
+class PackedValues {
+public:
+  // bits is the VCD text of the value, MSB first, e.g. "01x0"
+  void set(uint32_t sig, std::string_view bits);
+  bool has(uint32_t sig) const { return m_slots.count(sig) > 0; }
+  size_t size() const { return m_slots.size(); }
+
+  // Same text as the string maps used to hold: "0" if all bits are 0,
+  // "<width>'b<bits>" otherwise.  Empty if sig has no value.
+  std::string to_string(uint32_t sig) const;
+
+  bool equal(const PackedValues& other) const;
+
+private:
+  struct Slot_t {
+    uint32_t width;
+    uint32_t offset;  // First word in m_words
+  };
+
+  static uint32_t word_num(uint32_t width) { return (width+31) / 32; }
+
+  std::unordered_map<uint32_t, Slot_t> m_slots;
+  std::vector<uint64_t> m_words;
+};
+
+
+// Module name -> values of its signals
+class VcdValMap {
+public:
+  bool has(const std::string& modName, const std::string& var) const;
+  // Empty if there is no value for the var
+  std::string get(const std::string& modName, const std::string& var) const;
+  void set(const std::string& modName, const std::string& var, std::string_view bits);
+
+  PackedValues& operator[](const std::string& modName) { return m_modules[modName]; }
+
+  std::map<std::string, PackedValues>::const_iterator begin() const { return m_modules.begin(); }
+  std::map<std::string, PackedValues>::const_iterator end() const { return m_modules.end(); }
+
+private:
+  std::map<std::string, PackedValues> m_modules;
+};
+
+} // end of namespace taintGen
+#endif
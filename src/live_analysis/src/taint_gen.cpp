@@ -14,6 +14,7 @@
 #include <stack>
 #include <algorithm>
 #include "taint_gen.h"
+#include "line_reader.h"
 //#include "pass_info.h"
 #include <cmath>
 #include <glog/logging.h>
@@ -208,7 +209,7 @@ void clean_global_data(uint32_t totalRegCnt, uint32_t nextSig) {
   remove functions wrapping cases 
   collect information of select and concat*/
 void clean_file(std::string fileName, bool useLogic) {
-  std::ifstream cleanFileInput(fileName);
+  LineReader cleanFileInput(fileName);
   std::ofstream output(fileName + ".nocomment");
   std::string line;
   std::string cleanLine;
@@ -234,7 +235,7 @@ void clean_file(std::string fileName, bool useLogic) {
   //assert(!g_two_prev || !g_one_prev);
   assert(!g_set_rflag_if_not_rst_val || g_enable_taint);
 
-  while( std::getline(cleanFileInput, line) ) {
+  while( cleanFileInput.getline(line) ) {
     //toCout(line);
     if(line.find("S4 S4_0 (") != std::string::npos) {
       toCoutVerb("FIND IT!");
@@ -570,7 +571,6 @@ void clean_file(std::string fileName, bool useLogic) {
     } // end of switch
   }
   output.close();
-  cleanFileInput.close();
   did_clean_file = true;
 }
 
@@ -1216,7 +1216,7 @@ void merge_taints(std::string fileName) {
         continue;
       std::string rstVal;
       if(g_use_vcd_parser)
-        rstVal = g_rstValMap[moduleName][var];
+        rstVal = g_rstValMap.get(moduleName, var);
       if(rstVal.empty()) rstVal = "0";
       output << "  always @( posedge " + g_recentClk + " ) begin" << std::endl;
       if(g_hasRst) {
@@ -2452,7 +2452,7 @@ void gen_assert_property(std::ofstream &output) {
 
         std::string rstVal; 
         if(g_use_vcd_parser)
-          rstVal = g_rstValMap[moduleName][var];
+          rstVal = g_rstValMap.get(moduleName, var);
         if(rstVal.empty()) rstVal = "0";
 
         if(g_use_does_keep) DOES_KEEP = " || ( " + var + "_DOES_KEEP == 0 )";
@@ -2732,7 +2732,7 @@ std::string separate_modules(std::string fileName,
                              Str2StrVecMap_t &moduleOutputsMap) {
   toCout("... Begin separating modules!");
   totalRegCnt = 0;
-  std::ifstream input(fileName);
+  LineReader input(fileName);
   std::string line;
   std::smatch m;
   std::ofstream output;
@@ -2749,7 +2749,7 @@ std::string separate_modules(std::string fileName,
   }
 
 
-  while(std::getline(input, line)) {
+  while(input.getline(line)) {
     //toCout(line);
     if(line.find("<=") != std::string::npos) {
       std::string regAndSlice = "";        
@@ -1,126 +1,109 @@
 #include "vcd_parser.h"
 #include "helper.h"
 #include "global_data.h"
+#include "line_reader.h"
 
 #define toStr(a) std::to_string(a)
 
 namespace taintGen {
 
 // the first key is module name, the second key is variable name
-std::map<std::string, std::unordered_map<std::string, std::string>> g_rstValMap;
-std::map<std::string, std::unordered_map<std::string, std::string>> g_normValMap;
+VcdValMap g_rstValMap;
+VcdValMap g_normValMap;
 
 
-bool is_end_scope(std::string line) {
-  return line.compare("$upscope $end") == 0;
+bool is_end_scope(std::string_view line) {
+  return line == "$upscope $end";
 }
 
-bool is_func_start(std::string line) {
-  return line.substr(0, 15) == "$scope function";
+bool is_func_start(std::string_view line) {
+  return starts_with(line, "$scope function");
 }
 
 // Assumption: different instances of same module would 
 // have same reset value for same register.
-void hierarchical_vcd_parser(std::string fileName, std::map<std::string, std::unordered_map<std::string, std::string>>& valMap) {
-  // key is nXXX, pair is <moduleName, varName>
-  std::map<std::string, std::pair<std::string, std::string>> nameVarMap;
+void hierarchical_vcd_parser(std::string fileName, VcdValMap& valMap) {
+  // key is nXXX, pair is <moduleName, interned varName>
+  std::unordered_map<std::string, std::pair<std::string, uint32_t>> nameVarMap;
   std::stack<std::string> instanceNameStack;
   std::stack<std::string> moduleNameStack;
 
   toCout("### Begin vcd_parser");
-  std::regex pName("^\\$var wire (\\d+) (n\\d+) (\\S+) \\$end$");
-  std::regex pScope("^\\$scope module (\\S+) \\$end$");
-  std::string line;
-  std::ifstream input(fileName);
+  static const std::regex pName("^\\$var wire (\\d+) (n\\d+) (\\S+) \\$end$");
+  static const std::regex pScope("^\\$scope module (\\S+) \\$end$");
+  std::string_view line;
+  LineReader input(fileName);
+  if(!input.is_open()) {
+    toCout("Error: "+fileName+" cannot be read!");
+    abort();
+  }
   enum State {readName, readValue};
-  enum State state;
+  enum State state = readName;
   bool passLine = false;
-  std::smatch m;
+  SvMatch m;
   bool isFirstInstance = true;
   bool isInFunc = false;
-  while(std::getline(input, line)) {
-    toCout(line);
-    if(line.find("n135 ap_CS_fsm") != std::string::npos
-         || line.find("b0001 n135") != std::string::npos) {
-      toCout("Find n135!");
-    }
+  std::string name;
+  while(input.getline(line)) {
+    if(line.empty()) continue;
+    if(g_verb) toCout(std::string(line));
     if(isInFunc) {
       if (is_end_scope(line)) isInFunc = false;
       continue;
     }
     if(is_func_start(line)) isInFunc = true;
-    if(line.substr(0, 6).compare("$scope") == 0) {
-      if(!std::regex_match(line, m, pScope)) {
+    if(starts_with(line, "$scope")) {
+      if(!regex_match(line, m, pScope)) {
         continue;
       }
       std::string curInstance = m.str(1);
-      uint32_t idx = 0;
       instanceNameStack.push(curInstance);
-      toCout(" ================== push instn "+curInstance+" , stack depth: "+toStr(instanceNameStack.size()));
+      toCoutVerb(" ================== push instn "+curInstance+" , stack depth: "+toStr(instanceNameStack.size()));
       if(isFirstInstance) {
         isFirstInstance = false;
         moduleNameStack.push(curInstance);
-        toCout(" ================== push module "+curInstance+" , stack depth: "+toStr(moduleNameStack.size()));        
+        toCoutVerb(" ================== push module "+curInstance+" , stack depth: "+toStr(moduleNameStack.size()));        
       }
       else {
         std::string moduleName = moduleNameStack.top();
         std::string curModule = g_instance2moduleMap[moduleName][curInstance];
         moduleNameStack.push(curModule);
-        toCout(" ================== push module "+curModule+" , stack depth: "+toStr(moduleNameStack.size()));             
+        toCoutVerb(" ================== push module "+curModule+" , stack depth: "+toStr(moduleNameStack.size()));             
       }
       state = readName;
       continue;
     }
     else if(line.front() == '#') {
       state = readValue;
-      if(line.substr(1, 1) == "0")
-        passLine = true; // do not parse value for time 0
-      else if(line.substr(1, 1) != "0")
-        passLine = false;
+      passLine = (line.substr(1, 1) == "0"); // do not parse value for time 0
       continue;
     }
-    else if(line.substr(0, 8).compare("$upscope") == 0) {
-      toCout(" ================== to pop module "+moduleNameStack.top()+" , stack depth: "+toStr(moduleNameStack.size()));      
-      toCout(" ================== to pop instns "+instanceNameStack.top()+" , stack depth: "+toStr(instanceNameStack.size()));      
+    else if(starts_with(line, "$upscope")) {
+      toCoutVerb(" ================== to pop module "+moduleNameStack.top()+" , stack depth: "+toStr(moduleNameStack.size()));      
+      toCoutVerb(" ================== to pop instns "+instanceNameStack.top()+" , stack depth: "+toStr(instanceNameStack.size()));      
       instanceNameStack.pop();
       moduleNameStack.pop();
     }
     //else if(passLine)
     //  continue;
     else if(state == readName){
-      if(!std::regex_match(line, m, pName))
+      if(!regex_match(line, m, pName))
         continue;
-      std::string name = m.str(2);
-      std::string var = m.str(3);
-      nameVarMap.emplace(name, std::make_pair(moduleNameStack.top(), var));
+      nameVarMap.emplace(m.str(2), std::make_pair(moduleNameStack.top(),
+                                                  g_vcdSignals.intern(m.str(3))));
     }
     else if(state == readValue) {
-      uint32_t blankPos = line.find(" ");       
-      std::string name = line.substr(blankPos+1);
-      if(nameVarMap.find(name) == nameVarMap.end()) {
+      size_t blankPos = line.find(' ');
+      if(blankPos == std::string_view::npos) continue;
+      // Reuses the capacity of name, no allocation for most of the lines
+      name.assign(line.substr(blankPos+1));
+      auto nameIt = nameVarMap.find(name);
+      if(nameIt == nameVarMap.end()) {
         toCout("Warning: "+name+" is not found in map");
         continue;
       }
-      if(name == "n135") {
-        toCoutVerb("Found n135");
-      }
 
-      std::string rstVal = line.substr(1, blankPos-1);
-      if(is_zero(rstVal)) {
-        rstVal = "0";
-      }
-      else {
-        rstVal = toStr(rstVal.length())+"'b"+rstVal;
-      }
-      auto moduleVarPair = nameVarMap[name];
-      std::string modName = moduleVarPair.first;
-      std::string varName = moduleVarPair.second;
-      if(valMap.find(modName) == valMap.end())
-        valMap.emplace(modName, std::unordered_map<std::string, std::string>{{varName, rstVal}});
-      else if(valMap[modName].find(varName) == valMap[modName].end())
-        valMap[modName].emplace(varName, rstVal);
-      else
-        valMap[modName][varName] = rstVal;
+      valMap[nameIt->second.first].set(nameIt->second.second, line.substr(1, blankPos-1));
     }
   } // end of while
   // FIXME: do not check temprally
@@ -132,7 +115,7 @@ void hierarchical_vcd_parser(std::string fileName, std::map<std::string, std::un
 
 
 // check if different instances of same module can have different rst values
-bool check_rst_value(std::map<std::string, std::unordered_map<std::string, std::string>>& rstValMap) {
+bool check_rst_value(const VcdValMap& rstValMap) {
   for(auto it1 = rstValMap.begin(); it1 != rstValMap.end(); it1++) {
     if(std::next(it1) == rstValMap.end())
       break;
@@ -193,16 +176,9 @@ bool all_are_digits(const std::string& s) {
 }
 
 
-bool equal_maps( std::unordered_map<std::string, std::string>& mp1, std::unordered_map<std::string, std::string>& mp2 ) {
-  if(mp1.size() != mp2.size())
-    return false;
-  for(auto it = mp1.begin(); it != mp1.end(); it++) {
-    if(mp2.find(it->first) == mp2.end())
-      return false;
-    if(it->second != mp2[it->first])
-      return false;
-  }
-  return true;
+// Values are packed, so this compares whole words instead of characters
+bool equal_maps(const PackedValues& mp1, const PackedValues& mp2) {
+  return mp1.equal(mp2);
 }
 
 
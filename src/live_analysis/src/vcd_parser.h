@@ -2,6 +2,7 @@
 #define LIVE_ANALYSIS_VCD_PARSER_H
 
 #include <string>
+#include <string_view>
 #include <iostream>
 #include <fstream>
 #include <regex>
@@ -9,25 +10,26 @@
 #include <stack>
 #include <vector>
 #include <unordered_map>
+#include "packed_values.h"
 //#include "global_data_struct.h"
 
 namespace taintGen {
 
-void hierarchical_vcd_parser(std::string fileName, std::map<std::string, std::unordered_map<std::string, std::string>>& valMap);
+void hierarchical_vcd_parser(std::string fileName, VcdValMap& valMap);
 
 bool same_module(const std::string& name1, const std::string& name2);
 
 bool all_are_digits(const std::string& s);
 
-bool equal_maps( std::unordered_map<std::string, std::string>& mp1, std::unordered_map<std::string, std::string>& mp2 );
+bool equal_maps(const PackedValues& mp1, const PackedValues& mp2);
 
-bool check_rst_value(std::map<std::string, std::unordered_map<std::string, std::string>>& rstValMap);
+bool check_rst_value(const VcdValMap& rstValMap);
 
 bool is_zero(std::string s);
 
-bool is_end_scope(std::string line);
+bool is_end_scope(std::string_view line);
 
-bool is_func_start(std::string line);
+bool is_func_start(std::string_view line);
 } // end of namespace taintGen
 
 #endif
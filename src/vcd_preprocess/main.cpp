@@ -1,58 +1,154 @@
-#include "../../util/verilog-vcd-parser/build/VCDScanner.hpp"
-#include "../../util/verilog-vcd-parser/build/VCDParser.hpp"
-#include "../../util/verilog-vcd-parser/src/VCDFile.hpp"
-#include "../../util/verilog-vcd-parser/src/VCDFileParser.hpp"
-#include "../../util/verilog-vcd-parser/src/VCDValue.hpp"
 #include <iostream>
 #include <vector>
 #include <fstream>
+#include <sstream>
+#include <string>
+#include <cstring>
+#include <cstdint>
+#include <unordered_map>
 
-/// This function tries to get all signals' values at the last time point
+// Usage: vcd_pre <file.vcd> [--at <time>]
+//
+// Writes the value of every signal at the last time point of the VCD (or at
+// the given time) to ./final_state.txt, one "<reference> <value>" line per
+// signal.  The file is read in a single pass, and only the current value of
+// each signal is kept, so memory does not grow with the length of the trace.
+
+
+struct Signal_t {
+  std::string reference;
+  std::string idCode;
+};
+
+
+// Reads the VCD one blank-separated token at a time
+class TokenReader {
+public:
+  explicit TokenReader(std::istream& input) : m_input(input) {}
+
+  bool next(std::string& token) {
+    while (m_pos >= m_line.size()) {
+      if (!std::getline(m_input, m_line)) return false;
+      m_pos = 0;
+      skip_blanks();
+    }
+    size_t end = m_line.find_first_of(" \t\r", m_pos);
+    if (end == std::string::npos) end = m_line.size();
+    token.assign(m_line, m_pos, end-m_pos);
+    m_pos = end;
+    skip_blanks();
+    return true;
+  }
+
+  // Skip everything up to and including the next "$end"
+  void skip_to_end() {
+    std::string token;
+    while (next(token) && token != "$end") {}
+  }
+
+private:
+  void skip_blanks() {
+    while (m_pos < m_line.size() && strchr(" \t\r", m_line[m_pos])) m_pos++;
+  }
+
+  std::istream& m_input;
+  std::string m_line;
+  size_t m_pos = 0;
+};
+
+
+/// This function tries to get all signals' values at the last time point,
+/// or at the time given with --at
 int main(int argc, char *argv[]) {
-  VCDFileParser parser;
-  VCDFile * trace = parser.parse_file(argv[1]);
-  if(trace == nullptr) {
+  if(argc < 2) {
+    std::cout << "Usage: " << argv[0] << " <file.vcd> [--at <time>]" << std::endl;
+    return 1;
+  }
+  bool hasStopTime = false;
+  uint64_t stopTime = 0;
+  for(int i = 2; i < argc; i++) {
+    if(strcmp(argv[i], "--at") == 0 && i+1 < argc) {
+      hasStopTime = true;
+      stopTime = std::stoull(argv[++i]);
+    } else {
+      std::cout << "Error: unknown option: " << argv[i] << std::endl;
+      return 1;
+    }
+  }
+
+  std::ifstream input(argv[1]);
+  if(!input.is_open()) {
+    std::cout << "Error: cannot parse vcd file" << std::endl;
+    return 1;
+  }
+  TokenReader reader(input);
+
+  // Signals in the order of their definitions.  Several signals can share
+  // one id code, so values are kept per id code.
+  std::vector<Signal_t> signals;
+  std::unordered_map<std::string, std::string> curValue;
+
+  std::string token;
+  bool inHeader = true;
+  while(inHeader && reader.next(token)) {
+    if(token == "$var") {
+      // $var <type> <size> <id code> <reference> [<range>] $end
+      std::string type, size;
+      Signal_t signal;
+      reader.next(type);
+      reader.next(size);
+      reader.next(signal.idCode);
+      reader.next(signal.reference);
+      reader.skip_to_end();
+      curValue.emplace(signal.idCode, "x");
+      signals.push_back(signal);
+    }
+    else if(token == "$enddefinitions") {
+      reader.skip_to_end();
+      inHeader = false;
+    }
+    else if(token[0] == '$') {
+      // $scope, $upscope, $date, $version, $timescale, $comment
+      reader.skip_to_end();
+    }
+  }
+
+  if(inHeader) {
     std::cout << "Error: cannot parse vcd file" << std::endl;
     return 1;
   }
-  std::vector<VCDTime> timeVec = *trace->get_timestamps();
-  VCDTime lastTime = timeVec.back();
-  std::ofstream output("./final_state.txt");
 
-  for(VCDScope *scope: *trace->get_scopes()) {
-    for(VCDSignal *signal: scope->signals) {
-      VCDValue *val = trace->get_signal_value_at(signal->hash, lastTime);
-      output << signal->reference << " ";
-      switch(val->get_type()) {
-        case(VCD_SCALAR):
-          {
-            output << VCDValue::VCDBit2Char(val -> get_value_bit());
-            break;
-          }
-        case(VCD_VECTOR):
-          {
-            VCDBitVector * vecval = val -> get_value_vector();
-            for(auto it = vecval -> begin();
-                     it != vecval -> end();
-                     ++it) {
-                output << VCDValue::VCDBit2Char(*it);
-            }
-            break;
-          }
-        case (VCD_REAL):
-          {
-            std::cout << val -> get_value_real();
-            break;
-          }
-        default:
-          {
-            std::cout << "Error: unexpected type!" << std::endl;
-            break;
-          }
+  // Value changes
+  while(reader.next(token)) {
+    char c = token[0];
+    if(c == '#') {
+      uint64_t time = std::stoull(token.substr(1));
+      if(hasStopTime && time > stopTime) break;
+    }
+    else if(c == 'b' || c == 'B' || c == 'r' || c == 'R') {
+      std::string idCode;
+      reader.next(idCode);
+      auto it = curValue.find(idCode);
+      if(it != curValue.end()) it->second.assign(token, 1, std::string::npos);
+    }
+    else if(c == '$') {
+      if(token == "$comment") reader.skip_to_end();
+      // $dumpvars, $dumpall, $dumpon, $dumpoff, $end: nothing to do
+    }
+    else {
+      // Scalar: <value><id code>
+      auto it = curValue.find(token.substr(1));
+      if(it != curValue.end()) it->second.assign(1, c);
+      else if(!strchr("01xXzZ", c)) {
+        std::cout << "Error: unexpected value change: " << token << std::endl;
       }
-      output << std::endl;      
     }
   }
+
+  std::ofstream output("./final_state.txt");
+  for(const Signal_t &signal: signals) {
+    output << signal.reference << " " << curValue[signal.idCode] << std::endl;
+  }
   output.close();
   return 0;
 }